@@ -0,0 +1,690 @@
+// 热点基础组件的微基准
+//
+// 覆盖以下热点：
+// - TLVProtocol：解析/序列化（不同负载大小），连续多条消息的逐条解析与批量扫描（v1/v2头部）
+// - ByteConverter：16/32/64位转换（运行时与编译期字节序），数组转换（逐个与SIMD批量）
+// - MessageQueue：Push（1~N个生产者线程，同时有一个消费者用GetMessages取走）、GetMessages和PushFront
+// - 消息分发：按类型分发消息的几种方式
+// - LZCodec：类JSON文本的压缩和解压
+//
+// 每项先自动标定迭代次数，使单轮耗时不少于最短时间，再重复若干轮，报告中位数和最小值的
+// ns/op以及每次操作处理的字节数（bytes/op）。结果以JSON或CSV输出到标准输出，
+// 便于在CI中对比优化前后的数据。
+//
+// 用法：./microbench [-f json|csv] [-m 每轮最短毫秒数] [-r 重复轮数] [-p 最大生产者数] [-F 名称过滤]
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../tlv_protocol.h"
+#include "../byte_converter.h"
+#include "../message_queue.h"
+#include "../message_dispatcher.h"
+#include "../lz_codec.h"
+
+// 参与测试的负载大小
+static const size_t PAYLOAD_SIZES[] = {0, 16, 64, 256, 1024, 4096, 16384, 65536};
+// 字节序转换的输入数组长度
+static const size_t CONVERT_VALUES = 4096;
+// 消息队列测试的消息大小
+static const size_t QUEUE_MESSAGE_SIZE = 64;
+// GetMessages/PushFront每批的消息数
+static const int QUEUE_BATCH = 64;
+// 分发测试中轮流出现的消息类型数
+static const uint16_t DISPATCH_TYPES = 8;
+// 连续消息测试中每个缓冲区的消息数和负载大小
+static const size_t STREAM_FRAMES = 64;
+static const size_t STREAM_PAYLOADS[] = {10, 100};
+// 压缩测试的输入大小
+static const size_t LZ_SIZES[] = {1024, 16384, 65536};
+
+static int64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// 阻止编译器把被测代码当作无用计算消除
+template <typename T>
+static inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// 被测函数：执行iterations次操作，返回计时部分的耗时（ns），准备工作不计入
+typedef std::function<int64_t(uint64_t iterations)> BenchFunc;
+
+struct Benchmark {
+    std::string name;
+    double bytes_per_op;
+    BenchFunc func;
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;       // 各轮的中位数
+    double min_ns_per_op;   // 各轮的最小值
+    double bytes_per_op;
+};
+
+struct MicrobenchOptions {
+    std::string format;
+    double min_ms;
+    int repetitions;
+    int max_producers;
+    std::string filter;
+
+    MicrobenchOptions() : format("json"), min_ms(200), repetitions(3), max_producers(4) {}
+};
+
+// ---------------- TLVProtocol ----------------
+
+static std::vector<char> BuildFrame(size_t payload) {
+    TLVProtocol protocol;
+    TLVMessage msg;
+    msg.type = 1;
+    msg.length = static_cast<uint32_t>(payload);
+    msg.value.assign(payload, 'x');
+
+    std::vector<char> frame;
+    protocol.SerializeMessage(msg, frame);
+    return frame;
+}
+
+static int64_t BenchParseMessage(size_t payload, uint64_t iterations) {
+    std::vector<char> frame = BuildFrame(payload);
+    TLVProtocol protocol;
+    TLVMessage msg;
+    size_t consumed = 0;
+
+    int64_t start = NowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+        protocol.ParseMessage(frame.data(), frame.size(), msg, consumed);
+        DoNotOptimize(msg.value.data());
+        DoNotOptimize(consumed);
+    }
+    return NowNs() - start;
+}
+
+static int64_t BenchParseView(size_t payload, uint64_t iterations) {
+    std::vector<char> frame = BuildFrame(payload);
+    TLVProtocol protocol;
+    TLVView view;
+    size_t consumed = 0;
+
+    int64_t start = NowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+        protocol.ParseView(frame.data(), frame.size(), view, consumed);
+        DoNotOptimize(view.value);
+        DoNotOptimize(consumed);
+    }
+    return NowNs() - start;
+}
+
+// STREAM_FRAMES条payload字节的消息首尾相连，少数类型较大（v2中为3字节varint）
+static std::vector<char> BuildStream(TLVProtocol& protocol, size_t payload) {
+    std::vector<char> stream;
+    std::vector<char> value(payload, 'x');
+    std::vector<char> frame;
+    for (size_t i = 0; i < STREAM_FRAMES; i++) {
+        uint16_t type = static_cast<uint16_t>(i % 16 == 15 ? 20000 + i : i);
+        protocol.SerializeFrame(type, value.data(), static_cast<uint32_t>(payload), frame);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    return stream;
+}
+
+// 每次操作是一条消息：逐条ParseView，或每次ScanFrames一批
+static int64_t BenchParseStream(TLVFormat format, bool scan, size_t payload, uint64_t iterations) {
+    TLVProtocol protocol;
+    protocol.SetFormat(format);
+    std::vector<char> stream = BuildStream(protocol, payload);
+    TLVView views[STREAM_FRAMES];
+    uint64_t total = 0;
+
+    int64_t start = NowNs();
+    for (uint64_t i = 0; i < iterations; i += STREAM_FRAMES) {
+        if (scan) {
+            size_t consumed = 0;
+            bool malformed = false;
+            size_t count = protocol.ScanFrames(stream.data(), stream.size(), views, STREAM_FRAMES, consumed, malformed);
+            total += count + views[count - 1].length;
+        } else {
+            size_t offset = 0;
+            TLVView view;
+            size_t consumed = 0;
+            while (protocol.ParseView(stream.data() + offset, stream.size() - offset, view, consumed)) {
+                offset += consumed;
+                total += view.length;
+            }
+        }
+        DoNotOptimize(views);
+    }
+    int64_t elapsed = NowNs() - start;
+    DoNotOptimize(total);
+    return elapsed;
+}
+
+static int64_t BenchSerializeMessage(size_t payload, uint64_t iterations) {
+    TLVProtocol protocol;
+    TLVMessage msg;
+    msg.type = 1;
+    msg.length = static_cast<uint32_t>(payload);
+    msg.value.assign(payload, 'x');
+    std::vector<char> output;
+
+    int64_t start = NowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+        protocol.SerializeMessage(msg, output);
+        DoNotOptimize(output.data());
+    }
+    return NowNs() - start;
+}
+
+// ---------------- ByteConverter ----------------
+
+template <typename T, typename Convert>
+static int64_t BenchConvert(ByteOrder order, Convert convert, uint64_t iterations) {
+    ByteConverter converter;
+    converter.SetByteOrder(order);
+
+    std::vector<T> values(CONVERT_VALUES);
+    for (size_t i = 0; i < values.size(); i++) {
+        values[i] = static_cast<T>(i * 0x9E3779B97F4A7C15ULL);
+    }
+
+    T acc = 0;
+    int64_t start = NowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+        acc ^= convert(converter, values[i & (CONVERT_VALUES - 1)]);
+        DoNotOptimize(acc);
+    }
+    return NowNs() - start;
+}
+
+// 与主机相反的字节序，编译期版本用它测试需要交换的情况
+static constexpr ByteOrder SWAP_BYTE_ORDER =
+    HOST_BYTE_ORDER == ByteOrder::LittleEndian ? ByteOrder::BigEndian : ByteOrder::LittleEndian;
+
+// 编译期字节序的单值转换，输入与BenchConvert相同
+template <typename T, typename Convert>
+static int64_t BenchConvertStatic(Convert convert, uint64_t iterations) {
+    std::vector<T> values(CONVERT_VALUES);
+    for (size_t i = 0; i < values.size(); i++) {
+        values[i] = static_cast<T>(i * 0x9E3779B97F4A7C15ULL);
+    }
+
+    T acc = 0;
+    int64_t start = NowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+        acc ^= convert(values[i & (CONVERT_VALUES - 1)]);
+        DoNotOptimize(acc);
+    }
+    return NowNs() - start;
+}
+
+// 每次操作转换整个CONVERT_VALUES个元素的数组。simd为false时逐个调用ConvertN（原有的做法），
+// 为true时调用ConvertArrayN
+template <typename T, typename ConvertOne, typename ConvertArray>
+static int64_t BenchConvertArray(bool simd, ConvertOne convert_one, ConvertArray convert_array,
+                                 uint64_t iterations) {
+    ByteConverter converter;
+    converter.SetByteOrder(SWAP_BYTE_ORDER);
+
+    std::vector<T> src(CONVERT_VALUES);
+    std::vector<T> dst(CONVERT_VALUES);
+    for (size_t i = 0; i < src.size(); i++) {
+        src[i] = static_cast<T>(i * 0x9E3779B97F4A7C15ULL);
+    }
+
+    int64_t start = NowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (simd) {
+            convert_array(converter, src.data(), dst.data(), CONVERT_VALUES);
+        } else {
+            for (size_t j = 0; j < CONVERT_VALUES; j++) {
+                dst[j] = convert_one(converter, src[j]);
+            }
+        }
+        DoNotOptimize(dst.data());
+    }
+    return NowNs() - start;
+}
+
+// ---------------- MessageQueue ----------------
+
+// producers个线程并发Push，一个消费者线程用GetMessages取走，计时到全部取完为止
+static int64_t BenchQueuePush(int producers, uint64_t iterations) {
+    MessageQueue queue;
+    char message[QUEUE_MESSAGE_SIZE];
+    memset(message, 'x', sizeof(message));
+
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        uint64_t count = iterations / producers + (static_cast<uint64_t>(p) < iterations % producers ? 1 : 0);
+        threads.push_back(std::thread([&queue, &go, &message, count]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (uint64_t i = 0; i < count; i++) {
+                queue.Push(message, sizeof(message));
+            }
+        }));
+    }
+
+    uint64_t expected = iterations * QUEUE_MESSAGE_SIZE;
+    uint64_t received = 0;
+    std::vector<char> data;
+
+    int64_t start = NowNs();
+    go.store(true, std::memory_order_release);
+    while (received < expected) {
+        if (queue.GetMessages(data)) {
+            received += data.size();
+        }
+    }
+    int64_t elapsed = NowNs() - start;
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    return elapsed;
+}
+
+// 每批先投递QUEUE_BATCH条消息（不计时），再计时一次GetMessages合并取出
+static int64_t BenchQueueGetMessages(uint64_t iterations) {
+    MessageQueue queue;
+    char message[QUEUE_MESSAGE_SIZE];
+    memset(message, 'x', sizeof(message));
+    std::vector<char> data;
+
+    int64_t elapsed = 0;
+    for (uint64_t done = 0; done < iterations; done += QUEUE_BATCH) {
+        for (int i = 0; i < QUEUE_BATCH; i++) {
+            queue.Push(message, sizeof(message));
+        }
+
+        int64_t start = NowNs();
+        queue.GetMessages(data);
+        DoNotOptimize(data.data());
+        elapsed += NowNs() - start;
+    }
+    return elapsed;
+}
+
+// 每批计时QUEUE_BATCH次PushFront，再清空队列（不计时）
+static int64_t BenchQueuePushFront(uint64_t iterations) {
+    MessageQueue queue;
+    char message[QUEUE_MESSAGE_SIZE];
+    memset(message, 'x', sizeof(message));
+
+    int64_t elapsed = 0;
+    for (uint64_t done = 0; done < iterations; done += QUEUE_BATCH) {
+        int64_t start = NowNs();
+        for (int i = 0; i < QUEUE_BATCH; i++) {
+            queue.PushFront(message, sizeof(message));
+        }
+        elapsed += NowNs() - start;
+
+        queue.Clear();
+    }
+    return elapsed;
+}
+
+// ---------------- MessageDispatcher ----------------
+
+static uint64_t g_dispatch_sink = 0;
+
+static void CountMessage(int fd, const TLVView& view) {
+    g_dispatch_sink += static_cast<uint64_t>(fd) + view.length;
+}
+
+// 消息依次取DISPATCH_TYPES种类型，mode为switch时模拟在单个std::function回调里按类型分支
+static int64_t BenchDispatch(const std::string& mode, uint64_t iterations) {
+    MessageDispatcher dispatcher;
+    std::function<void(int, const TLVView&)> callback;
+
+    for (uint16_t type = 0; type < DISPATCH_TYPES; type++) {
+        if (mode == "static") {
+            dispatcher.Register<CountMessage>(type);
+        } else if (mode == "function") {
+            dispatcher.Register(type, [](int fd, const TLVView& view) { CountMessage(fd, view); });
+        }
+    }
+    if (mode == "default") {
+        dispatcher.SetDefault([](int fd, const TLVView& view) { CountMessage(fd, view); });
+    }
+    if (mode == "switch") {
+        callback = [](int fd, const TLVView& view) {
+            switch (view.type) {
+            case 0: case 1: case 2: case 3:
+            case 4: case 5: case 6: case 7:
+                CountMessage(fd, view);
+                break;
+            default:
+                break;
+            }
+        };
+    }
+
+    char payload[16] = {0};
+    TLVView view(0, payload, sizeof(payload));
+
+    int64_t start = NowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+        view.type = static_cast<uint16_t>(i % DISPATCH_TYPES);
+        if (callback) {
+            callback(1, view);
+        } else {
+            dispatcher.Dispatch(1, view);
+        }
+    }
+    int64_t elapsed = NowNs() - start;
+    DoNotOptimize(g_dispatch_sink);
+    return elapsed;
+}
+
+// 由重复字段名和随机数值组成的类JSON文本
+static std::vector<char> BuildJson(size_t size) {
+    static const char* const names[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot"};
+    std::string text = "[";
+    char record[160];
+    unsigned seed = 1;
+    while (text.size() < size) {
+        int id = rand_r(&seed) % 100000;
+        snprintf(record, sizeof(record), "{\"id\":%d,\"name\":\"%s\",\"score\":%d,\"active\":%s},",
+                 id, names[id % 6], rand_r(&seed) % 1000, (id & 1) ? "true" : "false");
+        text += record;
+    }
+    return std::vector<char>(text.begin(), text.begin() + size);
+}
+
+static int64_t BenchCompress(size_t size, uint64_t iterations) {
+    std::vector<char> input = BuildJson(size);
+    std::vector<char> output(LZCodec::MaxCompressedSize(size));
+
+    int64_t start = NowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+        size_t n = LZCodec::Compress(input.data(), input.size(), output.data(), output.size());
+        DoNotOptimize(n);
+        DoNotOptimize(output.data());
+    }
+    return NowNs() - start;
+}
+
+static int64_t BenchDecompress(size_t size, uint64_t iterations) {
+    std::vector<char> input = BuildJson(size);
+    std::vector<char> compressed(LZCodec::MaxCompressedSize(size));
+    compressed.resize(LZCodec::Compress(input.data(), input.size(), compressed.data(), compressed.size()));
+    std::vector<char> output(size);
+
+    int64_t start = NowNs();
+    for (uint64_t i = 0; i < iterations; i++) {
+        bool ok = LZCodec::Decompress(compressed.data(), compressed.size(), output.data(), output.size());
+        DoNotOptimize(ok);
+        DoNotOptimize(output.data());
+    }
+    return NowNs() - start;
+}
+
+// ---------------- 运行与输出 ----------------
+
+static std::vector<Benchmark> BuildBenchmarks(const MicrobenchOptions& options) {
+    std::vector<Benchmark> benches;
+
+    for (size_t i = 0; i < sizeof(PAYLOAD_SIZES) / sizeof(PAYLOAD_SIZES[0]); i++) {
+        size_t payload = PAYLOAD_SIZES[i];
+        double frame_bytes = static_cast<double>(payload + 6);
+        std::string suffix = "/" + std::to_string(payload);
+
+        benches.push_back(Benchmark{"tlv/parse_message" + suffix, frame_bytes,
+            [payload](uint64_t n) { return BenchParseMessage(payload, n); }});
+        benches.push_back(Benchmark{"tlv/parse_view" + suffix, frame_bytes,
+            [payload](uint64_t n) { return BenchParseView(payload, n); }});
+        benches.push_back(Benchmark{"tlv/serialize_message" + suffix, frame_bytes,
+            [payload](uint64_t n) { return BenchSerializeMessage(payload, n); }});
+    }
+
+    // parse_stream: 逐条ParseView；scan_frames: ScanFrames一次找出整批边界。bytes/op为每条消息的线上字节数
+    const TLVFormat formats[] = {TLVFormat::V1, TLVFormat::V2};
+    for (size_t i = 0; i < sizeof(STREAM_PAYLOADS) / sizeof(STREAM_PAYLOADS[0]); i++) {
+        size_t payload = STREAM_PAYLOADS[i];
+        for (int f = 0; f < 2; f++) {
+            TLVFormat format = formats[f];
+            TLVProtocol protocol;
+            protocol.SetFormat(format);
+            double frame_bytes = static_cast<double>(BuildStream(protocol, payload).size()) / STREAM_FRAMES;
+            std::string suffix = std::string(format == TLVFormat::V2 ? "_v2/" : "_v1/") + std::to_string(payload);
+
+            benches.push_back(Benchmark{"tlv/parse_stream" + suffix, frame_bytes,
+                [format, payload](uint64_t n) { return BenchParseStream(format, false, payload, n); }});
+            benches.push_back(Benchmark{"tlv/scan_frames" + suffix, frame_bytes,
+                [format, payload](uint64_t n) { return BenchParseStream(format, true, payload, n); }});
+        }
+    }
+
+    // swap: 与主机字节序不同，需要交换；native: 与主机字节序相同，原样返回
+    ByteOrder host = ByteConverter::GetHostByteOrder();
+    ByteOrder other = host == ByteOrder::LittleEndian ? ByteOrder::BigEndian : ByteOrder::LittleEndian;
+    const ByteOrder orders[] = {other, host};
+    const char* order_names[] = {"swap", "native"};
+
+    for (int i = 0; i < 2; i++) {
+        ByteOrder order = orders[i];
+        std::string suffix = std::string("/") + order_names[i];
+
+        benches.push_back(Benchmark{"byteconv/convert16" + suffix, 2,
+            [order](uint64_t n) {
+                return BenchConvert<uint16_t>(order,
+                    [](const ByteConverter& c, uint16_t v) { return c.Convert16(v); }, n);
+            }});
+        benches.push_back(Benchmark{"byteconv/convert32" + suffix, 4,
+            [order](uint64_t n) {
+                return BenchConvert<uint32_t>(order,
+                    [](const ByteConverter& c, uint32_t v) { return c.Convert32(v); }, n);
+            }});
+        benches.push_back(Benchmark{"byteconv/convert64" + suffix, 8,
+            [order](uint64_t n) {
+                return BenchConvert<uint64_t>(order,
+                    [](const ByteConverter& c, uint64_t v) { return c.Convert64(v); }, n);
+            }});
+    }
+
+    benches.push_back(Benchmark{"byteconv/convert16_static/swap", 2,
+        [](uint64_t n) {
+            return BenchConvertStatic<uint16_t>(
+                [](uint16_t v) { return ByteConverterT<SWAP_BYTE_ORDER>::Convert16(v); }, n);
+        }});
+    benches.push_back(Benchmark{"byteconv/convert32_static/swap", 4,
+        [](uint64_t n) {
+            return BenchConvertStatic<uint32_t>(
+                [](uint32_t v) { return ByteConverterT<SWAP_BYTE_ORDER>::Convert32(v); }, n);
+        }});
+    benches.push_back(Benchmark{"byteconv/convert64_static/swap", 8,
+        [](uint64_t n) {
+            return BenchConvertStatic<uint64_t>(
+                [](uint64_t v) { return ByteConverterT<SWAP_BYTE_ORDER>::Convert64(v); }, n);
+        }});
+
+    // 数组转换：scalar为逐个转换，simd为ConvertArrayN（实现见SwapArrayImplementation）
+    const char* array_paths[] = {"scalar", "simd"};
+    for (int i = 0; i < 2; i++) {
+        bool simd = i == 1;
+        std::string suffix = std::string("/") + array_paths[i];
+
+        benches.push_back(Benchmark{"byteconv/array16" + suffix, CONVERT_VALUES * 2.0,
+            [simd](uint64_t n) {
+                return BenchConvertArray<uint16_t>(simd,
+                    [](const ByteConverter& c, uint16_t v) { return c.Convert16(v); },
+                    [](const ByteConverter& c, const uint16_t* s, uint16_t* d, size_t k) {
+                        c.ConvertArray16(s, d, k);
+                    }, n);
+            }});
+        benches.push_back(Benchmark{"byteconv/array32" + suffix, CONVERT_VALUES * 4.0,
+            [simd](uint64_t n) {
+                return BenchConvertArray<uint32_t>(simd,
+                    [](const ByteConverter& c, uint32_t v) { return c.Convert32(v); },
+                    [](const ByteConverter& c, const uint32_t* s, uint32_t* d, size_t k) {
+                        c.ConvertArray32(s, d, k);
+                    }, n);
+            }});
+        benches.push_back(Benchmark{"byteconv/array64" + suffix, CONVERT_VALUES * 8.0,
+            [simd](uint64_t n) {
+                return BenchConvertArray<uint64_t>(simd,
+                    [](const ByteConverter& c, uint64_t v) { return c.Convert64(v); },
+                    [](const ByteConverter& c, const uint64_t* s, uint64_t* d, size_t k) {
+                        c.ConvertArray64(s, d, k);
+                    }, n);
+            }});
+    }
+
+    // 生产者数取1、2、4…，最后一项为max_producers
+    std::vector<int> producer_counts;
+    for (int producers = 1; producers < options.max_producers; producers *= 2) {
+        producer_counts.push_back(producers);
+    }
+    producer_counts.push_back(options.max_producers);
+
+    for (size_t i = 0; i < producer_counts.size(); i++) {
+        int producers = producer_counts[i];
+        benches.push_back(Benchmark{"mq/push/producers:" + std::to_string(producers),
+            static_cast<double>(QUEUE_MESSAGE_SIZE),
+            [producers](uint64_t n) { return BenchQueuePush(producers, n); }});
+    }
+    benches.push_back(Benchmark{"mq/get_messages", static_cast<double>(QUEUE_MESSAGE_SIZE),
+        [](uint64_t n) { return BenchQueueGetMessages(n); }});
+    benches.push_back(Benchmark{"mq/push_front", static_cast<double>(QUEUE_MESSAGE_SIZE),
+        [](uint64_t n) { return BenchQueuePushFront(n); }});
+
+    // switch: 单个回调内分支；function/static: 分发表中的std::function/编译期绑定的函数；default: 默认处理函数
+    const char* dispatch_modes[] = {"switch", "function", "static", "default"};
+    for (size_t i = 0; i < sizeof(dispatch_modes) / sizeof(dispatch_modes[0]); i++) {
+        std::string mode = dispatch_modes[i];
+        benches.push_back(Benchmark{"dispatch/" + mode, 0,
+            [mode](uint64_t n) { return BenchDispatch(mode, n); }});
+    }
+
+    // bytes/op为压缩前的字节数
+    for (size_t i = 0; i < sizeof(LZ_SIZES) / sizeof(LZ_SIZES[0]); i++) {
+        size_t size = LZ_SIZES[i];
+        std::string suffix = "/" + std::to_string(size);
+        benches.push_back(Benchmark{"lz/compress" + suffix, static_cast<double>(size),
+            [size](uint64_t n) { return BenchCompress(size, n); }});
+        benches.push_back(Benchmark{"lz/decompress" + suffix, static_cast<double>(size),
+            [size](uint64_t n) { return BenchDecompress(size, n); }});
+    }
+
+    return benches;
+}
+
+// 标定迭代次数使单轮耗时不少于min_ms，再重复测量
+static BenchResult RunBenchmark(const Benchmark& bench, const MicrobenchOptions& options) {
+    int64_t min_ns = static_cast<int64_t>(options.min_ms * 1e6);
+    uint64_t iterations = 64;
+
+    while (true) {
+        int64_t elapsed = bench.func(iterations);
+        if (elapsed >= min_ns) {
+            break;
+        }
+
+        // 按当前速度估算所需次数，留20%余量，每次最多放大10倍
+        double scale = elapsed > 0 ? 1.2 * min_ns / elapsed : 10.0;
+        scale = std::min(10.0, std::max(2.0, scale));
+        iterations = static_cast<uint64_t>(iterations * scale);
+    }
+
+    std::vector<double> samples;
+    for (int r = 0; r < options.repetitions; r++) {
+        samples.push_back(static_cast<double>(bench.func(iterations)) / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    BenchResult result;
+    result.name = bench.name;
+    result.iterations = iterations;
+    result.ns_per_op = samples[samples.size() / 2];
+    result.min_ns_per_op = samples[0];
+    result.bytes_per_op = bench.bytes_per_op;
+    return result;
+}
+
+static void PrintCsv(const std::vector<BenchResult>& results) {
+    printf("name,iterations,ns_per_op,min_ns_per_op,bytes_per_op\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        printf("%s,%llu,%.3f,%.3f,%.0f\n", r.name.c_str(), (unsigned long long)r.iterations,
+               r.ns_per_op, r.min_ns_per_op, r.bytes_per_op);
+    }
+}
+
+static void PrintJson(const std::vector<BenchResult>& results, const MicrobenchOptions& options) {
+    printf("{\n");
+    printf("  \"context\": {\"cpus\": %u, \"min_ms\": %.0f, \"repetitions\": %d, \"byteswap\": \"%s\"},\n",
+           std::thread::hardware_concurrency(), options.min_ms, options.repetitions,
+           SwapArrayImplementation());
+    printf("  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        printf("    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, "
+               "\"min_ns_per_op\": %.3f, \"bytes_per_op\": %.0f}%s\n",
+               r.name.c_str(), (unsigned long long)r.iterations, r.ns_per_op,
+               r.min_ns_per_op, r.bytes_per_op, i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+static void Usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-f json|csv] [-m min_ms] [-r repetitions] [-p max_producers] [-F filter]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    MicrobenchOptions options;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:m:r:p:F:")) != -1) {
+        switch (opt) {
+        case 'f': options.format = optarg; break;
+        case 'm': options.min_ms = atof(optarg); break;
+        case 'r': options.repetitions = atoi(optarg); break;
+        case 'p': options.max_producers = atoi(optarg); break;
+        case 'F': options.filter = optarg; break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ((options.format != "json" && options.format != "csv") || options.min_ms <= 0 ||
+        options.repetitions <= 0 || options.max_producers <= 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<Benchmark> benches = BuildBenchmarks(options);
+    std::vector<BenchResult> results;
+    for (size_t i = 0; i < benches.size(); i++) {
+        if (!options.filter.empty() && benches[i].name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        results.push_back(RunBenchmark(benches[i], options));
+    }
+
+    if (options.format == "csv") {
+        PrintCsv(results);
+    } else {
+        PrintJson(results, options);
+    }
+
+    return 0;
+}
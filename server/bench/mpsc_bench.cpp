@@ -0,0 +1,139 @@
+// 发送队列生产者扩展性基准
+//
+// 对比每连接无锁MPSC队列（MessageQueue）与原来的互斥锁队列：
+// N个生产者线程向同一个队列投递消息，一个消费者线程按事件循环的方式
+// PrepareIov/Consume取走数据，统计每秒投递的消息数。
+//
+// 用法：./mpsc_bench [每个生产者的消息数] [消息字节数] [最大生产者数]
+
+#include <sys/uio.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../message_queue.h"
+
+// 原来的互斥锁发送队列：所有投递和发送都竞争同一把锁
+class MutexQueue {
+public:
+    MutexQueue() : m_head_offset(0) {}
+
+    bool Push(const char* data, size_t len) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.push_back(PooledBytes(data, data + len));
+        return true;
+    }
+
+    int PrepareIov(struct iovec* iov, int max_iov) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int count = 0;
+        size_t offset = m_head_offset;
+        for (auto& entry : m_entries) {
+            if (count >= max_iov) {
+                break;
+            }
+            iov[count].iov_base = entry.data() + offset;
+            iov[count].iov_len = entry.size() - offset;
+            count++;
+            offset = 0;
+        }
+        return count;
+    }
+
+    void Consume(size_t bytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (bytes > 0 && !m_entries.empty()) {
+            size_t remaining = m_entries.front().size() - m_head_offset;
+            if (bytes < remaining) {
+                m_head_offset += bytes;
+                return;
+            }
+            bytes -= remaining;
+            m_entries.pop_front();
+            m_head_offset = 0;
+        }
+    }
+
+private:
+    std::deque<PooledBytes> m_entries;
+    size_t m_head_offset;
+    std::mutex m_mutex;
+};
+
+// 运行一轮：producers个线程各投递count条消息，返回每秒消息数
+template <typename Queue>
+static double RunRound(int producers, size_t count, size_t msg_size) {
+    Queue queue;
+    std::vector<char> payload(msg_size, 'x');
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    const size_t expected_bytes = static_cast<size_t>(producers) * count * msg_size;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; i++) {
+        threads.emplace_back([&]() {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (size_t n = 0; n < count; n++) {
+                queue.Push(payload.data(), payload.size());
+            }
+        });
+    }
+
+    while (ready.load() < producers) {
+        std::this_thread::yield();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+
+    // 消费者：模拟HandleWrite，假设每次sendmsg都能写出全部数据
+    struct iovec iov[IOV_MAX];
+    size_t consumed = 0;
+    while (consumed < expected_bytes) {
+        int n = queue.PrepareIov(iov, IOV_MAX);
+        if (n == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        size_t bytes = 0;
+        for (int i = 0; i < n; i++) {
+            bytes += iov[i].iov_len;
+        }
+        queue.Consume(bytes);
+        consumed += bytes;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return producers * count / seconds;
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    size_t msg_size = argc > 2 ? strtoul(argv[2], nullptr, 10) : 64;
+    int max_producers = argc > 3 ? atoi(argv[3]) : 16;
+
+    printf("messages/producer=%zu size=%zu hw_threads=%u\n",
+           count, msg_size, std::thread::hardware_concurrency());
+    printf("%-10s %16s %16s %8s\n", "producers", "mutex msg/s", "mpsc msg/s", "speedup");
+
+    for (int producers = 1; producers <= max_producers; producers *= 2) {
+        double mutex_rate = RunRound<MutexQueue>(producers, count, msg_size);
+        double mpsc_rate = RunRound<MessageQueue>(producers, count, msg_size);
+        printf("%-10d %16.0f %16.0f %7.2fx\n", producers, mutex_rate, mpsc_rate, mpsc_rate / mutex_rate);
+    }
+
+    return 0;
+}
@@ -0,0 +1,752 @@
+// TLV负载生成与往返延迟基准
+//
+// 多线程、基于epoll的客户端：每个线程一个epoll实例，负责一部分连接。请求帧用
+// TLVProtocol::SerializeMessage构造，发给main.cpp中的回显服务（响应类型为请求类型+1，
+// 内容相同），按连接内的先后顺序与响应配对，统计吞吐和往返延迟分布。
+// 服务端须以默认方式运行（不加verbose参数）：逐条打印消息时测到的主要是控制台输出的开销。
+//
+// - 闭环（默认）：每个连接保持depth个请求在途，收到一个响应就补发一个
+// - 开环（-r）：按总速率定时发送，不等待响应；延迟从计划发送时间算起，
+//   服务端变慢时请求排队的时间也计入结果，不会因为客户端跟着变慢而漏算（协调遗漏）
+// - 压缩（-z）：负载为类JSON文本，每个连接先完成压缩握手，不短于阈值的请求压缩发送，
+//   压缩的响应解压后再校验长度
+// - 帧格式（-V 2）：每个连接先协商v2变长头部，请求和响应都按v2编解码
+//
+// 用法：./tlv_bench [-h 地址] [-p 端口] [-c 连接数] [-t 线程数] [-s 负载字节数或最小-最大]
+//                   [-d 流水线深度] [-r 每秒请求数，0为闭环] [-D 测试秒数] [-w 预热秒数]
+//                   [-z 压缩阈值字节数，0为不压缩] [-V 帧格式1或2]
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../tlv_protocol.h"
+
+// 请求的消息类型，回显服务的响应类型为其加1
+static const uint16_t REQUEST_TYPE = 1;
+// 负载大小为区间时预先构造的帧数
+static const int FRAME_VARIANTS = 64;
+// 单次epoll_wait最多返回的事件数
+static const int BENCH_MAX_EVENTS = 256;
+// 压缩握手的消息类型和内置LZ压缩的编号（与epoll_server.h一致）
+static const uint16_t HANDSHAKE_TYPE = 0xFFFE;
+static const char HANDSHAKE_CODEC_LZ = 1;
+// 帧格式握手的消息类型（与epoll_server.h一致）
+static const uint16_t FORMAT_HANDSHAKE_TYPE = 0xFFFD;
+
+static int64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// 对数-线性分桶的延迟直方图（HDR风格）
+//
+// 小于SUB_COUNT的值每个值一个桶；更大的值按最高有效位分段，每段线性分为SUB_COUNT/2个桶，
+// 相对误差不超过2/SUB_COUNT。记录是O(1)的数组自增，各线程的直方图可以直接相加。
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 7;
+    static const uint64_t SUB_COUNT = 1u << SUB_BITS;
+    static const uint64_t HALF_COUNT = SUB_COUNT / 2;
+
+    LatencyHistogram()
+        : m_counts(SUB_COUNT + (64 - SUB_BITS) * HALF_COUNT, 0),
+          m_total(0), m_sum(0), m_min(UINT64_MAX), m_max(0) {}
+
+    void Record(uint64_t value) {
+        m_counts[IndexOf(value)]++;
+        m_total++;
+        m_sum += value;
+        if (value < m_min) {
+            m_min = value;
+        }
+        if (value > m_max) {
+            m_max = value;
+        }
+    }
+
+    void Merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < m_counts.size(); i++) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_total += other.m_total;
+        m_sum += other.m_sum;
+        if (other.m_min < m_min) {
+            m_min = other.m_min;
+        }
+        if (other.m_max > m_max) {
+            m_max = other.m_max;
+        }
+    }
+
+    // 分位数（0~1），返回所在桶的中点
+    uint64_t Percentile(double p) const {
+        if (m_total == 0) {
+            return 0;
+        }
+
+        uint64_t target = static_cast<uint64_t>(p * m_total + 0.5);
+        if (target == 0) {
+            target = 1;
+        }
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < m_counts.size(); i++) {
+            seen += m_counts[i];
+            if (seen >= target) {
+                uint64_t value = MidValueOf(i);
+                return value < m_max ? value : m_max;
+            }
+        }
+        return m_max;
+    }
+
+    uint64_t Count() const { return m_total; }
+    uint64_t Min() const { return m_total ? m_min : 0; }
+    uint64_t Max() const { return m_max; }
+    double Mean() const { return m_total ? static_cast<double>(m_sum) / m_total : 0.0; }
+
+private:
+    static size_t IndexOf(uint64_t value) {
+        if (value < SUB_COUNT) {
+            return static_cast<size_t>(value);
+        }
+
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - SUB_BITS + 1;
+        uint64_t top = value >> shift;  // [HALF_COUNT, SUB_COUNT)
+        return static_cast<size_t>(SUB_COUNT + (shift - 1) * HALF_COUNT + (top - HALF_COUNT));
+    }
+
+    static uint64_t MidValueOf(size_t index) {
+        if (index < SUB_COUNT) {
+            return index;
+        }
+
+        uint64_t k = index - SUB_COUNT;
+        int shift = static_cast<int>(k / HALF_COUNT) + 1;
+        uint64_t top = k % HALF_COUNT + HALF_COUNT;
+        return (top << shift) + ((static_cast<uint64_t>(1) << shift) >> 1);
+    }
+
+    std::vector<uint64_t> m_counts;
+    uint64_t m_total;
+    uint64_t m_sum;
+    uint64_t m_min;
+    uint64_t m_max;
+};
+
+// 测试参数
+struct BenchOptions {
+    std::string host;
+    int port;
+    int connections;
+    int threads;
+    size_t min_payload;
+    size_t max_payload;
+    int depth;          // 闭环时每个连接在途的请求数
+    double rate;        // 开环时的总请求速率（每秒），0表示闭环
+    double duration;    // 测试时长（秒，含预热）
+    double warmup;      // 预热时长（秒），期间的结果不计入统计
+    size_t compress_threshold;  // 请求的压缩阈值（字节），0表示不压缩也不握手
+    TLVFormat format;           // 帧格式，v2时连接后先协商
+
+    BenchOptions()
+        : host("127.0.0.1"), port(8888), connections(64), threads(4),
+          min_payload(64), max_payload(64), depth(1), rate(0),
+          duration(10), warmup(1), compress_threshold(0), format(TLVFormat::V1) {}
+};
+
+// 预先构造的请求帧
+struct Frame {
+    std::vector<char> data;
+    uint32_t payload;   // 未压缩的负载字节数
+};
+
+// 在途请求
+struct InflightRequest {
+    int64_t send_ns;     // 发送时间（开环为计划发送时间）
+    uint32_t payload;
+};
+
+// 客户端连接
+struct BenchConn {
+    int fd;
+    std::vector<char> out;      // 待发送数据
+    size_t out_offset;          // out中已发送的字节数
+    std::vector<char> in;       // 已接收、尚未解析的数据
+    std::deque<InflightRequest> inflight;
+    bool write_armed;
+    bool failed;
+
+    BenchConn() : fd(-1), out_offset(0), write_armed(false), failed(false) {}
+};
+
+// 单个线程的结果
+struct WorkerResult {
+    LatencyHistogram histogram;
+    uint64_t sent;
+    uint64_t responses;         // 统计窗口内收到的响应数
+    uint64_t response_bytes;    // 统计窗口内收到的响应字节数（线上字节）
+    uint64_t plain_bytes;       // 上述响应解压后的内容字节数
+    uint64_t errors;
+    uint64_t failed_conns;
+
+    WorkerResult() : sent(0), responses(0), response_bytes(0), plain_bytes(0), errors(0), failed_conns(0) {}
+};
+
+class BenchWorker {
+public:
+    BenchWorker(const BenchOptions& options, int index, int connections,
+                std::atomic<int>& ready, std::atomic<int64_t>& start_ns)
+        : m_options(options), m_index(index), m_connection_count(connections),
+          m_ready(ready), m_start_ns(start_ns), m_epoll_fd(-1), m_next_frame(0), m_next_conn(0) {}
+
+    ~BenchWorker() {
+        for (size_t i = 0; i < m_conns.size(); i++) {
+            if (m_conns[i].fd != -1) {
+                close(m_conns[i].fd);
+            }
+        }
+        if (m_epoll_fd != -1) {
+            close(m_epoll_fd);
+        }
+    }
+
+    void Run() {
+        m_protocol.SetFormat(m_options.format);
+        m_protocol.SetCompression(m_options.compress_threshold > 0);
+        BuildFrames();
+        Connect();
+
+        // 所有线程建好连接后同时开始
+        m_ready.fetch_add(1);
+        while (m_start_ns.load() == 0) {
+            std::this_thread::yield();
+        }
+
+        int64_t start = m_start_ns.load();
+        m_measure_start = start + static_cast<int64_t>(m_options.warmup * 1e9);
+        m_end = start + static_cast<int64_t>(m_options.duration * 1e9);
+
+        if (m_options.rate > 0) {
+            RunOpenLoop(start);
+        } else {
+            RunClosedLoop();
+        }
+    }
+
+    const WorkerResult& Result() const { return m_result; }
+
+private:
+    void BuildFrames() {
+        TLVProtocol protocol;
+        protocol.SetFormat(m_options.format);
+        unsigned seed = static_cast<unsigned>(m_index * 7919 + 1);
+        int variants = m_options.min_payload == m_options.max_payload ? 1 : FRAME_VARIANTS;
+
+        for (int i = 0; i < variants; i++) {
+            size_t span = m_options.max_payload - m_options.min_payload;
+            size_t size = m_options.min_payload + (span ? rand_r(&seed) % (span + 1) : 0);
+
+            TLVMessage msg;
+            msg.type = REQUEST_TYPE;
+            msg.length = static_cast<uint32_t>(size);
+            if (m_options.compress_threshold > 0) {
+                FillJson(msg.value, size, seed);
+            } else {
+                msg.value.assign(size, static_cast<char>('a' + i % 26));
+            }
+
+            Frame frame;
+            frame.payload = msg.length;
+            protocol.SerializeFrame(msg.type, msg.value.data(), msg.length, frame.data, m_options.compress_threshold);
+            m_frames.push_back(frame);
+        }
+    }
+
+    // 生成size字节类似JSON记录数组的文本，压缩率接近真实的结构化负载
+    static void FillJson(PooledBytes& value, size_t size, unsigned& seed) {
+        static const char* const names[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot"};
+        std::string text = "[";
+        char record[160];
+        while (text.size() < size) {
+            int id = rand_r(&seed) % 100000;
+            snprintf(record, sizeof(record),
+                     "{\"id\":%d,\"name\":\"%s\",\"score\":%d,\"active\":%s,\"tags\":[\"%s\",\"%s\"]},",
+                     id, names[id % 6], rand_r(&seed) % 1000, (id & 1) ? "true" : "false",
+                     names[(id / 6) % 6], names[(id / 36) % 6]);
+            text += record;
+        }
+        value.assign(text.begin(), text.begin() + size);
+    }
+
+    // 阻塞地发送一条握手消息并读取响应，响应内容的第一个字节等于value时返回true
+    // （握手时没有其他在途请求，读到的数据只有这一条响应）
+    static bool Handshake(int fd, TLVProtocol& protocol, uint16_t type, char value) {
+        std::vector<char> request;
+        protocol.SerializeFrame(type, &value, 1, request);
+        if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+            return false;
+        }
+
+        char reply[64];
+        size_t received = 0;
+        TLVView view;
+        size_t consumed = 0;
+        while (!protocol.ParseView(reply, received, view, consumed)) {
+            if (consumed != 0 || received == sizeof(reply)) {
+                return false;
+            }
+            ssize_t n = recv(fd, reply + received, sizeof(reply) - received, 0);
+            if (n <= 0) {
+                if (n == -1 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            received += static_cast<size_t>(n);
+        }
+
+        return view.type == type && view.length >= 1 && view.value[0] == value;
+    }
+
+    // 先协商帧格式（用v1），再按协商后的格式协商压缩
+    bool Negotiate(int fd) {
+        if (m_options.format != TLVFormat::V1) {
+            TLVProtocol v1;
+            if (!Handshake(fd, v1, FORMAT_HANDSHAKE_TYPE, static_cast<char>(m_options.format))) {
+                return false;
+            }
+        }
+        if (m_options.compress_threshold > 0) {
+            return Handshake(fd, m_protocol, HANDSHAKE_TYPE, HANDSHAKE_CODEC_LZ);
+        }
+        return true;
+    }
+
+    void Connect() {
+        m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(m_options.port);
+        addr.sin_addr.s_addr = inet_addr(m_options.host.c_str());
+
+        m_conns.resize(m_connection_count);
+        for (int i = 0; i < m_connection_count; i++) {
+            BenchConn& conn = m_conns[i];
+            conn.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (conn.fd == -1 || connect(conn.fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+                fprintf(stderr, "connect failed: %s\n", strerror(errno));
+                conn.failed = true;
+                m_result.failed_conns++;
+                continue;
+            }
+
+            int one = 1;
+            setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            if (!Negotiate(conn.fd)) {
+                fprintf(stderr, "handshake failed\n");
+                conn.failed = true;
+                m_result.failed_conns++;
+                continue;
+            }
+            fcntl(conn.fd, F_SETFL, fcntl(conn.fd, F_GETFL, 0) | O_NONBLOCK);
+
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u32 = static_cast<uint32_t>(i);
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, conn.fd, &ev);
+        }
+    }
+
+    // 向连接追加一个请求
+    void Enqueue(BenchConn& conn, int64_t send_ns) {
+        const Frame& frame = m_frames[m_next_frame];
+        m_next_frame = (m_next_frame + 1) % m_frames.size();
+
+        conn.out.insert(conn.out.end(), frame.data.begin(), frame.data.end());
+
+        InflightRequest request;
+        request.send_ns = send_ns;
+        request.payload = frame.payload;
+        conn.inflight.push_back(request);
+        m_result.sent++;
+    }
+
+    void Flush(BenchConn& conn, uint32_t index) {
+        while (conn.out_offset < conn.out.size()) {
+            ssize_t n = send(conn.fd, conn.out.data() + conn.out_offset,
+                             conn.out.size() - conn.out_offset, MSG_NOSIGNAL);
+            if (n == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                Fail(conn);
+                return;
+            }
+            conn.out_offset += static_cast<size_t>(n);
+        }
+
+        if (conn.out_offset == conn.out.size()) {
+            conn.out.clear();
+            conn.out_offset = 0;
+        } else if (conn.out_offset > conn.out.size() / 2) {
+            conn.out.erase(conn.out.begin(), conn.out.begin() + conn.out_offset);
+            conn.out_offset = 0;
+        }
+
+        // 发送缓冲区写满时等待可写
+        bool want_write = !conn.out.empty();
+        if (want_write != conn.write_armed) {
+            struct epoll_event ev;
+            ev.events = want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+            ev.data.u32 = index;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+            conn.write_armed = want_write;
+        }
+    }
+
+    void Fail(BenchConn& conn) {
+        if (conn.failed) {
+            return;
+        }
+        conn.failed = true;
+        m_result.failed_conns++;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    }
+
+    // 读取并配对响应，返回收到的响应数
+    int ReadResponses(BenchConn& conn) {
+        char buffer[65536];
+        int responses = 0;
+
+        while (true) {
+            ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+            if (n == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    Fail(conn);
+                }
+                break;
+            }
+            if (n == 0) {
+                Fail(conn);
+                break;
+            }
+            conn.in.insert(conn.in.end(), buffer, buffer + n);
+        }
+
+        int64_t now = NowNs();
+        size_t offset = 0;
+        while (true) {
+            TLVView view;
+            size_t consumed = 0;
+            if (!m_protocol.ParseView(conn.in.data() + offset, conn.in.size() - offset, view, consumed)) {
+                break;
+            }
+            offset += consumed;
+
+            if (conn.inflight.empty()) {
+                m_result.errors++;
+                continue;
+            }
+
+            InflightRequest request = conn.inflight.front();
+            conn.inflight.pop_front();
+            responses++;
+
+            if (view.compressed && !m_protocol.Decompress(view, m_inflated, view)) {
+                m_result.errors++;
+                continue;
+            }
+
+            if (view.type != REQUEST_TYPE + 1 || view.length != request.payload) {
+                m_result.errors++;
+                continue;
+            }
+
+            // 只统计预热结束后发出、测试结束前收到的请求
+            if (request.send_ns >= m_measure_start && now <= m_end) {
+                m_result.histogram.Record(static_cast<uint64_t>(now - request.send_ns));
+                m_result.responses++;
+                m_result.response_bytes += consumed;
+                m_result.plain_bytes += view.length;
+            }
+        }
+
+        if (offset > 0) {
+            conn.in.erase(conn.in.begin(), conn.in.begin() + offset);
+        }
+
+        return responses;
+    }
+
+    void RunClosedLoop() {
+        int64_t now = NowNs();
+        for (size_t i = 0; i < m_conns.size(); i++) {
+            if (m_conns[i].failed) {
+                continue;
+            }
+            for (int d = 0; d < m_options.depth; d++) {
+                Enqueue(m_conns[i], now);
+            }
+            Flush(m_conns[i], static_cast<uint32_t>(i));
+        }
+
+        struct epoll_event events[BENCH_MAX_EVENTS];
+        while (NowNs() < m_end) {
+            int nfds = epoll_wait(m_epoll_fd, events, BENCH_MAX_EVENTS, 10);
+            for (int i = 0; i < nfds; i++) {
+                uint32_t index = events[i].data.u32;
+                BenchConn& conn = m_conns[index];
+                if (conn.failed) {
+                    continue;
+                }
+
+                if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                    int responses = ReadResponses(conn);
+
+                    // 每收到一个响应补发一个请求，保持depth个在途
+                    int64_t send_ns = NowNs();
+                    if (send_ns < m_end) {
+                        for (int r = 0; r < responses; r++) {
+                            Enqueue(conn, send_ns);
+                        }
+                    }
+                }
+
+                if (!conn.failed) {
+                    Flush(conn, index);
+                }
+            }
+        }
+    }
+
+    void RunOpenLoop(int64_t start) {
+        // 各线程平分总速率，按固定间隔计划发送时间
+        double thread_rate = m_options.rate / m_options.threads;
+        int64_t interval = static_cast<int64_t>(1e9 / thread_rate);
+        if (interval <= 0) {
+            interval = 1;
+        }
+        int64_t next_send = start + (interval * m_index) / m_options.threads;
+
+        std::vector<char> touched(m_conns.size(), 0);
+        std::vector<uint32_t> touched_list;
+
+        struct epoll_event events[BENCH_MAX_EVENTS];
+        while (true) {
+            int64_t now = NowNs();
+            if (now >= m_end) {
+                break;
+            }
+
+            // 发出所有已到计划时间的请求，轮流分配给各连接
+            while (next_send <= now && next_send < m_end) {
+                uint32_t index = NextLiveConn();
+                if (index == UINT32_MAX) {
+                    return;
+                }
+                Enqueue(m_conns[index], next_send);
+                if (!touched[index]) {
+                    touched[index] = 1;
+                    touched_list.push_back(index);
+                }
+                next_send += interval;
+            }
+
+            for (size_t i = 0; i < touched_list.size(); i++) {
+                uint32_t index = touched_list[i];
+                touched[index] = 0;
+                if (!m_conns[index].failed) {
+                    Flush(m_conns[index], index);
+                }
+            }
+            touched_list.clear();
+
+            int64_t wait_ns = next_send - NowNs();
+            int timeout = wait_ns > 0 ? static_cast<int>(wait_ns / 1000000) : 0;
+            int nfds = epoll_wait(m_epoll_fd, events, BENCH_MAX_EVENTS, timeout);
+            for (int i = 0; i < nfds; i++) {
+                uint32_t index = events[i].data.u32;
+                BenchConn& conn = m_conns[index];
+                if (conn.failed) {
+                    continue;
+                }
+                if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                    ReadResponses(conn);
+                }
+                if (!conn.failed && (events[i].events & EPOLLOUT)) {
+                    Flush(conn, index);
+                }
+            }
+        }
+    }
+
+    uint32_t NextLiveConn() {
+        for (size_t tries = 0; tries < m_conns.size(); tries++) {
+            uint32_t index = static_cast<uint32_t>(m_next_conn);
+            m_next_conn = (m_next_conn + 1) % m_conns.size();
+            if (!m_conns[index].failed) {
+                return index;
+            }
+        }
+        return UINT32_MAX;
+    }
+
+    const BenchOptions& m_options;
+    int m_index;
+    int m_connection_count;
+    std::atomic<int>& m_ready;
+    std::atomic<int64_t>& m_start_ns;
+
+    int m_epoll_fd;
+    std::vector<BenchConn> m_conns;
+    std::vector<Frame> m_frames;
+    size_t m_next_frame;
+    size_t m_next_conn;
+    TLVProtocol m_protocol;
+    std::vector<char> m_inflated;   // 解压压缩响应的缓冲区
+    int64_t m_measure_start;
+    int64_t m_end;
+    WorkerResult m_result;
+};
+
+static void Usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [-h host] [-p port] [-c connections] [-t threads] [-s bytes|min-max]\n"
+            "          [-d depth] [-r requests_per_sec (0 = closed loop)] [-D seconds] [-w warmup_seconds]\n"
+            "          [-z compress_threshold_bytes (0 = off)] [-V frame_format (1|2)]\n"
+            "run epoll_server without the verbose argument; per-message logging dominates the results\n",
+            prog);
+}
+
+static bool ParsePayload(const char* arg, BenchOptions& options) {
+    const char* dash = strchr(arg, '-');
+    options.min_payload = static_cast<size_t>(strtoul(arg, nullptr, 10));
+    options.max_payload = dash ? static_cast<size_t>(strtoul(dash + 1, nullptr, 10)) : options.min_payload;
+    return options.min_payload <= options.max_payload;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:t:s:d:r:D:w:z:V:")) != -1) {
+        switch (opt) {
+        case 'h': options.host = optarg; break;
+        case 'p': options.port = atoi(optarg); break;
+        case 'c': options.connections = atoi(optarg); break;
+        case 't': options.threads = atoi(optarg); break;
+        case 's':
+            if (!ParsePayload(optarg, options)) {
+                Usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'd': options.depth = atoi(optarg); break;
+        case 'r': options.rate = atof(optarg); break;
+        case 'D': options.duration = atof(optarg); break;
+        case 'w': options.warmup = atof(optarg); break;
+        case 'z': options.compress_threshold = static_cast<size_t>(strtoul(optarg, nullptr, 10)); break;
+        case 'V': options.format = atoi(optarg) == 2 ? TLVFormat::V2 : TLVFormat::V1; break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (options.connections <= 0 || options.threads <= 0 || options.depth <= 0 ||
+        options.duration <= options.warmup) {
+        Usage(argv[0]);
+        return 1;
+    }
+    if (options.threads > options.connections) {
+        options.threads = options.connections;
+    }
+
+    std::atomic<int> ready(0);
+    std::atomic<int64_t> start_ns(0);
+    std::vector<std::unique_ptr<BenchWorker>> workers;
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < options.threads; i++) {
+        int count = options.connections / options.threads + (i < options.connections % options.threads ? 1 : 0);
+        workers.push_back(std::unique_ptr<BenchWorker>(new BenchWorker(options, i, count, ready, start_ns)));
+    }
+    for (int i = 0; i < options.threads; i++) {
+        threads.push_back(std::thread(&BenchWorker::Run, workers[i].get()));
+    }
+
+    while (ready.load() < options.threads) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    start_ns.store(NowNs());
+
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    WorkerResult total;
+    for (size_t i = 0; i < workers.size(); i++) {
+        const WorkerResult& result = workers[i]->Result();
+        total.histogram.Merge(result.histogram);
+        total.sent += result.sent;
+        total.responses += result.responses;
+        total.response_bytes += result.response_bytes;
+        total.plain_bytes += result.plain_bytes;
+        total.errors += result.errors;
+        total.failed_conns += result.failed_conns;
+    }
+
+    double window = options.duration - options.warmup;
+    const LatencyHistogram& h = total.histogram;
+
+    if (options.rate > 0) {
+        printf("mode: open loop, target %.0f req/s\n", options.rate);
+    } else {
+        printf("mode: closed loop, depth %d\n", options.depth);
+    }
+    printf("connections: %d  threads: %d  payload: %zu-%zu bytes  frame format: v%d\n",
+           options.connections, options.threads, options.min_payload, options.max_payload,
+           static_cast<int>(options.format));
+    printf("duration: %.1fs (warmup %.1fs)\n", options.duration, options.warmup);
+    printf("requests sent: %llu  responses: %llu  errors: %llu  failed connections: %llu\n",
+           (unsigned long long)total.sent, (unsigned long long)total.responses,
+           (unsigned long long)total.errors, (unsigned long long)total.failed_conns);
+    printf("throughput: %.0f req/s  %.2f MB/s\n",
+           total.responses / window, total.response_bytes / window / (1024.0 * 1024.0));
+    if (options.compress_threshold > 0 && total.plain_bytes > 0) {
+        printf("compression: threshold %zu bytes  response payload %.1f%% of original on the wire\n",
+               options.compress_threshold, 100.0 * total.response_bytes / total.plain_bytes);
+    }
+    printf("latency (us): min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p999 %.1f  max %.1f  mean %.1f\n",
+           h.Min() / 1e3, h.Percentile(0.50) / 1e3, h.Percentile(0.90) / 1e3,
+           h.Percentile(0.99) / 1e3, h.Percentile(0.999) / 1e3, h.Max() / 1e3, h.Mean() / 1e3);
+
+    return total.errors == 0 && total.failed_conns == 0 ? 0 : 2;
+}
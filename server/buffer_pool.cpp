@@ -0,0 +1,285 @@
+#include "buffer_pool.h"
+#include <cstdlib>
+
+// 每个线程每个级别最多缓存的内存块数，超过后把一半移到全局仓库
+static const size_t THREAD_CACHE_LIMIT = 64;
+// 线程缓存为空时从全局仓库一次取回的内存块数
+static const size_t DEPOT_REFILL_BATCH = 16;
+// 默认缓存上限 64MB
+static const size_t DEFAULT_MAX_RETAINED = 64 * 1024 * 1024;
+
+// 当前线程的缓存是否已随线程退出而析构
+static thread_local bool t_cache_destroyed = false;
+
+// 线程缓存：只由所属线程修改空闲链表，统计计数可被其他线程读取
+struct BufferPool::ThreadCache {
+    FreeBlock* heads[CLASS_COUNT];
+    size_t counts[CLASS_COUNT];
+    std::atomic<uint64_t> hits[CLASS_COUNT];
+    std::atomic<uint64_t> misses[CLASS_COUNT];
+    
+    ThreadCache() {
+        for (size_t i = 0; i < CLASS_COUNT; i++) {
+            heads[i] = nullptr;
+            counts[i] = 0;
+            hits[i] = 0;
+            misses[i] = 0;
+        }
+        
+        BufferPool& pool = BufferPool::Instance();
+        std::lock_guard<std::mutex> lock(pool.m_caches_mutex);
+        pool.m_caches.push_back(this);
+    }
+    
+    ~ThreadCache() {
+        BufferPool& pool = BufferPool::Instance();
+        
+        // 缓存的内存块交回全局仓库，缓存额度保持不变
+        for (size_t i = 0; i < CLASS_COUNT; i++) {
+            pool.FlushToDepot(this, i, 0);
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(pool.m_caches_mutex);
+            for (size_t i = 0; i < CLASS_COUNT; i++) {
+                pool.m_retired_hits[i] += hits[i].load(std::memory_order_relaxed);
+                pool.m_retired_misses[i] += misses[i].load(std::memory_order_relaxed);
+            }
+            
+            for (size_t i = 0; i < pool.m_caches.size(); i++) {
+                if (pool.m_caches[i] == this) {
+                    pool.m_caches[i] = pool.m_caches.back();
+                    pool.m_caches.pop_back();
+                    break;
+                }
+            }
+        }
+        
+        t_cache_destroyed = true;
+    }
+};
+
+/**
+ * @brief 获取全局缓冲区池。
+ *
+ * 实例有意不析构：其他静态对象或线程缓存可能在程序退出的最后阶段才释放内存。
+ */
+BufferPool& BufferPool::Instance() {
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+BufferPool::BufferPool()
+    : m_retained_bytes(0), m_max_retained_bytes(DEFAULT_MAX_RETAINED), m_large_allocs(0) {
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        m_depot[i] = nullptr;
+        m_depot_count[i] = 0;
+        m_retired_hits[i] = 0;
+        m_retired_misses[i] = 0;
+    }
+}
+
+BufferPool::~BufferPool() {
+    Trim();
+}
+
+size_t BufferPool::ClassIndex(size_t size) {
+    size_t shift = MIN_BLOCK_SHIFT;
+    while ((static_cast<size_t>(1) << shift) < size) {
+        shift++;
+        if (shift > MAX_BLOCK_SHIFT) {
+            return CLASS_COUNT;
+        }
+    }
+    
+    return shift - MIN_BLOCK_SHIFT;
+}
+
+BufferPool::ThreadCache* BufferPool::LocalCache() {
+    if (t_cache_destroyed) {
+        return nullptr;
+    }
+    
+    static thread_local ThreadCache cache;
+    return &cache;
+}
+
+bool BufferPool::ReserveRetained(size_t block_size) {
+    size_t max_bytes = m_max_retained_bytes.load(std::memory_order_relaxed);
+    size_t retained = m_retained_bytes.fetch_add(block_size, std::memory_order_relaxed);
+    
+    if (retained + block_size > max_bytes) {
+        m_retained_bytes.fetch_sub(block_size, std::memory_order_relaxed);
+        return false;
+    }
+    
+    return true;
+}
+
+void BufferPool::FlushToDepot(ThreadCache* cache, size_t index, size_t keep) {
+    if (cache->counts[index] <= keep) {
+        return;
+    }
+    
+    // 先在锁外摘下要移走的链表段
+    FreeBlock* first = cache->heads[index];
+    FreeBlock* last = first;
+    size_t moved = 1;
+    while (cache->counts[index] - moved > keep) {
+        last = last->next;
+        moved++;
+    }
+    
+    cache->heads[index] = last->next;
+    cache->counts[index] -= moved;
+    
+    std::lock_guard<std::mutex> lock(m_depot_mutex);
+    last->next = m_depot[index];
+    m_depot[index] = first;
+    m_depot_count[index] += moved;
+}
+
+void* BufferPool::Allocate(size_t size) {
+    size_t index = ClassIndex(size);
+    if (index == CLASS_COUNT) {
+        m_large_allocs.fetch_add(1, std::memory_order_relaxed);
+        return malloc(size);
+    }
+    
+    size_t block_size = static_cast<size_t>(1) << (index + MIN_BLOCK_SHIFT);
+    ThreadCache* cache = LocalCache();
+    
+    // 线程缓存为空时从全局仓库取回一批
+    if (cache && !cache->heads[index]) {
+        std::lock_guard<std::mutex> lock(m_depot_mutex);
+        while (m_depot[index] && cache->counts[index] < DEPOT_REFILL_BATCH) {
+            FreeBlock* block = m_depot[index];
+            m_depot[index] = block->next;
+            m_depot_count[index]--;
+            
+            block->next = cache->heads[index];
+            cache->heads[index] = block;
+            cache->counts[index]++;
+        }
+    }
+    
+    if (cache && cache->heads[index]) {
+        FreeBlock* block = cache->heads[index];
+        cache->heads[index] = block->next;
+        cache->counts[index]--;
+        m_retained_bytes.fetch_sub(block_size, std::memory_order_relaxed);
+        cache->hits[index].fetch_add(1, std::memory_order_relaxed);
+        return block;
+    }
+    
+    if (cache) {
+        cache->misses[index].fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    return malloc(block_size);
+}
+
+void BufferPool::Deallocate(void* ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    
+    size_t index = ClassIndex(size);
+    if (index == CLASS_COUNT) {
+        free(ptr);
+        return;
+    }
+    
+    // 超过缓存上限的内存块直接还给系统
+    size_t block_size = static_cast<size_t>(1) << (index + MIN_BLOCK_SHIFT);
+    if (!ReserveRetained(block_size)) {
+        free(ptr);
+        return;
+    }
+    
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    ThreadCache* cache = LocalCache();
+    
+    // 线程正在退出，直接放回全局仓库
+    if (!cache) {
+        std::lock_guard<std::mutex> lock(m_depot_mutex);
+        block->next = m_depot[index];
+        m_depot[index] = block;
+        m_depot_count[index]++;
+        return;
+    }
+    
+    block->next = cache->heads[index];
+    cache->heads[index] = block;
+    cache->counts[index]++;
+    
+    if (cache->counts[index] > THREAD_CACHE_LIMIT) {
+        FlushToDepot(cache, index, THREAD_CACHE_LIMIT / 2);
+    }
+}
+
+void BufferPool::SetMaxRetainedBytes(size_t bytes) {
+    m_max_retained_bytes.store(bytes, std::memory_order_relaxed);
+}
+
+size_t BufferPool::GetMaxRetainedBytes() const {
+    return m_max_retained_bytes.load(std::memory_order_relaxed);
+}
+
+size_t BufferPool::GetRetainedBytes() const {
+    return m_retained_bytes.load(std::memory_order_relaxed);
+}
+
+uint64_t BufferPool::GetLargeAllocations() const {
+    return m_large_allocs.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief 汇总各级别的命中/未命中次数。
+ *
+ * 计数由各线程缓存各自维护，读取时加锁遍历并加上已退出线程的累计值，
+ * 分配路径本身不需要加锁。
+ */
+std::vector<BufferPool::ClassStats> BufferPool::GetStats() {
+    std::vector<ClassStats> stats(CLASS_COUNT);
+    
+    {
+        std::lock_guard<std::mutex> lock(m_caches_mutex);
+        for (size_t i = 0; i < CLASS_COUNT; i++) {
+            stats[i].block_size = static_cast<size_t>(1) << (i + MIN_BLOCK_SHIFT);
+            stats[i].hits = m_retired_hits[i];
+            stats[i].misses = m_retired_misses[i];
+            
+            for (ThreadCache* cache : m_caches) {
+                stats[i].hits += cache->hits[i].load(std::memory_order_relaxed);
+                stats[i].misses += cache->misses[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_depot_mutex);
+        for (size_t i = 0; i < CLASS_COUNT; i++) {
+            stats[i].retained = m_depot_count[i];
+        }
+    }
+    
+    return stats;
+}
+
+void BufferPool::Trim() {
+    std::lock_guard<std::mutex> lock(m_depot_mutex);
+    
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        size_t block_size = static_cast<size_t>(1) << (i + MIN_BLOCK_SHIFT);
+        
+        while (m_depot[i]) {
+            FreeBlock* block = m_depot[i];
+            m_depot[i] = block->next;
+            free(block);
+            m_retained_bytes.fetch_sub(block_size, std::memory_order_relaxed);
+        }
+        
+        m_depot_count[i] = 0;
+    }
+}
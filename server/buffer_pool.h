@@ -0,0 +1,136 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// 缓冲区池
+//
+// 按2的幂分级（64B ~ 64KB）缓存空闲内存块，替代热路径上的malloc/free。
+// 每个线程有自己的无锁缓存，线程缓存满了或空了才和全局仓库交换一批内存块；
+// 缓存的总字节数受上限约束，超过上限的内存块直接还给系统。
+// 超过最大级别的请求直接走malloc。
+class BufferPool {
+public:
+    // 最小级别 64B，最大级别 64KB
+    static const size_t MIN_BLOCK_SHIFT = 6;
+    static const size_t MAX_BLOCK_SHIFT = 16;
+    static const size_t CLASS_COUNT = MAX_BLOCK_SHIFT - MIN_BLOCK_SHIFT + 1;
+    
+    // 单个级别的统计信息
+    struct ClassStats {
+        size_t block_size;   // 内存块大小
+        uint64_t hits;       // 从缓存分配的次数
+        uint64_t misses;     // 缓存为空、向系统申请的次数
+        size_t retained;     // 全局仓库中缓存的内存块数
+    };
+    
+    // 获取全局实例
+    static BufferPool& Instance();
+    
+    // 分配至少size字节
+    void* Allocate(size_t size);
+    
+    // 释放由Allocate分配的内存，size须与分配时相同
+    void Deallocate(void* ptr, size_t size);
+    
+    // 设置缓存内存的上限（字节）
+    void SetMaxRetainedBytes(size_t bytes);
+    
+    // 获取缓存内存的上限（字节）
+    size_t GetMaxRetainedBytes() const;
+    
+    // 获取当前缓存的内存总量（字节，含各线程缓存）
+    size_t GetRetainedBytes() const;
+    
+    // 获取各级别的统计信息
+    std::vector<ClassStats> GetStats();
+    
+    // 获取超过最大级别、直接向系统申请的次数
+    uint64_t GetLargeAllocations() const;
+    
+    // 释放全局仓库中缓存的所有内存块
+    void Trim();
+    
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+    
+    struct ThreadCache;
+    
+    BufferPool();
+    ~BufferPool();
+    BufferPool(const BufferPool&);
+    BufferPool& operator=(const BufferPool&);
+    
+    // 计算size对应的级别，超过最大级别返回CLASS_COUNT
+    static size_t ClassIndex(size_t size);
+    
+    // 获取当前线程的缓存，线程退出后返回nullptr
+    ThreadCache* LocalCache();
+    
+    // 尝试占用block_size字节的缓存额度
+    bool ReserveRetained(size_t block_size);
+    
+    // 把线程缓存中的一批内存块移到全局仓库
+    void FlushToDepot(ThreadCache* cache, size_t index, size_t keep);
+    
+    // 全局仓库中的空闲链表
+    FreeBlock* m_depot[CLASS_COUNT];
+    size_t m_depot_count[CLASS_COUNT];
+    std::mutex m_depot_mutex;
+    
+    std::atomic<size_t> m_retained_bytes;      // 当前缓存的字节数
+    std::atomic<size_t> m_max_retained_bytes;  // 缓存上限
+    std::atomic<uint64_t> m_large_allocs;      // 超大请求次数
+    
+    // 已退出线程的统计累计值，以及所有存活的线程缓存
+    uint64_t m_retired_hits[CLASS_COUNT];
+    uint64_t m_retired_misses[CLASS_COUNT];
+    std::vector<ThreadCache*> m_caches;
+    std::mutex m_caches_mutex;
+};
+
+// 基于BufferPool的STL分配器
+template <typename T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+    
+    PoolAllocator() {}
+    
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+    
+    T* allocate(size_t n) {
+        void* ptr = BufferPool::Instance().Allocate(n * sizeof(T));
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(ptr);
+    }
+    
+    void deallocate(T* ptr, size_t n) {
+        BufferPool::Instance().Deallocate(ptr, n * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+    return false;
+}
+
+// 使用缓冲区池的字节数组
+typedef std::vector<char, PoolAllocator<char>> PooledBytes;
+
+#endif // BUFFER_POOL_H
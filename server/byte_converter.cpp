@@ -1,5 +1,9 @@
 #include "byte_converter.h"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 ByteConverter::ByteConverter() 
     : m_byte_order(ByteOrder::BigEndian), 
       m_host_order(GetHostByteOrder()) {
@@ -17,64 +21,137 @@ ByteOrder ByteConverter::GetByteOrder() const {
 }
 
 ByteOrder ByteConverter::GetHostByteOrder() {
-    union {
-        uint16_t value;
-        uint8_t bytes[2];
-    } test = {0x0102};
-    
-    // 如果低地址存储低位字节，则为小端字节序
-    return (test.bytes[0] == 0x02) ? ByteOrder::LittleEndian : ByteOrder::BigEndian;
-}
-
-uint16_t ByteConverter::Convert16(uint16_t value) const {
-    // 如果主机字节序与目标字节序相同，则不需要转换
-    if (m_host_order == m_byte_order) {
-        return value;
+    return HOST_BYTE_ORDER;
+}
+
+void ByteConverter::ConvertArray16(const uint16_t* src, uint16_t* dst, size_t count) const {
+    if (m_host_order != m_byte_order) {
+        SwapArray16(src, dst, count);
+    } else if (src != dst) {
+        memcpy(dst, src, count * sizeof(uint16_t));
+    }
+}
+
+void ByteConverter::ConvertArray32(const uint32_t* src, uint32_t* dst, size_t count) const {
+    if (m_host_order != m_byte_order) {
+        SwapArray32(src, dst, count);
+    } else if (src != dst) {
+        memcpy(dst, src, count * sizeof(uint32_t));
+    }
+}
+
+void ByteConverter::ConvertArray64(const uint64_t* src, uint64_t* dst, size_t count) const {
+    if (m_host_order != m_byte_order) {
+        SwapArray64(src, dst, count);
+    } else if (src != dst) {
+        memcpy(dst, src, count * sizeof(uint64_t));
+    }
+}
+
+// 按块交换字节：处理bytes中整块的部分，返回已处理的字节数，剩余部分由调用方逐个交换
+typedef size_t (*SwapBlocksFunction)(const uint8_t* src, uint8_t* dst, size_t bytes, size_t width);
+
+#if defined(__x86_64__)
+// pshufb的重排表：每个元素内的字节倒序
+static const uint8_t SHUFFLE16[16] = {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14};
+static const uint8_t SHUFFLE32[16] = {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+static const uint8_t SHUFFLE64[16] = {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8};
+
+static const uint8_t* ShuffleFor(size_t width) {
+    return width == 2 ? SHUFFLE16 : (width == 4 ? SHUFFLE32 : SHUFFLE64);
+}
+
+// SSSE3：每次16字节，循环展开两次
+__attribute__((target("ssse3")))
+static size_t SwapBlocksSsse3(const uint8_t* src, uint8_t* dst, size_t bytes, size_t width) {
+    __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ShuffleFor(width)));
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(a, shuffle));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 16), _mm_shuffle_epi8(b, shuffle));
+    }
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(a, shuffle));
+    }
+    return i;
+}
+
+// AVX2：vpshufb只在各自的128位内重排，元素不跨越128位，同一张表复制到两半即可
+__attribute__((target("avx2")))
+static size_t SwapBlocksAvx2(const uint8_t* src, uint8_t* dst, size_t bytes, size_t width) {
+    __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ShuffleFor(width)));
+    __m256i shuffle = _mm256_broadcastsi128_si256(half);
+    size_t i = 0;
+    for (; i + 64 <= bytes; i += 64) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(a, shuffle));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), _mm256_shuffle_epi8(b, shuffle));
+    }
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(a, shuffle));
     }
-    
-    // 否则交换字节序
-    return Swap16(value);
+    return i;
 }
+#endif
 
-uint32_t ByteConverter::Convert32(uint32_t value) const {
-    // 如果主机字节序与目标字节序相同，则不需要转换
-    if (m_host_order == m_byte_order) {
-        return value;
+static size_t SwapBlocksNone(const uint8_t*, uint8_t*, size_t, size_t) {
+    return 0;
+}
+
+struct SwapImplementation {
+    SwapBlocksFunction function;
+    const char* name;
+};
+
+static SwapImplementation SelectSwapImplementation() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SwapImplementation{&SwapBlocksAvx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return SwapImplementation{&SwapBlocksSsse3, "ssse3"};
     }
-    
-    // 否则交换字节序
-    return Swap32(value);
+#endif
+    return SwapImplementation{&SwapBlocksNone, "scalar"};
 }
 
-uint64_t ByteConverter::Convert64(uint64_t value) const {
-    // 如果主机字节序与目标字节序相同，则不需要转换
-    if (m_host_order == m_byte_order) {
-        return value;
+static const SwapImplementation g_swap = SelectSwapImplementation();
+
+/**
+ * @brief 批量交换16位元素的字节序。
+ *
+ * 整块部分交给SIMD实现，不足一块的尾部逐个用bswap交换。
+ */
+void SwapArray16(const uint16_t* src, uint16_t* dst, size_t count) {
+    size_t done = g_swap.function(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst),
+                                  count * sizeof(uint16_t), sizeof(uint16_t)) / sizeof(uint16_t);
+    for (size_t i = done; i < count; i++) {
+        dst[i] = __builtin_bswap16(src[i]);
     }
-    
-    // 否则交换字节序
-    return Swap64(value);
 }
 
-uint16_t ByteConverter::Swap16(uint16_t value) {
-    return ((value & 0x00FF) << 8) | 
-           ((value & 0xFF00) >> 8);
+void SwapArray32(const uint32_t* src, uint32_t* dst, size_t count) {
+    size_t done = g_swap.function(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst),
+                                  count * sizeof(uint32_t), sizeof(uint32_t)) / sizeof(uint32_t);
+    for (size_t i = done; i < count; i++) {
+        dst[i] = __builtin_bswap32(src[i]);
+    }
 }
 
-uint32_t ByteConverter::Swap32(uint32_t value) {
-    return ((value & 0x000000FF) << 24) | 
-           ((value & 0x0000FF00) << 8)  | 
-           ((value & 0x00FF0000) >> 8)  | 
-           ((value & 0xFF000000) >> 24);
+void SwapArray64(const uint64_t* src, uint64_t* dst, size_t count) {
+    size_t done = g_swap.function(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst),
+                                  count * sizeof(uint64_t), sizeof(uint64_t)) / sizeof(uint64_t);
+    for (size_t i = done; i < count; i++) {
+        dst[i] = __builtin_bswap64(src[i]);
+    }
 }
 
-uint64_t ByteConverter::Swap64(uint64_t value) {
-    return ((value & 0x00000000000000FFULL) << 56) | 
-           ((value & 0x000000000000FF00ULL) << 40) | 
-           ((value & 0x0000000000FF0000ULL) << 24) | 
-           ((value & 0x00000000FF000000ULL) << 8)  | 
-           ((value & 0x000000FF00000000ULL) >> 8)  | 
-           ((value & 0x0000FF0000000000ULL) >> 24) | 
-           ((value & 0x00FF000000000000ULL) >> 40) | 
-           ((value & 0xFF00000000000000ULL) >> 56);
+const char* SwapArrayImplementation() {
+    return g_swap.name;
 }
\ No newline at end of file
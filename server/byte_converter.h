@@ -1,7 +1,9 @@
 #ifndef BYTE_CONVERTER_H
 #define BYTE_CONVERTER_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 // 字节序枚举
 enum class ByteOrder {
@@ -9,7 +11,74 @@ enum class ByteOrder {
     BigEndian      // 大端字节序
 };
 
-// 字节序转换类
+// 编译期确定的主机字节序
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr ByteOrder HOST_BYTE_ORDER = ByteOrder::BigEndian;
+#else
+constexpr ByteOrder HOST_BYTE_ORDER = ByteOrder::LittleEndian;
+#endif
+
+// 批量交换数组中每个元素的字节序，src和dst可以相同（原地转换）但不能部分重叠。
+// x86-64上用pshufb（SSSE3，CPU支持时用AVX2）一次处理16/32字节，其他平台逐个交换
+void SwapArray16(const uint16_t* src, uint16_t* dst, size_t count);
+void SwapArray32(const uint32_t* src, uint32_t* dst, size_t count);
+void SwapArray64(const uint64_t* src, uint64_t* dst, size_t count);
+
+// 当前使用的批量交换实现（"avx2"、"ssse3"或"scalar"）
+const char* SwapArrayImplementation();
+
+// 编译期确定字节序的转换
+//
+// 目标字节序是模板参数，是否需要交换在编译期就已确定：与主机相同时转换函数就是原值，
+// 不同时是一条bswap指令，没有运行时判断。字节序固定的协议代码应优先使用。
+template <ByteOrder Order>
+class ByteConverterT {
+public:
+    // 是否需要交换字节
+    static constexpr bool NEEDS_SWAP = Order != HOST_BYTE_ORDER;
+    
+    static constexpr uint16_t Convert16(uint16_t value) {
+        return NEEDS_SWAP ? __builtin_bswap16(value) : value;
+    }
+    
+    static constexpr uint32_t Convert32(uint32_t value) {
+        return NEEDS_SWAP ? __builtin_bswap32(value) : value;
+    }
+    
+    static constexpr uint64_t Convert64(uint64_t value) {
+        return NEEDS_SWAP ? __builtin_bswap64(value) : value;
+    }
+    
+    // 转换count个元素，src和dst可以相同
+    static void ConvertArray16(const uint16_t* src, uint16_t* dst, size_t count) {
+        if (NEEDS_SWAP) {
+            SwapArray16(src, dst, count);
+        } else if (src != dst) {
+            memcpy(dst, src, count * sizeof(uint16_t));
+        }
+    }
+    
+    static void ConvertArray32(const uint32_t* src, uint32_t* dst, size_t count) {
+        if (NEEDS_SWAP) {
+            SwapArray32(src, dst, count);
+        } else if (src != dst) {
+            memcpy(dst, src, count * sizeof(uint32_t));
+        }
+    }
+    
+    static void ConvertArray64(const uint64_t* src, uint64_t* dst, size_t count) {
+        if (NEEDS_SWAP) {
+            SwapArray64(src, dst, count);
+        } else if (src != dst) {
+            memcpy(dst, src, count * sizeof(uint64_t));
+        }
+    }
+};
+
+// 网络字节序（大端）的转换
+typedef ByteConverterT<ByteOrder::BigEndian> NetworkByteConverter;
+
+// 字节序转换类（字节序在运行时设置）
 class ByteConverter {
 public:
     ByteConverter();
@@ -25,22 +94,28 @@ public:
     static ByteOrder GetHostByteOrder();
     
     // 16位整数转换
-    uint16_t Convert16(uint16_t value) const;
+    uint16_t Convert16(uint16_t value) const {
+        return m_host_order == m_byte_order ? value : __builtin_bswap16(value);
+    }
     
     // 32位整数转换
-    uint32_t Convert32(uint32_t value) const;
+    uint32_t Convert32(uint32_t value) const {
+        return m_host_order == m_byte_order ? value : __builtin_bswap32(value);
+    }
     
     // 64位整数转换
-    uint64_t Convert64(uint64_t value) const;
+    uint64_t Convert64(uint64_t value) const {
+        return m_host_order == m_byte_order ? value : __builtin_bswap64(value);
+    }
     
+    // 数组转换，src和dst可以相同
+    void ConvertArray16(const uint16_t* src, uint16_t* dst, size_t count) const;
+    void ConvertArray32(const uint32_t* src, uint32_t* dst, size_t count) const;
+    void ConvertArray64(const uint64_t* src, uint64_t* dst, size_t count) const;
+
 private:
     ByteOrder m_byte_order;  // 当前字节序
     ByteOrder m_host_order;  // 主机字节序
-    
-    // 字节交换函数
-    static uint16_t Swap16(uint16_t value);
-    static uint32_t Swap32(uint32_t value);
-    static uint64_t Swap64(uint64_t value);
 };
 
 #endif // BYTE_CONVERTER_H
\ No newline at end of file
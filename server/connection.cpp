@@ -0,0 +1,97 @@
+#include "connection.h"
+
+Connection::Connection(int fd, int reactor_index, const struct sockaddr_in& addr)
+    : fd(fd), reactor_index(reactor_index), addr(addr), state(ConnState::Connected),
+      write_armed(false), idle_timer(0), read_paused(false), over_high_water(false),
+      compress_output(false), frame_format(TLVFormat::V1), last_active_ms(0),
+      read_size(0), small_reads(0),
+      tag(0), recv_active(false), recv_cancelling(false), flush_pending(false), file_poll_armed(false),
+      bytes_received(0), bytes_sent(0), messages_received(0),
+      read_calls(0), write_calls(0), recv_buffer_capacity(recv_buffer.Capacity()), queued_since_ns(0),
+      batch_held(0), batch_timer(0), trace_id(0), trace_enqueued(0),
+      handler_scheduled(false) {
+}
+
+bool Connection::IsClosed() const {
+    return state.load(std::memory_order_acquire) == ConnState::Closed;
+}
+
+ConnectionStats Connection::GetStats() const {
+    ConnectionStats stats;
+    stats.reactor = reactor_index;
+    stats.bytes_received = bytes_received.load(std::memory_order_relaxed);
+    stats.bytes_sent = bytes_sent.load(std::memory_order_relaxed);
+    stats.messages_received = messages_received.load(std::memory_order_relaxed);
+    stats.read_calls = read_calls.load(std::memory_order_relaxed);
+    stats.write_calls = write_calls.load(std::memory_order_relaxed);
+    stats.read_size = read_size.load(std::memory_order_relaxed);
+    stats.recv_buffer_capacity = recv_buffer_capacity.load(std::memory_order_relaxed);
+    return stats;
+}
+
+ConnectionTable::ConnectionTable() {
+}
+
+ConnectionTable::~ConnectionTable() {
+}
+
+void ConnectionTable::Init(size_t capacity) {
+    m_slots.clear();
+    m_slots.resize(capacity);
+}
+
+size_t ConnectionTable::Capacity() const {
+    return m_slots.size();
+}
+
+std::shared_ptr<Connection> ConnectionTable::Get(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= m_slots.size()) {
+        return std::shared_ptr<Connection>();
+    }
+    
+    return std::atomic_load(&m_slots[fd]);
+}
+
+/**
+ * @brief 取得连接的裸指针。
+ *
+ * 槽位只由连接所属的事件循环线程修改，因此该线程自己读取时不需要原子操作，
+ * 这是IO路径上的快速查找。
+ */
+Connection* ConnectionTable::GetLocal(int fd) const {
+    if (fd < 0 || static_cast<size_t>(fd) >= m_slots.size()) {
+        return nullptr;
+    }
+    
+    return m_slots[fd].get();
+}
+
+bool ConnectionTable::Insert(const std::shared_ptr<Connection>& conn) {
+    if (conn->fd < 0 || static_cast<size_t>(conn->fd) >= m_slots.size()) {
+        return false;
+    }
+    
+    std::atomic_store(&m_slots[conn->fd], conn);
+    return true;
+}
+
+void ConnectionTable::Remove(int fd) {
+    if (fd < 0 || static_cast<size_t>(fd) >= m_slots.size()) {
+        return;
+    }
+    
+    std::atomic_store(&m_slots[fd], std::shared_ptr<Connection>());
+}
+
+std::vector<std::shared_ptr<Connection>> ConnectionTable::TakeAll() {
+    std::vector<std::shared_ptr<Connection>> conns;
+    
+    for (auto& slot : m_slots) {
+        if (slot) {
+            conns.push_back(slot);
+            slot.reset();
+        }
+    }
+    
+    return conns;
+}
@@ -0,0 +1,146 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "recv_buffer.h"
+#include "message_queue.h"
+#include "tlv_protocol.h"
+#include "timer_wheel.h"
+
+// 连接状态
+enum class ConnState {
+    Connected,  // 已注册到reactor
+    Closed      // 已关闭，只等最后一个引用释放
+};
+
+// 连接统计信息快照
+struct ConnectionStats {
+    int reactor;                  // 所属reactor编号
+    uint64_t bytes_received;      // 接收字节数
+    uint64_t bytes_sent;          // 发送字节数
+    uint64_t messages_received;   // 接收的TLV消息数
+    uint64_t read_calls;          // 读取的系统调用次数（io_uring后端为recv完成事件数）
+    uint64_t write_calls;         // 发送的系统调用次数（io_uring后端为sendmsg请求数）
+    size_t read_size;             // 当前每次读取预留的字节数
+    size_t recv_buffer_capacity;  // 接收缓冲区容量
+};
+
+// 等待处理线程池处理的消息
+struct HandlerMessage {
+    TLVMessage message;
+    int64_t enqueue_us;   // 从接收缓冲区取出的时间（微秒）
+    uint64_t seq;         // 连接内的消息序号（用于追踪）
+};
+
+// 等待批量消息回调交付的消息，数据仍保留在接收缓冲区中
+struct BatchedMessage {
+    size_t offset;        // 消息内容相对于接收缓冲区读游标的偏移
+    uint16_t type;        // 消息类型
+    uint32_t length;      // 消息长度
+    bool inflated;        // 内容是否为解压后的数据（offset相对batch_inflated）
+};
+
+// 单个连接的全部状态：接收缓冲区、发送队列、状态和统计集中存放，
+// 事件分发时按fd直接索引，不再在多张映射表之间查找
+struct Connection : public std::enable_shared_from_this<Connection> {
+    int fd;                        // 套接字
+    int reactor_index;             // 所属reactor编号
+    struct sockaddr_in addr;       // 对端地址（io_uring后端接受的连接为空，见HandleAccepted）
+    std::atomic<ConnState> state;  // 连接状态
+    
+    RecvBuffer recv_buffer;        // 接收缓冲区（仅所属事件循环线程访问）
+    MessageQueue send_queue;       // 发送队列（任意线程投递）
+    bool write_armed;              // 是否已注册EPOLLOUT，io_uring后端下表示有发送请求在途（仅所属事件循环线程访问）
+    TimerId idle_timer;            // 空闲超时定时器（仅所属事件循环线程访问）
+    bool read_paused;              // 发送队列超过高水位后暂停读取（仅所属事件循环线程访问）
+    std::atomic<bool> over_high_water;    // 发送队列超过高水位，尚未回落到低水位
+    std::atomic<bool> compress_output;    // 对端已通过握手启用压缩，SendFrame按阈值压缩
+    std::atomic<TLVFormat> frame_format;  // 协商后的帧格式，接收和服务器生成的消息都按此格式
+    std::atomic<int64_t> last_active_ms;  // 最近一次收到数据的时间
+    
+    // 自适应读取大小（仅所属事件循环线程访问）
+    std::atomic<size_t> read_size; // 每次读取在接收缓冲区中预留的字节数（其他线程只读统计）
+    int small_reads;               // 连续读到远小于read_size的次数
+    
+    // io_uring后端的请求状态（仅所属事件循环线程访问）
+    uint32_t tag;                  // 连接标记，用于识别fd被复用后旧连接的完成事件
+    bool recv_active;              // 是否有多次触发的recv请求
+    bool recv_cancelling;          // recv请求已取消，等待最后一个完成事件
+    bool flush_pending;            // 已加入本轮结束时批量提交发送的列表
+    bool file_poll_armed;          // 已注册可写通知，等待继续sendfile
+    
+    std::atomic<uint64_t> bytes_received;
+    std::atomic<uint64_t> bytes_sent;
+    std::atomic<uint64_t> messages_received;
+    std::atomic<uint64_t> read_calls;
+    std::atomic<uint64_t> write_calls;
+    std::atomic<size_t> recv_buffer_capacity;  // 接收缓冲区容量（供其他线程读取统计）
+    std::atomic<int64_t> queued_since_ns;      // 发送队列由空变为非空的时间（0表示没有待写出的数据）
+    
+    // 批量消息回调（仅所属事件循环线程访问）：已解析、尚未交付的消息，
+    // 数据保留在接收缓冲区开头的batch_held字节中，交付后才移除
+    std::vector<BatchedMessage> batch;
+    std::vector<char> batch_inflated;  // 待交付的压缩消息解压后的内容
+    size_t batch_held;
+    TimerId batch_timer;           // 延迟交付定时器
+    
+    uint32_t trace_id;                         // 追踪ID，同一进程内唯一
+    std::atomic<uint64_t> trace_enqueued;      // 交给发送接口的累计字节数（仅追踪时更新）
+    
+    // 交给处理线程池的消息：同一连接同时最多只有一个任务在处理，保证消息顺序
+    std::mutex handler_mutex;
+    std::deque<HandlerMessage> handler_queue;
+    bool handler_scheduled;        // 是否已有任务在处理本连接的消息
+    
+    Connection(int fd, int reactor_index, const struct sockaddr_in& addr);
+    
+    // 是否已关闭
+    bool IsClosed() const;
+    
+    // 获取统计信息快照
+    ConnectionStats GetStats() const;
+};
+
+// 按fd索引的连接表
+//
+// 槽位数组在初始化时按进程可打开的文件数一次分配好，之后不再扩容，
+// 查找是一次数组下标访问。槽位保存shared_ptr：所属事件循环线程负责插入和移除，
+// 其他线程通过Get()原子地取得引用，连接关闭后仍持有引用的线程可以安全访问。
+class ConnectionTable {
+public:
+    ConnectionTable();
+    ~ConnectionTable();
+    
+    // 分配capacity个槽位（只能在没有并发访问时调用）
+    void Init(size_t capacity);
+    
+    // 槽位数量
+    size_t Capacity() const;
+    
+    // 取得fd对应连接的引用，任意线程可调用
+    std::shared_ptr<Connection> Get(int fd) const;
+    
+    // 取得fd对应连接的裸指针，只能由连接所属的事件循环线程调用
+    Connection* GetLocal(int fd) const;
+    
+    // 插入连接，fd超出容量时返回false
+    bool Insert(const std::shared_ptr<Connection>& conn);
+    
+    // 移除fd对应的连接
+    void Remove(int fd);
+    
+    // 取出并清空所有连接（只能在没有并发访问时调用）
+    std::vector<std::shared_ptr<Connection>> TakeAll();
+
+private:
+    std::vector<std::shared_ptr<Connection>> m_slots;
+};
+
+#endif // CONNECTION_H
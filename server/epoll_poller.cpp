@@ -0,0 +1,110 @@
+#include "epoll_poller.h"
+#include "uring_poller.h"
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+
+// 单次epoll_wait最多返回的事件数
+static const int EPOLL_WAIT_EVENTS = 1024;
+
+std::unique_ptr<Poller> CreatePoller(PollerType type) {
+    std::unique_ptr<Poller> poller;
+    
+    switch (type) {
+    case PollerType::Epoll:
+        poller.reset(new EpollPoller());
+        break;
+    case PollerType::IoUring:
+        poller.reset(new UringPoller());
+        break;
+    }
+    
+    if (!poller || !poller->Init()) {
+        return std::unique_ptr<Poller>();
+    }
+    
+    return poller;
+}
+
+EpollPoller::EpollPoller() : m_epoll_fd(-1), m_events(EPOLL_WAIT_EVENTS) {
+}
+
+EpollPoller::~EpollPoller() {
+    if (m_epoll_fd != -1) {
+        close(m_epoll_fd);
+    }
+}
+
+bool EpollPoller::Init() {
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd == -1) {
+        std::cerr << "Failed to create epoll: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+const char* EpollPoller::Name() const {
+    return "epoll";
+}
+
+bool EpollPoller::Add(int fd, uint32_t events) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = fd;
+    
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        std::cerr << "Failed to add to epoll: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+//这段代码是用于修改 epoll 监听的事件类型，即动态调整某个文件描述符（fd）在 epoll 中关注的事件
+bool EpollPoller::Modify(int fd, uint32_t events) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.fd = fd;
+    
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        std::cerr << "Failed to modify epoll: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+bool EpollPoller::Remove(int fd) {
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr) == -1) {
+        std::cerr << "Failed to remove from epoll: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+int EpollPoller::Wait(PollEvent* events, int max_events, int timeout_ms) {
+    if (max_events > static_cast<int>(m_events.size())) {
+        max_events = static_cast<int>(m_events.size());
+    }
+    
+    int nfds = epoll_wait(m_epoll_fd, m_events.data(), max_events, timeout_ms);
+    if (nfds <= 0) {
+        return nfds;
+    }
+    
+    for (int i = 0; i < nfds; i++) {
+        PollEvent& event = events[i];
+        event.type = PollEventType::Ready;
+        event.fd = m_events[i].data.fd;
+        event.events = m_events[i].events;
+        event.tag = 0;
+        event.result = 0;
+        event.data = nullptr;
+        event.more = true;
+    }
+    
+    return nfds;
+}
@@ -0,0 +1,26 @@
+#ifndef EPOLL_POLLER_H
+#define EPOLL_POLLER_H
+
+#include <sys/epoll.h>
+#include <vector>
+#include "poller.h"
+
+// 基于epoll的就绪通知后端
+class EpollPoller : public Poller {
+public:
+    EpollPoller();
+    ~EpollPoller();
+    
+    bool Init();
+    const char* Name() const;
+    bool Add(int fd, uint32_t events);
+    bool Modify(int fd, uint32_t events);
+    bool Remove(int fd);
+    int Wait(PollEvent* events, int max_events, int timeout_ms);
+
+private:
+    int m_epoll_fd;
+    std::vector<struct epoll_event> m_events;  // epoll_wait的输出缓冲区
+};
+
+#endif // EPOLL_POLLER_H
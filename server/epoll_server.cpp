@@ -1,25 +1,81 @@
 #include "epoll_server.h"
+#include <sys/resource.h>
 #include <iostream>
+#include <chrono>
+#include <limits>
+
+// 连接表槽位数上限（RLIMIT_NOFILE不受限时使用）
+static const size_t MAX_CONNECTION_SLOTS = 1 << 20;
+
+// 服务器定时器ID在TimerWheel留给调用方的最高8位保存reactor编号+1
+static const int TIMER_REACTOR_SHIFT = TIMER_ID_BITS;
+static const int MAX_REACTORS = (1 << (64 - TIMER_ID_BITS)) - 1;
+
+// 获取单调时钟的毫秒数
+static int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 获取单调时钟的微秒数
+static int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 获取单调时钟的纳秒数
+static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 /**
  * @brief EpollServer类的构造函数
  * @param ip 服务器要绑定的IP地址
  * @param port 服务器要监听的端口号
  * @param max_conn 服务器支持的最大连接数
+ * @param poller IO多路复用后端
+ *
+ * - PollerType::Epoll: epoll边缘触发，由服务器自己调用read/sendmsg。
+ * - PollerType::IoUring: 连接使用多次触发的accept/recv，数据由内核写入注册的
+ *   提供缓冲区后在完成事件中交付；发送请求在每轮事件处理结束时批量提交，
+ *   一次io_uring_enter同时完成提交和等待，大量连接时系统调用次数明显减少。
+ *   内核不支持io_uring（或被禁用）时自动回退到epoll，可用GetPollerName()确认。
+ *
+ * 两种后端调用相同的回调。
  * 
  * 初始化成员变量:
  * - m_ip: 存储服务器IP地址
  * - m_port: 存储服务器端口号
  * - m_max_connections: 存储最大连接数限制
- * - m_listen_fd: 监听socket文件描述符，初始化为-1表示未创建
- * - m_epoll_fd: epoll实例文件描述符，初始化为-1表示未创建
+ * - m_reactor_count: reactor数量，默认为1（与单线程事件循环行为一致）
+ * - m_accept_mode: 新连接接收方式，默认每个reactor各自监听(SO_REUSEPORT)
+ * - m_balance_policy: acceptor模式下的连接分配策略，默认轮询
+ * - m_poller_type: IO多路复用后端
  * - m_running: 服务器运行状态标志，初始化为false表示未运行
+ * - m_handler_threads: 消息处理线程数，默认为0（在IO线程中调用消息回调）
+ * - m_idle_timeout_ms: 连接空闲超时，默认为0（不限制）
+ * - m_high_water_mark/m_low_water_mark: 发送队列水位，默认为0（不限制）
+ * - m_batch_max_messages/m_batch_max_delay_ms: 批量消息回调默认每批最多MESSAGE_BATCH_SIZE条，读完即交付
+ * - m_stats_type: 统计端点，默认不启用
+ * - m_compress_threshold/m_handshake_type: 压缩，默认不启用
+ * - m_format_type: 帧格式协商，默认不启用
+ * - m_tracer: 消息生命周期追踪，默认不启用
  */
-EpollServer::EpollServer(const char* ip, int port, int max_conn)
+EpollServer::EpollServer(const char* ip, int port, int max_conn, PollerType poller)
     : m_ip(ip), m_port(port), m_max_connections(max_conn),
-      m_listen_fd(-1), m_epoll_fd(-1), m_running(false) {
-
-
+      m_reactor_count(1), m_accept_mode(AcceptMode::ReusePort),
+      m_balance_policy(BalancePolicy::RoundRobin), m_poller_type(poller),
+      m_running(false), m_acceptor_listen_fd(-1), m_next_reactor(0),
+      m_total_accepted(0), m_accept_rate(0),
+      m_rate_window_start(0), m_rate_window_base(0),
+      m_handler_threads(0), m_handler_pending(0), m_handler_handled(0),
+      m_handler_wait_us(0), m_handler_run_us(0), m_handler_max_us(0),
+      m_idle_timeout_ms(0), m_high_water_mark(0), m_low_water_mark(0),
+      m_next_timer_reactor(0), m_batch_max_messages(MESSAGE_BATCH_SIZE), m_batch_max_delay_ms(0),
+      m_stats_type(-1), m_compress_threshold(0), m_handshake_type(-1), m_format_type(-1), m_next_trace_id(1), m_next_tag(0) {
+    
+    
 }
 
 
@@ -34,7 +90,7 @@ EpollServer::~EpollServer() {
  * 该函数负责启动服务器，主要完成以下工作:
  * 1. 检查服务器是否已经在运行
  * 2. 初始化服务器(创建socket、绑定地址、创建epoll实例等)
- * 3. 启动工作线程
+ * 3. 为每个reactor启动一个事件循环线程
  */
 bool EpollServer::Start() {
     // 如果服务器已经在运行，直接返回true
@@ -55,16 +111,26 @@ bool EpollServer::Start() {
     // 设置服务器运行标志
     m_running = true;
     
-    // 创建并启动epoll事件循环线程
-    // 该线程负责处理所有的IO事件(新连接、数据读写等)
-    m_epoll_thread = std::thread(&EpollServer::EpollLoop, this);
+    // 启用消息处理线程池时，消息回调在线程池中执行，不阻塞IO线程
+    if (m_handler_threads > 0) {
+        m_handler_pool.Start(m_handler_threads);
+    }
+    
+    // 为每个reactor创建并启动epoll事件循环线程
+    // 每个线程负责处理自己监听套接字上的新连接以及所属连接的IO事件
+    for (auto& reactor : m_reactors) {
+        reactor->thread = std::thread(&EpollServer::EpollLoop, this, reactor.get());
+    }
     
-    // 创建并启动发送线程
-    // 该线程负责处理消息发送队列，确保数据能够及时发送出去
-    m_send_thread = std::thread(&EpollServer::SendThread, this);
+    // acceptor模式下启动独立的acceptor线程，只负责接受新连接
+    if (m_accept_mode == AcceptMode::Acceptor) {
+        m_acceptor_thread = std::thread(&EpollServer::AcceptorLoop, this);
+    }
     
     // 输出服务器启动成功的信息，显示监听的IP和端口
-    std::cout << "Server started on " << m_ip << ":" << m_port << std::endl;
+    std::cout << "Server started on " << m_ip << ":" << m_port
+              << " with " << m_reactors.size() << " reactor(s), poller: "
+              << GetPollerName() << std::endl;
     return true;
 }
 
@@ -76,49 +142,287 @@ void EpollServer::Stop() {
     m_running = false;
     
     // 等待线程结束
-    if (m_epoll_thread.joinable()) {
-        m_epoll_thread.join();
+    if (m_acceptor_thread.joinable()) {
+        m_acceptor_thread.join();
     }
     
-    if (m_send_thread.joinable()) {
-        m_send_thread.join();
+    for (auto& reactor : m_reactors) {
+        if (reactor->thread.joinable()) {
+            reactor->thread.join();
+        }
     }
     
-    // 关闭epoll
-    if (m_epoll_fd != -1) {
-        close(m_epoll_fd);
-        m_epoll_fd = -1;
+    // IO线程退出后不再有新消息，处理完已派发的消息再释放reactor
+    m_handler_pool.Stop();
+    
+    // 关闭IO多路复用实例和监听套接字
+    DestroyReactors();
+    
+    std::cout << "Server stopped" << std::endl;
+}
+
+/**
+ * @brief 设置reactor（事件循环线程）数量。
+ *
+ * 每个reactor拥有独立的epoll实例、使用SO_REUSEPORT绑定的监听套接字以及
+ * 自己的连接状态，由内核在各监听套接字之间分发新连接。
+ * 必须在Start()之前调用，服务器运行期间的修改会被忽略。
+ *
+ * @param count reactor数量，小于等于0时使用CPU核数，最多MAX_REACTORS个。
+ */
+void EpollServer::SetReactorCount(int count) {
+    if (m_running) {
+        return;
     }
     
-    // 关闭监听套接字
-    if (m_listen_fd != -1) {
-        close(m_listen_fd);
-        m_listen_fd = -1;
+    if (count <= 0) {
+        count = static_cast<int>(std::thread::hardware_concurrency());
     }
     
-    std::cout << "Server stopped" << std::endl;
+    if (count > MAX_REACTORS) {
+        count = MAX_REACTORS;
+    }
+    
+    m_reactor_count = count > 0 ? count : 1;
+}
+
+int EpollServer::GetReactorCount() const {
+    return m_reactor_count;
+}
+
+/**
+ * @brief 设置新连接的接收方式。
+ *
+ * - AcceptMode::ReusePort: 每个reactor各自持有一个SO_REUSEPORT监听套接字。
+ * - AcceptMode::Acceptor: 由一个独立线程使用accept4批量接受连接，再通过
+ *   eventfd通知的方式交给各reactor，避免连接风暴阻塞已有连接的读写。
+ *
+ * 必须在Start()之前调用。
+ */
+void EpollServer::SetAcceptMode(AcceptMode mode) {
+    if (m_running) {
+        return;
+    }
+    
+    m_accept_mode = mode;
+}
+
+const char* EpollServer::GetPollerName() const {
+    return m_poller_type == PollerType::IoUring ? "io_uring" : "epoll";
+}
+
+/**
+ * @brief 设置acceptor模式下的连接分配策略。
+ *
+ * acceptor线程不加同步地读取策略，因此与SetAcceptMode一样必须在Start()之前调用，
+ * 运行期间的调用被忽略。
+ */
+void EpollServer::SetBalancePolicy(BalancePolicy policy) {
+    if (m_running) {
+        return;
+    }
+    
+    m_balance_policy = policy;
+}
+
+uint64_t EpollServer::GetAcceptedPerSecond() const {
+    return m_accept_rate.load(std::memory_order_relaxed);
+}
+
+uint64_t EpollServer::GetTotalAccepted() const {
+    return m_total_accepted.load(std::memory_order_relaxed);
 }
 
 bool EpollServer::Init() {
+    // 连接表按进程可打开的文件数分配槽位，任何合法的fd都能直接索引
+    struct rlimit limit;
+    size_t slots = MAX_CONNECTION_SLOTS;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY &&
+        limit.rlim_cur < MAX_CONNECTION_SLOTS) {
+        slots = static_cast<size_t>(limit.rlim_cur);
+    }
+    m_connections.Init(slots);
+    
+    m_total_accepted = 0;
+    m_accept_rate = 0;
+    m_rate_window_start = NowMs();
+    m_rate_window_base = 0;
+    m_next_reactor = 0;
+    
+    for (int i = 0; i < m_reactor_count; i++) {
+        std::unique_ptr<Reactor> reactor(new Reactor());
+        reactor->index = i;
+        // 未启用压缩时v1长度字段的最高位是保留位，置位的头部按格式错误关闭连接
+        reactor->protocol.SetCompression(m_compress_threshold.load(std::memory_order_relaxed) != 0);
+        m_reactors.push_back(std::move(reactor));
+        
+        // 失败时已创建的资源由DestroyReactors()统一释放
+        if (!InitReactor(m_reactors.back().get())) {
+            DestroyReactors();
+            return false;
+        }
+    }
+    
+    if (m_accept_mode == AcceptMode::Acceptor && !InitAcceptor()) {
+        DestroyReactors();
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+ * @brief 初始化单个reactor。
+ *
+ * 创建IO多路复用实例和用于跨线程唤醒的eventfd；在SO_REUSEPORT模式下还会创建
+ * reactor自己的监听套接字。失败时已创建的资源由DestroyReactors()统一释放。
+ */
+bool EpollServer::InitReactor(Reactor* reactor) {
+    // 创建IO多路复用实例，io_uring不可用时回退到epoll
+    reactor->poller = CreatePoller(m_poller_type);
+    if (!reactor->poller && m_poller_type == PollerType::IoUring) {
+        std::cerr << "io_uring unavailable, falling back to epoll" << std::endl;
+        m_poller_type = PollerType::Epoll;
+        reactor->poller = CreatePoller(m_poller_type);
+    }
+    
+    if (!reactor->poller) {
+        return false;
+    }
+    reactor->async_io = reactor->poller->SupportsAsyncIo();
+    
+    // 创建唤醒用的eventfd
+    reactor->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (reactor->wakeup_fd == -1) {
+        std::cerr << "Failed to create eventfd: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    if (!AddToPoller(reactor, reactor->wakeup_fd, EPOLLIN)) {
+        return false;
+    }
+    
+    // 创建定时器的timerfd（由TimerWheel负责关闭）
+    if (!reactor->timers.Init(TIMER_TICK_MS) ||
+        !AddToPoller(reactor, reactor->timers.GetFd(), EPOLLIN)) {
+        return false;
+    }
+    
+    // acceptor模式下由acceptor线程统一监听
+    if (m_accept_mode == AcceptMode::Acceptor) {
+        return true;
+    }
+    
     // 创建监听套接字
-    m_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (m_listen_fd == -1) {
-        std::cerr << "Failed to create socket: " << strerror(errno) << std::endl;
+    reactor->listen_fd = CreateListenSocket();
+    if (reactor->listen_fd == -1) {
+        return false;
+    }
+    
+    // io_uring后端由一个多次触发的accept请求持续接受新连接
+    if (reactor->async_io) {
+        return reactor->poller->StartAccept(reactor->listen_fd);
+    }
+    
+    // 添加监听套接字到epoll
+    return AddToPoller(reactor, reactor->listen_fd, EPOLLIN);
+}
+
+bool EpollServer::InitAcceptor() {
+    m_acceptor_listen_fd = CreateListenSocket();
+    if (m_acceptor_listen_fd == -1) {
+        return false;
+    }
+    
+    // acceptor只需要监听套接字的就绪通知，批量accept4由AcceptBatch完成
+    m_acceptor_poller = CreatePoller(m_poller_type);
+    if (!m_acceptor_poller || !m_acceptor_poller->Add(m_acceptor_listen_fd, EPOLLIN)) {
+        m_acceptor_poller.reset();
+        close(m_acceptor_listen_fd);
+        m_acceptor_listen_fd = -1;
         return false;
     }
     
+    return true;
+}
+
+void EpollServer::DestroyReactors() {
+    // 关闭acceptor
+    m_acceptor_poller.reset();
+    
+    if (m_acceptor_listen_fd != -1) {
+        close(m_acceptor_listen_fd);
+        m_acceptor_listen_fd = -1;
+    }
+    
+    for (auto& reactor : m_reactors) {
+        // 关闭IO多路复用实例（io_uring会取消所有未完成的请求）
+        reactor->poller.reset();
+        reactor->flush_conns.clear();
+        
+        // 关闭监听套接字
+        if (reactor->listen_fd != -1) {
+            close(reactor->listen_fd);
+            reactor->listen_fd = -1;
+        }
+        
+        // 关闭唤醒fd
+        if (reactor->wakeup_fd != -1) {
+            close(reactor->wakeup_fd);
+            reactor->wakeup_fd = -1;
+        }
+        
+        // 关闭尚未注册到reactor的新连接
+        for (const auto& pending : reactor->pending_conns) {
+            close(pending.fd);
+        }
+        reactor->pending_conns.clear();
+    }
+    
+    m_reactors.clear();
+    
+    // 关闭服务器停止时仍然存在的连接
+    std::vector<std::shared_ptr<Connection>> conns = m_connections.TakeAll();
+    for (const auto& conn : conns) {
+        conn->state.store(ConnState::Closed, std::memory_order_release);
+        close(conn->fd);
+    }
+}
+
+/**
+ * @brief 创建一个绑定到服务器地址的非阻塞监听套接字。
+ *
+ * 套接字同时设置SO_REUSEADDR和SO_REUSEPORT，使多个reactor可以各自
+ * 绑定同一个地址和端口，由内核负责在它们之间做连接的负载均衡。
+ *
+ * @return 成功返回监听套接字，失败返回-1。
+ */
+int EpollServer::CreateListenSocket() {
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        std::cerr << "Failed to create socket: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    
     // 设置地址重用
     int opt = 1;
-    if (setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
         std::cerr << "Failed to set SO_REUSEADDR: " << strerror(errno) << std::endl;
-        close(m_listen_fd);
-        return false;
+        close(listen_fd);
+        return -1;
+    }
+    
+    // 设置端口重用，允许多个reactor监听同一端口
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
+        std::cerr << "Failed to set SO_REUSEPORT: " << strerror(errno) << std::endl;
+        close(listen_fd);
+        return -1;
     }
     
     // 设置非阻塞
-    if (!SetNonBlocking(m_listen_fd)) {
-        close(m_listen_fd);
-        return false;
+    if (!SetNonBlocking(listen_fd)) {
+        close(listen_fd);
+        return -1;
     }
     
     // 绑定地址
@@ -128,35 +432,20 @@ bool EpollServer::Init() {
     server_addr.sin_port = htons(m_port);
     server_addr.sin_addr.s_addr = inet_addr(m_ip.c_str());
     
-    if (bind(m_listen_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
+    if (bind(listen_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
         std::cerr << "Failed to bind: " << strerror(errno) << std::endl;
-        close(m_listen_fd);
-        return false;
+        close(listen_fd);
+        return -1;
     }
     
     // 开始监听
-    if (listen(m_listen_fd, SOMAXCONN) == -1) {
+    if (listen(listen_fd, SOMAXCONN) == -1) {
         std::cerr << "Failed to listen: " << strerror(errno) << std::endl;
-        close(m_listen_fd);
-        return false;
+        close(listen_fd);
+        return -1;
     }
     
-    // 创建epoll实例
-    m_epoll_fd = epoll_create1(0);
-    if (m_epoll_fd == -1) {
-        std::cerr << "Failed to create epoll: " << strerror(errno) << std::endl;
-        close(m_listen_fd);
-        return false;
-    }
-    
-    // 添加监听套接字到epoll
-    if (!AddToEpoll(m_listen_fd, EPOLLIN)) {
-        close(m_epoll_fd);
-        close(m_listen_fd);
-        return false;
-    }
-    
-    return true;
+    return listen_fd;
 }
 
 /**
@@ -184,302 +473,1568 @@ bool EpollServer::SetNonBlocking(int fd) {
 }
 
 /**
- * @brief 将指定的文件描述符添加到 epoll 实例进行事件监听。
+ * @brief 将指定的文件描述符添加到 reactor 的 IO 多路复用实例进行事件监听。
  *
  * 此函数用于将给定的文件描述符 fd 及其关注的事件类型 events（如 EPOLLIN、EPOLLOUT 等）
- * 添加到 epoll 实例（m_epoll_fd）中。当 epoll_ctl 调用失败时，会在标准错误输出打印错误信息，
- * 并返回 false；成功时返回 true。
+ * 注册到所属 reactor 的后端中，失败时由后端在标准错误输出打印错误信息。
  *
- * @param fd      需要添加到 epoll 的文件描述符。
+ * @param reactor 目标 reactor。
+ * @param fd      需要监听的文件描述符。
  * @param events  需要监听的事件类型（可以是 EPOLLIN、EPOLLOUT 等的组合）。
  * @return true   添加成功。
- * @return false  添加失败，并输出错误信息。
+ * @return false  添加失败。
  */
-bool EpollServer::AddToEpoll(int fd, uint32_t events) {
-    struct epoll_event ev;
-    ev.events = events;
-    ev.data.fd = fd;
-    
-    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
-        std::cerr << "Failed to add to epoll: " << strerror(errno) << std::endl;
-        return false;
-    }
-    
-    return true;
+bool EpollServer::AddToPoller(Reactor* reactor, int fd, uint32_t events) {
+    return reactor->poller->Add(fd, events);
 }
-//这段代码是用于修改 epoll 监听的事件类型，即动态调整某个文件描述符（fd）在 epoll 中关注的事件
-bool EpollServer::ModifyEpoll(int fd, uint32_t events) {
-    struct epoll_event ev;
-    ev.events = events;
-    ev.data.fd = fd;
-    
-    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
-        std::cerr << "Failed to modify epoll: " << strerror(errno) << std::endl;
-        return false;
-    }
-    
-    return true;
+//这段代码是用于修改监听的事件类型，即动态调整某个文件描述符（fd）关注的事件
+bool EpollServer::ModifyPoller(Reactor* reactor, int fd, uint32_t events) {
+    return reactor->poller->Modify(fd, events);
 }
 
-bool EpollServer::RemoveFromEpoll(int fd) {
-    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr) == -1) {
-        std::cerr << "Failed to remove from epoll: " << strerror(errno) << std::endl;
-        return false;
-    }
-    
-    return true;
+bool EpollServer::RemoveFromPoller(Reactor* reactor, int fd) {
+    return reactor->poller->Remove(fd);
 }
 
-void EpollServer::AcceptConnection() {
+/**
+ * @brief SO_REUSEPORT模式下在reactor自己的监听套接字上接受新连接。
+ *
+ * 使用accept4直接获得非阻塞、带CLOEXEC的套接字，省去两次fcntl调用。
+ */
+void EpollServer::AcceptConnection(Reactor* reactor) {
     struct sockaddr_in client_addr;//这是什么？ 
     //  struct sockaddr_in 是一个用于存储 IPv4 地址信息的结构体，通常用于网络编程中表示套接字地址。
-    socklen_t client_len = sizeof(client_addr);
     
     while (m_running) {
-        int client_fd = accept(m_listen_fd, (struct sockaddr*)&client_addr, &client_len);
+        socklen_t client_len = sizeof(client_addr);
+        int client_fd = accept4(reactor->listen_fd, (struct sockaddr*)&client_addr, &client_len,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (client_fd == -1) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 // 没有新连接了
                 break;
+            } else if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
             } else {
                 std::cerr << "Failed to accept: " << strerror(errno) << std::endl;
                 break;
             }
         }
         
-        // 设置非阻塞
-        if (!SetNonBlocking(client_fd)) {
-            close(client_fd);
-            continue;
-        }
-        
-        // 添加到epoll
-        if (!AddToEpoll(client_fd, EPOLLIN | EPOLLET)) {
-            close(client_fd);
-            continue;
-        }
-        
-        // 初始化接收缓冲区
-        {
-            std::lock_guard<std::mutex> lock(m_recv_mutex);
-            m_recv_buffers[client_fd] = std::vector<char>();
-        }
-        
-        // 调用连接回调
-        if (m_on_connect) {
-            m_on_connect(client_fd);/*就会触发 OnConnect 回调，
-            也就是执行你在 main.cpp 
-            里定义的 OnConnect 函数，实现连接事件通知。*/
-        }
-        
-        std::cout << "New connection from " << inet_ntoa(client_addr.sin_addr) 
-                  << ":" << ntohs(client_addr.sin_port) 
-                  << " fd: " << client_fd << std::endl;
+        m_total_accepted.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.Add(MetricCounter::Accepts);
+        reactor->conn_count.fetch_add(1, std::memory_order_relaxed);
+        RegisterConnection(reactor, client_fd, client_addr);
     }
 }
 
-void EpollServer::HandleRead(int fd) {
-    char buffer[BUFFER_SIZE];
+/**
+ * @brief acceptor模式下批量接受新连接并分发给各reactor。
+ *
+ * 每批最多接受ACCEPT_BATCH个连接，按分配策略归入各reactor的待注册队列，
+ * 每个reactor每批只加一次锁、只写一次eventfd。重复直到没有新连接为止。
+ */
+void EpollServer::AcceptBatch() {
+    std::vector<std::vector<PendingConnection>> batches(m_reactors.size());
     
     while (m_running) {
-        ssize_t n = read(fd, buffer, BUFFER_SIZE);
-        if (n == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // 数据读完了
+        size_t accepted = 0;
+        
+        while (accepted < ACCEPT_BATCH) {
+            PendingConnection pending;
+            socklen_t client_len = sizeof(pending.addr);
+            pending.fd = accept4(m_acceptor_listen_fd, (struct sockaddr*)&pending.addr, &client_len,
+                                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (pending.fd == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    std::cerr << "Failed to accept: " << strerror(errno) << std::endl;
+                }
                 break;
-            } else {
-                std::cerr << "Failed to read from fd " << fd << ": " << strerror(errno) << std::endl;
-                CloseConnection(fd);
-                return;
             }
-        } else if (n == 0) {
-            // 对端关闭连接
-            std::cout << "Connection closed by peer, fd: " << fd << std::endl;
-            CloseConnection(fd);
-            return;
+            
+            Reactor* reactor = SelectReactor();
+            reactor->conn_count.fetch_add(1, std::memory_order_relaxed);
+            batches[reactor->index].push_back(pending);
+            accepted++;
         }
         
-        // 将数据添加到接收缓冲区
-        {
-            std::lock_guard<std::mutex> lock(m_recv_mutex);
-            auto& recv_buffer = m_recv_buffers[fd];
-            recv_buffer.insert(recv_buffer.end(), buffer, buffer + n);
+        m_total_accepted.fetch_add(accepted, std::memory_order_relaxed);
+        if (accepted > 0) {
+            m_metrics.Add(MetricCounter::Accepts, accepted);
+        }
+        
+        // 将本批连接交给各reactor
+        for (size_t i = 0; i < batches.size(); i++) {
+            if (batches[i].empty()) {
+                continue;
+            }
             
-            // 尝试解析TLV消息
-            while (true) {
-                TLVMessage msg;
-                size_t consumed = 0;
-                
-                if (m_protocol.ParseMessage(recv_buffer.data(), recv_buffer.size(), msg, consumed)) {
-                    // 解析成功，调用消息回调
-                    if (m_on_message) {
-                        m_on_message(fd, msg);
-                    }
-                    
-                    // 移除已处理的数据
-                    recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + consumed);
-                } else {
-                    // 数据不足，等待更多数据
-                    break;
-                }
+            Reactor* reactor = m_reactors[i].get();
+            {
+                std::lock_guard<std::mutex> lock(reactor->pending_mutex);
+                reactor->pending_conns.insert(reactor->pending_conns.end(),
+                                              batches[i].begin(), batches[i].end());
             }
+            WakeupReactor(reactor);
+            batches[i].clear();
+        }
+        
+        // 本批未满说明已经没有待接受的连接
+        if (accepted < ACCEPT_BATCH) {
+            break;
         }
     }
 }
 
-void EpollServer::HandleWrite(int fd) {
-    // 检查是否有数据要发送
-    if (m_send_queue.HasMessages(fd)) {
-        // 获取要发送的数据
-        std::vector<char> data;
-        if (m_send_queue.GetMessages(fd, data)) {
-            // 发送数据
-            ssize_t sent = 0;
-            size_t total_sent = 0;
-            
-            while (total_sent < data.size()) {
-                sent = write(fd, data.data() + total_sent, data.size() - total_sent);
-                if (sent == -1) {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                        // 发送缓冲区已满，将剩余数据放回队列
-                        std::vector<char> remaining(data.begin() + total_sent, data.end());
-                        m_send_queue.PushFront(fd, remaining.data(), remaining.size());
-                        
-                        // 确保监听写事件
-                        ModifyEpoll(fd, EPOLLIN | EPOLLOUT | EPOLLET);
-                        return;
-                    } else {
-                        std::cerr << "Failed to write to fd " << fd << ": " << strerror(errno) << std::endl;
-                        CloseConnection(fd);
-                        return;
-                    }
-                }
-                
-                total_sent += sent;
-            }
-            
-            // 如果队列中还有数据，继续监听写事件，否则只监听读事件
-            if (m_send_queue.HasMessages(fd)) {
-                ModifyEpoll(fd, EPOLLIN | EPOLLOUT | EPOLLET);
-            } else {
-                ModifyEpoll(fd, EPOLLIN | EPOLLET);
+EpollServer::Reactor* EpollServer::SelectReactor() {
+    if (m_balance_policy == BalancePolicy::LeastConnections) {
+        Reactor* best = m_reactors[0].get();
+        int best_count = std::numeric_limits<int>::max();
+        
+        for (auto& reactor : m_reactors) {
+            int count = reactor->conn_count.load(std::memory_order_relaxed);
+            if (count < best_count) {
+                best = reactor.get();
+                best_count = count;
             }
         }
-    } else {
-        // 没有数据要发送，只监听读事件
-        ModifyEpoll(fd, EPOLLIN | EPOLLET);
+        
+        return best;
     }
+    
+    Reactor* reactor = m_reactors[m_next_reactor].get();
+    m_next_reactor = (m_next_reactor + 1) % m_reactors.size();
+    return reactor;
 }
 
-void EpollServer::CloseConnection(int fd) {
-    // 从epoll中移除
-    RemoveFromEpoll(fd);
-    
-    // 关闭套接字
-    close(fd);
+void EpollServer::WakeupReactor(Reactor* reactor) {
+    uint64_t one = 1;
+    if (write(reactor->wakeup_fd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        std::cerr << "Failed to wakeup reactor " << reactor->index << ": " << strerror(errno) << std::endl;
+    }
+}
+
+void EpollServer::HandleWakeup(Reactor* reactor) {
+    // 清空eventfd计数
+    uint64_t counter = 0;
+    while (read(reactor->wakeup_fd, &counter, sizeof(counter)) == -1 && errno == EINTR) {
+    }
     
-    // 清理接收缓冲区
+    // 取出acceptor交过来的新连接和其他线程投递的待发送连接
+    std::vector<PendingConnection> pending;
+    std::vector<std::shared_ptr<Connection>> writes;
     {
-        std::lock_guard<std::mutex> lock(m_recv_mutex);
-        m_recv_buffers.erase(fd);
+        std::lock_guard<std::mutex> lock(reactor->pending_mutex);
+        pending.swap(reactor->pending_conns);
+        writes.swap(reactor->pending_writes);
     }
     
-    // 清理发送队列
-    m_send_queue.Clear(fd);
-    
-    // 调用断开连接回调
-    if (m_on_disconnect) {
-        m_on_disconnect(fd);
+    for (const auto& conn : pending) {
+        RegisterConnection(reactor, conn.fd, conn.addr);
     }
-}
-
-void EpollServer::EpollLoop() {
-    struct epoll_event events[MAX_EVENTS];
     
-    while (m_running) {
-        int nfds = epoll_wait(m_epoll_fd, events, MAX_EVENTS, 100);
-        if (nfds == -1) {
-            if (errno == EINTR) {
-                // 被信号中断，继续
-                continue;
-            }
-            
-            std::cerr << "epoll_wait error: " << strerror(errno) << std::endl;
-            break;
+    for (const auto& conn : writes) {
+        if (conn->IsClosed()) {
+            continue;
         }
         
-        for (int i = 0; i < nfds; i++) {
-            int fd = events[i].data.fd;
-            
-            // 处理错误事件
-            //这里 events[i].events 是一个事件掩码，EPOLLERR | EPOLLHUP 是错误和挂起事件的掩码。
-            //& 运算会判断 events[i].events 是否包含这两个事件中的任意一个。
-            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
-                std::cerr << "epoll error on fd " << fd << std::endl;
-                CloseConnection(fd);
-                continue;
-            }
-            
-            // 处理监听套接字的读事件（新连接）
-            if (fd == m_listen_fd && (events[i].events & EPOLLIN)) {
-                AcceptConnection();
-                continue;
-            }
-            
-            // 处理客户端套接字的读事件
-            if (events[i].events & EPOLLIN) {
-                HandleRead(fd);
-            }
-            
-            // 处理客户端套接字的写事件
-            if (events[i].events & EPOLLOUT) {
-                HandleWrite(fd);
-            }
+        // 已注册EPOLLOUT的连接等待可写事件即可，只需按水位暂停读取
+        if (conn->write_armed) {
+            UpdateWatermark(reactor, conn.get());
+            continue;
         }
+        
+        HandleWrite(reactor, conn.get());
     }
 }
 
-void EpollServer::SendThread() {
+/**
+ * @brief 在reactor中注册一个已接受的非阻塞连接。
+ *
+ * 只能在reactor自己的事件循环线程中调用。连接计数由调用方在分配时增加，
+ * 注册失败时在这里回退。
+ */
+void EpollServer::RegisterConnection(Reactor* reactor, int client_fd, const struct sockaddr_in& client_addr) {
+    std::shared_ptr<Connection> conn = std::make_shared<Connection>(client_fd, reactor->index, client_addr);
+    conn->read_size.store(BUFFER_SIZE, std::memory_order_relaxed);
+    conn->trace_id = m_next_trace_id.fetch_add(1, std::memory_order_relaxed);
+    
+    // 标记在所有reactor间唯一，并且在连接放入连接表之前写好，其他线程取到连接时已是最终值
+    if (reactor->async_io) {
+        conn->tag = (m_next_tag.fetch_add(1, std::memory_order_relaxed) + 1) & 0xFFFFFFu;
+    }
+    
+    // 放入连接表，fd超出连接表容量时拒绝连接
+    if (!m_connections.Insert(conn)) {
+        std::cerr << "Connection table full, rejecting fd " << client_fd << std::endl;
+        reactor->conn_count.fetch_sub(1, std::memory_order_relaxed);
+        close(client_fd);
+        return;
+    }
+    
+    if (reactor->async_io) {
+        // io_uring后端：发起多次触发的recv，数据到达时直接在完成事件中交付
+        StartRecv(reactor, conn.get());
+    } else if (!AddToPoller(reactor, client_fd, EPOLLIN | EPOLLRDHUP | EPOLLET)) {
+        // 添加到epoll
+        m_connections.Remove(client_fd);
+        reactor->conn_count.fetch_sub(1, std::memory_order_relaxed);
+        close(client_fd);
+        return;
+    }
+    
+    m_metrics.Add(MetricCounter::ConnectionsOpened);
+    
+    // 开始空闲超时检查
+    int64_t idle_timeout = m_idle_timeout_ms.load(std::memory_order_relaxed);
+    if (idle_timeout > 0) {
+        conn->last_active_ms.store(NowMs(), std::memory_order_relaxed);
+        ScheduleIdleCheck(conn.get(), idle_timeout);
+    }
+    
+    // 调用连接回调
+    if (m_on_connect) {
+        m_on_connect(client_fd);/*就会触发 OnConnect 回调，
+        也就是执行你在 main.cpp 
+        里定义的 OnConnect 函数，实现连接事件通知。*/
+    }
+}
+
+/**
+ * @brief 更新每秒接受连接数的统计窗口。
+ *
+ * 只由一个线程调用：acceptor模式下为acceptor线程，否则为0号reactor。
+ */
+void EpollServer::UpdateAcceptRate() {
+    int64_t now = NowMs();
+    int64_t elapsed = now - m_rate_window_start;
+    if (elapsed < 1000) {
+        return;
+    }
+    
+    uint64_t total = m_total_accepted.load(std::memory_order_relaxed);
+    m_accept_rate.store((total - m_rate_window_base) * 1000 / elapsed, std::memory_order_relaxed);
+    m_rate_window_base = total;
+    m_rate_window_start = now;
+}
+
+/**
+ * @brief 处理连接的读事件。
+ *
+ * 数据用readv直接读入连接的接收缓冲区尾部，尾部按连接的读取预留大小（read_size）
+ * 保证可写空间，超出的部分落到栈上的备用区再追加，一次系统调用尽量读完内核中的数据。
+ * 读到的字节数少于本次的总容量说明内核缓冲区已经读空，不再为确认EAGAIN多调用一次read；
+ * 对端已关闭写方向时继续读到EOF。每读一次就解析出其中完整的TLV消息，
+ * 解析完成的字节只前移读游标，不做逐条搬移。消息以TLVView的形式交给零拷贝回调，
+ * 只有设置了TLVMessage回调时才复制消息内容。
+ */
+void EpollServer::HandleRead(Reactor* reactor, Connection* conn, bool peer_closed) {
+    char spare[READ_SPARE_SIZE];
+    int fd = conn->fd;
+    RecvBuffer& recv_buffer = conn->recv_buffer;
+    MetricsShard* metrics = m_metrics.Local();
+    
+    // 发送队列超过高水位时停止读取，剩余数据留在内核中，恢复读取时epoll会再次通知
+    while (m_running && !conn->read_paused) {
+        // 直接读入接收缓冲区，不足的部分由备用区承接
+        recv_buffer.EnsureWritable(conn->read_size.load(std::memory_order_relaxed));
+        size_t capacity = recv_buffer.WritableBytes() + sizeof(spare);
+        ssize_t n = recv_buffer.ReadvFromFd(fd, spare, sizeof(spare));
+        conn->read_calls.fetch_add(1, std::memory_order_relaxed);
+        metrics->Add(MetricCounter::ReadCalls, 1);
+        
+        if (n == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 数据读完了
+                break;
+            } else if (errno == EINTR) {
+                continue;
+            } else {
+                std::cerr << "Failed to read from fd " << fd << ": " << strerror(errno) << std::endl;
+                CloseConnection(reactor, conn);
+                return;
+            }
+        } else if (n == 0) {
+            // 对端关闭连接
+            CloseConnection(reactor, conn);
+            return;
+        }
+        
+        conn->bytes_received.fetch_add(n, std::memory_order_relaxed);
+        metrics->Add(MetricCounter::BytesReceived, static_cast<uint64_t>(n));
+        m_tracer.Record(TraceStage::Read, conn->trace_id, 0, static_cast<uint64_t>(n));
+        if (conn->idle_timer) {
+            conn->last_active_ms.store(NowMs(), std::memory_order_relaxed);
+        }
+        
+        AdjustReadSize(conn, static_cast<size_t>(n));
+        
+        // 尝试解析TLV消息，移除已处理的数据（开头等待批量交付的消息跳过不再解析）
+        size_t held = conn->batch_held;
+        size_t parsed = ParseMessages(reactor, conn, recv_buffer.Peek() + held, recv_buffer.ReadableBytes() - held);
+        recv_buffer.Retrieve(ReleaseParsed(conn, parsed));
+        
+        // 收到无法解压的消息时连接已在解析中关闭
+        if (conn->IsClosed()) {
+            return;
+        }
+        
+        // 读取量回落后释放突发时扩大的缓冲区
+        if (recv_buffer.ReadableBytes() == 0) {
+            recv_buffer.Shrink(conn->read_size.load(std::memory_order_relaxed) * 2);
+        }
+        conn->recv_buffer_capacity.store(recv_buffer.Capacity(), std::memory_order_relaxed);
+        
+        // 没有读满说明内核中的数据已经读完
+        if (static_cast<size_t>(n) < capacity && !peer_closed) {
+            break;
+        }
+    }
+    
+    FinishBatch(reactor, conn);
+}
+
+/**
+ * @brief 自适应调整每次读取的预留大小。
+ *
+ * 一次读到的数据达到预留大小时翻倍（最多MAX_READ_SIZE），大块上传很快就能一次读完；
+ * 连续READ_SHRINK_AFTER次读到不足四分之一时减半（最少BUFFER_SIZE），
+ * 只收发小消息的连接始终只占用很小的接收缓冲区。
+ */
+void EpollServer::AdjustReadSize(Connection* conn, size_t n) {
+    size_t read_size = conn->read_size.load(std::memory_order_relaxed);
+    
+    if (n >= read_size) {
+        conn->small_reads = 0;
+        if (read_size < MAX_READ_SIZE) {
+            read_size = read_size * 2 < MAX_READ_SIZE ? read_size * 2 : MAX_READ_SIZE;
+            conn->read_size.store(read_size, std::memory_order_relaxed);
+        }
+        return;
+    }
+    
+    if (n >= read_size / 4) {
+        conn->small_reads = 0;
+        return;
+    }
+    
+    if (++conn->small_reads >= READ_SHRINK_AFTER && read_size > BUFFER_SIZE) {
+        conn->small_reads = 0;
+        read_size = read_size / 2 > BUFFER_SIZE ? read_size / 2 : BUFFER_SIZE;
+        conn->read_size.store(read_size, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief 解析data中所有完整的TLV消息并调用消息回调。
+ *
+ * 返回已解析的字节数，调用方据此前移接收缓冲区的读游标，不做逐条搬移；
+ * 末尾不完整的消息留给调用方保存，等待更多数据。
+ * 启用了统计端点时，该类型的消息由服务器直接回复指标，不交给回调。
+ * 设置了批量消息回调时，消息在单条回调之后加入连接的待交付列表，凑满一批立即交付。
+ * 消息按连接协商的帧格式批量扫描；帧格式握手之后的数据按新格式重新扫描，
+ * 头部格式错误的连接被关闭。
+ */
+size_t EpollServer::ParseMessages(Reactor* reactor, Connection* conn, const char* data, size_t len) {
+    int fd = conn->fd;
+    size_t offset = 0;
+    MetricsShard* metrics = m_metrics.Local();
+    int stats_type = m_stats_type.load(std::memory_order_relaxed);
+    int handshake_type = m_handshake_type.load(std::memory_order_relaxed);
+    int format_type = m_format_type.load(std::memory_order_relaxed);
+    TLVProtocol* protocol = &reactor->Protocol(conn->frame_format.load(std::memory_order_relaxed));
+    int64_t parse_start_ns = NowNs();
+    
+    // 交给线程池的消息在处理线程中记录回调的开始和结束
+    bool routed = !m_dispatcher.IsEmpty();
+    bool dispatch = (m_on_message || routed) && m_handler_pool.IsRunning();
+    bool batching = static_cast<bool>(m_on_message_batch);
+    size_t batch_max = m_batch_max_messages.load(std::memory_order_relaxed);
+    
+    // 一次扫描出一批完整消息的边界，再逐条处理
+    while (true) {
+        size_t scanned = 0;
+        bool malformed = false;
+        size_t count = protocol->ScanFrames(data + offset, len - offset, reactor->scan_views, SCAN_BATCH,
+                                            scanned, malformed);
+        if (count == 0) {
+            if (malformed) {
+                std::cerr << "Malformed frame header from fd " << fd << ", closing" << std::endl;
+                CloseConnection(reactor, conn);
+            }
+            // 数据不足，等待更多数据
+            break;
+        }
+        
+        bool rescan = false;
+        for (size_t i = 0; i < count && !rescan; i++) {
+            TLVView view = reactor->scan_views[i];
+            uint64_t seq = conn->messages_received.fetch_add(1, std::memory_order_relaxed) + 1;
+            metrics->Add(MetricCounter::MessagesReceived, 1);
+            m_tracer.Record(TraceStage::Parsed, conn->trace_id, view.type, seq);
+            metrics->AddType(MetricTypeCounter::Received, view.type);
+            offset = static_cast<size_t>(view.value - data) + view.length;
+            
+            if (view.type == stats_type) {
+                ReplyStats(reactor, conn, view.type);
+                continue;
+            }
+            
+            if (view.type == handshake_type) {
+                ReplyHandshake(reactor, conn, view);
+                continue;
+            }
+            
+            // 格式改变后剩余的数据按新格式重新扫描
+            if (view.type == format_type) {
+                if (ReplyFormat(reactor, conn, view)) {
+                    protocol = &reactor->Protocol(conn->frame_format.load(std::memory_order_relaxed));
+                    rescan = true;
+                }
+                continue;
+            }
+            
+            // 压缩消息先解压，之后的回调看到的都是原始内容
+            bool inflated = view.compressed;
+            if (inflated && !InflateMessage(reactor, view)) {
+                std::cerr << "Invalid compressed message from fd " << fd << ", closing" << std::endl;
+                CloseConnection(reactor, conn);
+                return offset;
+            }
+            
+            // 交给线程池的消息在处理线程中记录等待时间
+            if (m_on_message_view || ((m_on_message || routed) && !dispatch)) {
+                metrics->Record(MetricHistogram::ParseToCallbackNs, static_cast<uint64_t>(NowNs() - parse_start_ns));
+            }
+            if (!dispatch) {
+                m_tracer.Record(TraceStage::CallbackStart, conn->trace_id, view.type, seq);
+            }
+            
+            // 解析成功，调用消息回调
+            if (m_on_message_view) {
+                m_on_message_view(fd, view);
+            }
+            
+            if (dispatch) {
+                DispatchMessage(conn, view, seq);
+            } else {
+                if (m_on_message) {
+                    m_on_message(fd, view.ToMessage());
+                }
+                if (routed) {
+                    RouteMessage(metrics, fd, view);
+                }
+            }
+            
+            if (!dispatch) {
+                m_tracer.Record(TraceStage::CallbackDone, conn->trace_id, view.type, seq);
+            }
+            
+            // 批量交付时data总在接收缓冲区中，记录相对读游标的偏移，缓冲区搬移后仍然有效；
+            // 解压后的内容在解压缓冲区中，下一条压缩消息会覆盖它，复制到连接自己的缓冲区
+            if (batching && !conn->IsClosed()) {
+                BatchedMessage batched;
+                batched.type = view.type;
+                batched.length = view.length;
+                batched.inflated = inflated;
+                if (inflated) {
+                    batched.offset = conn->batch_inflated.size();
+                    conn->batch_inflated.insert(conn->batch_inflated.end(), view.value, view.value + view.length);
+                } else {
+                    batched.offset = static_cast<size_t>(view.value - conn->recv_buffer.Peek());
+                }
+                conn->batch.push_back(batched);
+                
+                if (conn->batch.size() >= batch_max) {
+                    FlushBatch(reactor, conn);
+                } else if (conn->batch.size() == 1 && !conn->batch_timer) {
+                    int64_t delay_ms = m_batch_max_delay_ms.load(std::memory_order_relaxed);
+                    if (delay_ms > 0) {
+                        // 连接关闭时会在同一线程中取消定时器，回调中可以直接使用裸指针
+                        conn->batch_timer = reactor->timers.RunAfter(delay_ms, [this, reactor, conn]() {
+                            conn->batch_timer = 0;
+                            ExpireBatch(reactor, conn);
+                        });
+                    }
+                }
+            }
+        }
+        
+        // 本批没有装满时数据已经扫描完
+        if (count < SCAN_BATCH && !rescan && !malformed) {
+            break;
+        }
+    }
+    
+    return offset;
+}
+
+/**
+ * @brief 计算解析后可以从接收缓冲区移除的字节数。
+ *
+ * 还有待交付的批量消息时，已解析的数据全部保留在缓冲区开头（记入batch_held），
+ * 视图在交付时才按偏移重建；没有待交付的消息时连同之前保留的部分一起移除。
+ */
+size_t EpollServer::ReleaseParsed(Connection* conn, size_t parsed) {
+    size_t consumed = conn->batch_held + parsed;
+    if (!conn->batch.empty()) {
+        conn->batch_held = consumed;
+        return 0;
+    }
+    
+    conn->batch_held = 0;
+    return consumed;
+}
+
+/**
+ * @brief 一次读取结束时处理待交付的批量消息。
+ *
+ * 没有设置最长延迟时立即交付，同一次读完套接字得到的消息合并为一次回调；
+ * 设置了最长延迟时留给后续读取凑满一批，或由定时器到期交付。
+ */
+void EpollServer::FinishBatch(Reactor* reactor, Connection* conn) {
+    if (conn->batch.empty() || conn->IsClosed()) {
+        return;
+    }
+    
+    if (m_batch_max_delay_ms.load(std::memory_order_relaxed) <= 0 || !conn->batch_timer) {
+        ExpireBatch(reactor, conn);
+    }
+}
+
+/**
+ * @brief 交付连接待交付的批量消息。
+ *
+ * 视图按偏移从接收缓冲区读游标重建，只在回调期间有效。只清空待交付列表，
+ * 数据由调用方移除：解析过程中凑满一批时解析仍在进行，不能移动读游标。
+ */
+void EpollServer::FlushBatch(Reactor* reactor, Connection* conn) {
+    if (conn->batch_timer) {
+        reactor->timers.Cancel(conn->batch_timer);
+        conn->batch_timer = 0;
+    }
+    
+    if (conn->batch.empty()) {
+        return;
+    }
+    
+    std::vector<TLVView>& views = reactor->batch_views;
+    views.clear();
+    const char* base = conn->recv_buffer.Peek();
+    for (size_t i = 0; i < conn->batch.size(); i++) {
+        const BatchedMessage& batched = conn->batch[i];
+        const char* value = (batched.inflated ? conn->batch_inflated.data() : base) + batched.offset;
+        views.push_back(TLVView(batched.type, value, batched.length));
+    }
+    conn->batch.clear();
+    
+    m_metrics.Record(MetricHistogram::MessageBatchSize, views.size());
+    m_on_message_batch(conn->fd, views.data(), views.size());
+    conn->batch_inflated.clear();
+}
+
+void EpollServer::ExpireBatch(Reactor* reactor, Connection* conn) {
+    if (conn->IsClosed()) {
+        return;
+    }
+    
+    FlushBatch(reactor, conn);
+    conn->recv_buffer.Retrieve(ReleaseParsed(conn, 0));
+}
+
+/**
+ * @brief 处理io_uring后端多次触发accept的完成事件。
+ *
+ * 每个完成事件带一个已设置非阻塞和CLOEXEC的新连接。多次触发的accept共用一个请求，
+ * 不带对端地址，这里也不为每个连接再调用getpeername，Connection::addr保持为空，
+ * 需要对端地址的应用在连接回调中自行获取。请求被内核终止（more为false）时重新发起。
+ */
+void EpollServer::HandleAccepted(Reactor* reactor, const PollEvent& event) {
+    if (event.result >= 0) {
+        int client_fd = event.result;
+        struct sockaddr_in client_addr;
+        memset(&client_addr, 0, sizeof(client_addr));
+        
+        m_total_accepted.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.Add(MetricCounter::Accepts);
+        reactor->conn_count.fetch_add(1, std::memory_order_relaxed);
+        RegisterConnection(reactor, client_fd, client_addr);
+    } else if (event.result != -EAGAIN && event.result != -ECONNABORTED &&
+               event.result != -EINTR && event.result != -ECANCELED) {
+        std::cerr << "Failed to accept: " << strerror(-event.result) << std::endl;
+    }
+    
+    if (!event.more && m_running) {
+        reactor->poller->StartAccept(reactor->listen_fd);
+    }
+}
+
+/**
+ * @brief 处理io_uring后端recv的完成事件。
+ *
+ * 内核已经把数据写入提供缓冲区，这里只需追加到连接的接收缓冲区再解析，
+ * 不再为每次读取发起系统调用。提供缓冲区暂时用完（-ENOBUFS）或请求被取消时
+ * 请求结束，未暂停读取时重新发起。
+ */
+void EpollServer::HandleReceived(Reactor* reactor, const PollEvent& event) {
+    // 标记不一致或连接属于其他reactor说明是已关闭连接的事件，fd可能已被新连接复用
+    Connection* conn = m_connections.GetLocal(event.fd);
+    if (!conn || conn->reactor_index != reactor->index || conn->IsClosed() || conn->tag != event.tag) {
+        return;
+    }
+    
+    if (event.result > 0 && event.data) {
+        size_t len = static_cast<size_t>(event.result);
+        RecvBuffer& recv_buffer = conn->recv_buffer;
+        
+        conn->bytes_received.fetch_add(len, std::memory_order_relaxed);
+        conn->read_calls.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.Add(MetricCounter::BytesReceived, len);
+        m_metrics.Add(MetricCounter::ReadCalls);
+        m_tracer.Record(TraceStage::Read, conn->trace_id, 0, len);
+        if (conn->idle_timer) {
+            conn->last_active_ms.store(NowMs(), std::memory_order_relaxed);
+        }
+        
+        if (recv_buffer.ReadableBytes() == 0 && !m_on_message_batch) {
+            // 没有残留的半条消息时直接在提供缓冲区上解析，只保存末尾不完整的部分
+            // （批量交付的消息可能在提供缓冲区归还后才交付，需要先复制到接收缓冲区）
+            size_t parsed = ParseMessages(reactor, conn, event.data, len);
+            if (parsed < len) {
+                recv_buffer.Append(event.data + parsed, len - parsed);
+            }
+        } else {
+            recv_buffer.Append(event.data, len);
+            size_t held = conn->batch_held;
+            size_t parsed = ParseMessages(reactor, conn, recv_buffer.Peek() + held, recv_buffer.ReadableBytes() - held);
+            recv_buffer.Retrieve(ReleaseParsed(conn, parsed));
+            FinishBatch(reactor, conn);
+            
+            // 半条大消息拼完后释放扩大的缓冲区
+            if (recv_buffer.ReadableBytes() == 0) {
+                recv_buffer.Shrink(conn->read_size.load(std::memory_order_relaxed) * 2);
+            }
+        }
+        conn->recv_buffer_capacity.store(recv_buffer.Capacity(), std::memory_order_relaxed);
+        
+        if (conn->IsClosed()) {
+            return;
+        }
+    } else if (event.result == 0) {
+        // 对端关闭连接
+        CloseConnection(reactor, conn);
+        return;
+    } else if (event.result < 0 && event.result != -ENOBUFS && event.result != -ECANCELED) {
+        std::cerr << "Failed to read from fd " << conn->fd << ": " << strerror(-event.result) << std::endl;
+        CloseConnection(reactor, conn);
+        return;
+    }
+    
+    if (!event.more) {
+        conn->recv_active = false;
+        conn->recv_cancelling = false;
+        if (m_running && !conn->read_paused) {
+            StartRecv(reactor, conn);
+        }
+    }
+}
+
+/**
+ * @brief 处理io_uring后端sendmsg的完成事件。
+ *
+ * 每个连接同时最多只有一个发送请求在途，完成后按实际发送的字节数出队，
+ * 队列中还有数据（包括发送期间新投递的）时立即发起下一次发送。
+ */
+void EpollServer::HandleSent(Reactor* reactor, const PollEvent& event) {
+    Connection* conn = m_connections.GetLocal(event.fd);
+    if (!conn || conn->reactor_index != reactor->index || conn->IsClosed() || conn->tag != event.tag) {
+        return;
+    }
+    
+    conn->write_armed = false;
+    
+    if (event.result < 0) {
+        if (event.result == -EAGAIN || event.result == -EINTR) {
+            HandleWrite(reactor, conn);
+            return;
+        }
+        
+        std::cerr << "Failed to write to fd " << conn->fd << ": " << strerror(-event.result) << std::endl;
+        CloseConnection(reactor, conn);
+        return;
+    }
+    
+    conn->bytes_sent.fetch_add(event.result, std::memory_order_relaxed);
+    m_metrics.Add(MetricCounter::BytesSent, static_cast<uint64_t>(event.result));
+    m_tracer.Record(TraceStage::Written, conn->trace_id, 0, conn->bytes_sent.load(std::memory_order_relaxed));
+    conn->send_queue.Consume(static_cast<size_t>(event.result));
+    
+    HandleWrite(reactor, conn);
+}
+
+void EpollServer::StartRecv(Reactor* reactor, Connection* conn) {
+    if (reactor->poller->StartRecv(conn->fd, conn->tag)) {
+        conn->recv_active = true;
+    }
+}
+
+/**
+ * @brief 发送连接队列中的数据，只在事件循环线程中调用。
+ *
+ * 用sendmsg（等价于带MSG_NOSIGNAL的writev）直接从各消息自己的缓冲区发送，
+ * 每次最多IOV_MAX段，不做合并拷贝；部分发送只在队首消息上记录偏移。
+ * 一直写到队列清空或套接字发送缓冲区写满为止。只有在写满时才注册EPOLLOUT
+ * 等待可写，队列清空后立即取消，避免空闲连接产生多余的事件。
+ * 队首是文件段时改用sendfile，发完后继续发送其后的消息。
+ *
+ * io_uring后端上改为提交一个sendmsg请求，由HandleSent在完成后继续发送；
+ * 文件段同样用sendfile发送，套接字写满时注册可写通知，可写后再回到这里。
+ */
+void EpollServer::HandleWrite(Reactor* reactor, Connection* conn) {
+    struct iovec iov[IOV_MAX];
+    int fd = conn->fd;
+    
+    if (reactor->async_io) {
+        // 已有请求在途，完成后会继续发送队列中的剩余数据
+        if (conn->write_armed) {
+            return;
+        }
+        
+        int count = conn->send_queue.PrepareIov(iov, IOV_MAX);
+        if (count == 0 && conn->send_queue.HasMessages()) {
+            FileWriteResult result = WriteFile(reactor, conn);
+            if (result == FILE_WRITE_FAILED ||
+                !WaitFileWritable(reactor, conn, result == FILE_WRITE_BLOCKED)) {
+                return;
+            }
+            if (result == FILE_WRITE_DONE) {
+                count = conn->send_queue.PrepareIov(iov, IOV_MAX);
+            }
+        }
+        
+        if (count > 0) {
+            // 连接对象随请求一起保留，关闭后仍在途的请求不会访问已释放的队列
+            if (!reactor->poller->Send(fd, conn->tag, iov, count, conn->shared_from_this())) {
+                std::cerr << "Failed to submit write for fd " << fd << std::endl;
+                CloseConnection(reactor, conn);
+                return;
+            }
+            conn->write_armed = true;
+            conn->write_calls.fetch_add(1, std::memory_order_relaxed);
+            m_metrics.Add(MetricCounter::WriteCalls);
+        } else if (!conn->file_poll_armed) {
+            RecordWriteLatency(conn);
+        }
+        
+        UpdateWatermark(reactor, conn);
+        return;
+    }
+    
+    // 发送期间其他线程投递的数据会在下一轮取出
+    while (true) {
+        int count = conn->send_queue.PrepareIov(iov, IOV_MAX);
+        if (count == 0) {
+            if (!conn->send_queue.HasMessages()) {
+                break;
+            }
+            
+            // 队首是文件段
+            FileWriteResult result = WriteFile(reactor, conn);
+            if (result == FILE_WRITE_FAILED) {
+                return;
+            }
+            if (result == FILE_WRITE_BLOCKED) {
+                EnableWriting(reactor, conn, true);
+                UpdateWatermark(reactor, conn);
+                return;
+            }
+            continue;
+        }
+        
+        size_t total = 0;
+        for (int i = 0; i < count; i++) {
+            total += iov[i].iov_len;
+        }
+        
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        
+        ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        conn->write_calls.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.Add(MetricCounter::WriteCalls);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 发送缓冲区已满，等待可写事件
+                EnableWriting(reactor, conn, true);
+                UpdateWatermark(reactor, conn);
+                return;
+            }
+            
+            std::cerr << "Failed to write to fd " << fd << ": " << strerror(errno) << std::endl;
+            CloseConnection(reactor, conn);
+            return;
+        }
+        
+        conn->bytes_sent.fetch_add(sent, std::memory_order_relaxed);
+        m_metrics.Add(MetricCounter::BytesSent, static_cast<uint64_t>(sent));
+        m_tracer.Record(TraceStage::Written, conn->trace_id, 0, conn->bytes_sent.load(std::memory_order_relaxed));
+        conn->send_queue.Consume(static_cast<size_t>(sent));
+        
+        // 只写出了一部分，说明发送缓冲区已满
+        if (static_cast<size_t>(sent) < total) {
+            EnableWriting(reactor, conn, true);
+            UpdateWatermark(reactor, conn);
+            return;
+        }
+    }
+    
+    // 数据已全部发出，只监听读事件
+    RecordWriteLatency(conn);
+    EnableWriting(reactor, conn, false);
+    UpdateWatermark(reactor, conn);
+}
+
+/**
+ * @brief 用sendfile发送队首的文件段，只在事件循环线程中调用。
+ *
+ * 文件内容由内核从页缓存直接写入套接字，不经过用户态缓冲区。每次最多SENDFILE_CHUNK字节，
+ * 避免对端接收很快时一个大文件长时间占住事件循环；连续的多个文件段依次发送。
+ * 文件在投递后被截断时消息已无法补齐，只能关闭连接。
+ */
+EpollServer::FileWriteResult EpollServer::WriteFile(Reactor* reactor, Connection* conn) {
+    int file_fd;
+    off_t offset;
+    size_t len;
+    
+    while (conn->send_queue.FrontFile(file_fd, offset, len)) {
+        size_t chunk = len < SENDFILE_CHUNK ? len : SENDFILE_CHUNK;
+        ssize_t sent = sendfile(conn->fd, file_fd, &offset, chunk);
+        conn->write_calls.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.Add(MetricCounter::WriteCalls);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return FILE_WRITE_BLOCKED;
+            }
+            
+            std::cerr << "Failed to send file to fd " << conn->fd << ": " << strerror(errno) << std::endl;
+            CloseConnection(reactor, conn);
+            return FILE_WRITE_FAILED;
+        }
+        
+        if (sent == 0) {
+            std::cerr << "File truncated while sending to fd " << conn->fd << std::endl;
+            CloseConnection(reactor, conn);
+            return FILE_WRITE_FAILED;
+        }
+        
+        conn->bytes_sent.fetch_add(sent, std::memory_order_relaxed);
+        MetricsShard* metrics = m_metrics.Local();
+        metrics->Add(MetricCounter::BytesSent, static_cast<uint64_t>(sent));
+        metrics->Add(MetricCounter::FileBytesSent, static_cast<uint64_t>(sent));
+        m_tracer.Record(TraceStage::Written, conn->trace_id, 0, conn->bytes_sent.load(std::memory_order_relaxed));
+        conn->send_queue.Consume(static_cast<size_t>(sent));
+        
+        // 只写出了一部分，说明发送缓冲区已满
+        if (static_cast<size_t>(sent) < chunk) {
+            return FILE_WRITE_BLOCKED;
+        }
+    }
+    
+    return FILE_WRITE_DONE;
+}
+
+/**
+ * @brief io_uring后端下等待套接字可写。
+ *
+ * 连接平时只有recv/sendmsg请求，不在就绪通知中；sendfile写满后临时注册EPOLLOUT，
+ * 文件段发完即取消。注册失败时关闭连接并返回false。
+ */
+bool EpollServer::WaitFileWritable(Reactor* reactor, Connection* conn, bool enable) {
+    if (conn->file_poll_armed == enable) {
+        return true;
+    }
+    
+    conn->file_poll_armed = enable;
+    if (!enable) {
+        RemoveFromPoller(reactor, conn->fd);
+        return true;
+    }
+    
+    if (!AddToPoller(reactor, conn->fd, EPOLLOUT)) {
+        std::cerr << "Failed to wait for writable fd " << conn->fd << std::endl;
+        CloseConnection(reactor, conn);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 在事件循环线程中直接向空闲连接写数据。
+ *
+ * 调用方需保证连接没有排队数据且未等待EPOLLOUT，这样直接写入不会打乱顺序。
+ * 未写完的部分进入发送队列并注册EPOLLOUT（共享缓冲区只入队引用）。写入出错时不在这里关闭连接
+ * （调用方可能正处于HandleRead中），由随后的错误事件负责清理。
+ */
+bool EpollServer::WriteInline(Reactor* reactor, Connection* conn, const char* data, size_t len, const SharedBuffer& shared) {
+    int fd = conn->fd;
+    size_t total_sent = 0;
+    
+    while (total_sent < len) {
+        ssize_t sent = send(fd, data + total_sent, len - total_sent, MSG_NOSIGNAL);
+        conn->write_calls.fetch_add(1, std::memory_order_relaxed);
+        m_metrics.Add(MetricCounter::WriteCalls);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            
+            std::cerr << "Failed to write to fd " << fd << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        
+        total_sent += sent;
+    }
+    
+    conn->bytes_sent.fetch_add(total_sent, std::memory_order_relaxed);
+    m_metrics.Add(MetricCounter::BytesSent, total_sent);
+    if (total_sent > 0) {
+        m_tracer.Record(TraceStage::Written, conn->trace_id, 0, conn->bytes_sent.load(std::memory_order_relaxed));
+    }
+    
+    if (total_sent < len) {
+        if (shared) {
+            // 共享缓冲区整体入队，已写出的部分记为队首偏移
+            if (!conn->send_queue.PushShared(shared)) {
+                return false;
+            }
+            conn->send_queue.Consume(total_sent);
+        } else if (!conn->send_queue.Push(data + total_sent, len - total_sent)) {
+            return false;
+        }
+        
+        MarkQueued(conn);
+        EnableWriting(reactor, conn, true);
+    }
+    
+    return true;
+}
+
+/**
+ * @brief 通知连接所属的reactor有数据待发送。
+ *
+ * 待发送列表由空变为非空时才写eventfd，同一轮中多次投递只唤醒一次。
+ */
+void EpollServer::ScheduleWrite(Reactor* reactor, const std::shared_ptr<Connection>& conn) {
+    bool need_wakeup = false;
+    {
+        std::lock_guard<std::mutex> lock(reactor->pending_mutex);
+        need_wakeup = reactor->pending_writes.empty();
+        reactor->pending_writes.push_back(conn);
+    }
+    
+    if (need_wakeup) {
+        WakeupReactor(reactor);
+    }
+}
+
+/**
+ * @brief 把连接加入本轮结束时发送的列表。
+ *
+ * io_uring后端下回调中的多次回包只入队，本轮事件处理结束后每个连接提交一个sendmsg请求，
+ * 所有连接的请求随下一次io_uring_enter一起提交。epoll后端下事件循环线程中的SendFile
+ * 也在这里延后到本轮结束时发送。
+ */
+void EpollServer::ScheduleFlush(Reactor* reactor, Connection* conn) {
+    if (conn->flush_pending) {
+        return;
+    }
+    
+    conn->flush_pending = true;
+    reactor->flush_conns.push_back(conn->shared_from_this());
+}
+
+void EpollServer::FlushWrites(Reactor* reactor) {
+    std::vector<std::shared_ptr<Connection>> conns;
+    conns.swap(reactor->flush_conns);
+    
+    for (const auto& conn : conns) {
+        conn->flush_pending = false;
+        if (!conn->IsClosed()) {
+            HandleWrite(reactor, conn.get());
+        }
+    }
+}
+
+void EpollServer::EnableWriting(Reactor* reactor, Connection* conn, bool enable) {
+    if (conn->write_armed == enable) {
+        return;
+    }
+    
+    conn->write_armed = enable;
+    UpdateEvents(reactor, conn);
+}
+
+void EpollServer::UpdateEvents(Reactor* reactor, Connection* conn) {
+    if (reactor->async_io) {
+        // io_uring后端通过取消/重新发起recv暂停或恢复读取；
+        // 取消尚未完成时不重新发起，由最后一个完成事件根据read_paused决定
+        if (conn->read_paused) {
+            if (conn->recv_active && !conn->recv_cancelling) {
+                reactor->poller->CancelRecv(conn->fd, conn->tag);
+                conn->recv_cancelling = true;
+            }
+        } else if (!conn->recv_active) {
+            StartRecv(reactor, conn);
+        }
+        return;
+    }
+    
+    uint32_t events = EPOLLET | EPOLLRDHUP;
+    if (!conn->read_paused) {
+        events |= EPOLLIN;
+    }
+    if (conn->write_armed) {
+        events |= EPOLLOUT;
+    }
+    
+    ModifyPoller(reactor, conn->fd, events);
+}
+
+/**
+ * @brief 数据入队后检查发送队列是否超过高水位。
+ *
+ * 超过时标记连接，由所属事件循环暂停读取，并返回SEND_HIGH_WATER提示调用方暂停生产。
+ */
+SendStatus EpollServer::CheckHighWater(Connection* conn) {
+    size_t high = m_high_water_mark.load(std::memory_order_relaxed);
+    if (high == 0 || conn->send_queue.GetQueuedBytes() < high) {
+        return SEND_OK;
+    }
+    
+    conn->over_high_water.store(true, std::memory_order_release);
+    return SEND_HIGH_WATER;
+}
+
+/**
+ * @brief 按发送队列水位暂停或恢复读取。
+ *
+ * 超过高水位后暂停EPOLLIN，不再读取该客户端的新请求；队列回落到低水位及以下时
+ * 恢复读取并调用可写回调。只能在连接所属的事件循环线程中调用。
+ */
+void EpollServer::UpdateWatermark(Reactor* reactor, Connection* conn) {
+    if (!conn->over_high_water.load(std::memory_order_acquire) || conn->IsClosed()) {
+        return;
+    }
+    
+    if (conn->send_queue.GetQueuedBytes() > m_low_water_mark.load(std::memory_order_relaxed)) {
+        if (!conn->read_paused) {
+            conn->read_paused = true;
+            UpdateEvents(reactor, conn);
+        }
+        return;
+    }
+    
+    conn->over_high_water.store(false, std::memory_order_release);
+    if (conn->read_paused) {
+        conn->read_paused = false;
+        UpdateEvents(reactor, conn);
+    }
+    
+    if (m_on_writable) {
+        m_on_writable(conn->fd);
+    }
+}
+
+void EpollServer::CloseConnection(Reactor* reactor, Connection* conn) {
+    int fd = conn->fd;
+    if (conn->IsClosed()) {
+        return;
+    }
+    
+    // 标记关闭，其他线程持有的引用不会再投递数据
+    conn->state.store(ConnState::Closed, std::memory_order_release);
+    
+    // 取消空闲超时检查
+    if (conn->idle_timer) {
+        reactor->timers.Cancel(conn->idle_timer);
+        conn->idle_timer = 0;
+    }
+    
+    // 尚未交付的批量消息随连接丢弃
+    if (conn->batch_timer) {
+        reactor->timers.Cancel(conn->batch_timer);
+        conn->batch_timer = 0;
+    }
+    conn->batch.clear();
+    conn->batch_inflated.clear();
+    
+    if (reactor->async_io) {
+        // 取消连接上未完成的recv/sendmsg，必须在关闭fd之前提交
+        if (conn->file_poll_armed) {
+            conn->file_poll_armed = false;
+            RemoveFromPoller(reactor, fd);
+        }
+        reactor->poller->CancelAll(fd);
+    } else {
+        // 从epoll中移除
+        RemoveFromPoller(reactor, fd);
+    }
+    
+    // 从连接表移除，连接对象延迟到本轮事件处理结束后释放
+    reactor->closed_conns.push_back(m_connections.Get(fd));
+    m_connections.Remove(fd);
+    
+    // 关闭套接字
+    close(fd);
+    
+    // 清理发送队列（在途的sendmsg仍引用队列中的数据时，由连接对象析构时释放）
+    if (!reactor->async_io || !conn->write_armed) {
+        conn->send_queue.Clear();
+    }
+    
+    reactor->conn_count.fetch_sub(1, std::memory_order_relaxed);
+    m_metrics.Add(MetricCounter::ConnectionsClosed);
+    
+    // 调用断开连接回调
+    if (m_on_disconnect) {
+        m_on_disconnect(fd);
+    }
+}
+
+void EpollServer::EpollLoop(Reactor* reactor) {
+    PollEvent events[MAX_EVENTS];
+    
+    reactor->thread_id = std::this_thread::get_id();
+    
+    // sendfile没有MSG_NOSIGNAL，对端关闭时由本线程屏蔽SIGPIPE，只返回EPIPE
+    sigset_t sigpipe;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+    
+    while (m_running) {
+        int nfds = reactor->poller->Wait(events, MAX_EVENTS, 100);
+        if (nfds == -1) {
+            if (errno == EINTR) {
+                // 被信号中断，继续
+                continue;
+            }
+            
+            std::cerr << reactor->poller->Name() << " wait error: " << strerror(errno) << std::endl;
+            break;
+        }
+        
+        if (nfds > 0) {
+            MetricsShard* metrics = m_metrics.Local();
+            metrics->Add(MetricCounter::PollWaits, 1);
+            metrics->Record(MetricHistogram::PollBatchSize, static_cast<uint64_t>(nfds));
+        }
+        
+        // SO_REUSEPORT模式下由0号reactor负责统计接受速率
+        if (m_accept_mode == AcceptMode::ReusePort && reactor->index == 0) {
+            UpdateAcceptRate();
+        }
+        
+        for (int i = 0; i < nfds; i++) {
+            int fd = events[i].fd;
+            
+            // io_uring后端的完成事件
+            switch (events[i].type) {
+            case PollEventType::Accepted:
+                HandleAccepted(reactor, events[i]);
+                continue;
+            case PollEventType::Received:
+                HandleReceived(reactor, events[i]);
+                continue;
+            case PollEventType::Sent:
+                HandleSent(reactor, events[i]);
+                continue;
+            case PollEventType::Ready:
+                break;
+            }
+            
+            // 处理跨线程唤醒（新连接移交等）
+            if (fd == reactor->wakeup_fd) {
+                HandleWakeup(reactor);
+                continue;
+            }
+            
+            // 处理到期的定时器
+            if (fd == reactor->timers.GetFd()) {
+                reactor->timers.HandleExpired();
+                continue;
+            }
+            
+            // 处理监听套接字的读事件（新连接）
+            if (fd == reactor->listen_fd) {
+                if (events[i].events & EPOLLIN) {
+                    AcceptConnection(reactor);
+                }
+                continue;
+            }
+            
+            // 按fd直接索引连接
+            Connection* conn = m_connections.GetLocal(fd);
+            if (!conn || conn->IsClosed()) {
+                continue;
+            }
+            
+            // 处理错误事件
+            //这里 events[i].events 是一个事件掩码，EPOLLERR | EPOLLHUP 是错误和挂起事件的掩码。
+            //& 运算会判断 events[i].events 是否包含这两个事件中的任意一个。
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                std::cerr << "epoll error on fd " << fd << std::endl;
+                CloseConnection(reactor, conn);
+                continue;
+            }
+            
+            // 处理客户端套接字的读事件
+            if (events[i].events & EPOLLIN) {
+                HandleRead(reactor, conn, (events[i].events & EPOLLRDHUP) != 0);
+            }
+            
+            // 处理客户端套接字的写事件（读事件中可能已经关闭了连接）
+            if ((events[i].events & EPOLLOUT) && !conn->IsClosed()) {
+                HandleWrite(reactor, conn);
+            }
+        }
+        
+        // 提交本轮回包产生的发送请求
+        if (!reactor->flush_conns.empty()) {
+            FlushWrites(reactor);
+        }
+        
+        // 释放本轮关闭的连接
+        reactor->closed_conns.clear();
+    }
+}
+
+/**
+ * @brief acceptor线程的事件循环。
+ *
+ * 只监听一个监听套接字，有新连接时调用AcceptBatch()批量接受并分发，
+ * 同时维护每秒接受连接数的统计。
+ */
+void EpollServer::AcceptorLoop() {
+    PollEvent events[1];
+    
     while (m_running) {
-        // 检查所有连接的发送队列
-        std::vector<int> fds = m_send_queue.GetAllFds();
+        int nfds = m_acceptor_poller->Wait(events, 1, 100);
+        if (nfds == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            std::cerr << m_acceptor_poller->Name() << " wait error: " << strerror(errno) << std::endl;
+            break;
+        }
         
-        for (int fd : fds) {
-            if (m_send_queue.HasMessages(fd)) {
-                // 确保监听写事件
-                ModifyEpoll(fd, EPOLLIN | EPOLLOUT | EPOLLET);
+        if (nfds > 0 && (events[0].events & EPOLLIN)) {
+            AcceptBatch();
+        }
+        
+        UpdateAcceptRate();
+    }
+}
+
+/**
+ * @brief 向指定客户端发送消息。
+ *
+ * 在连接所属reactor的事件循环线程中调用（例如在消息回调里回包）且连接空闲时，
+ * 数据会被直接写入套接字；否则加入发送队列，并通过eventfd唤醒reactor尽快发送。
+ * 发送操作是异步的，调用此方法并不保证数据立即发送完成。
+ *
+ * @param client_fd 客户端的文件描述符，必须为有效的非负整数。
+ * @param data 指向待发送数据的指针。
+ * @param len 待发送数据的长度（字节数）。
+ * @return 如果服务器正在运行且参数有效，且数据成功加入发送队列，则返回 true；
+ *         否则返回 false。
+ *
+ * @note
+ * - 当服务器未运行、client_fd 无效或连接已关闭时，方法直接返回 false。
+ * - 数据实际发送由服务器内部机制完成，可能存在延迟。
+ * - 发送队列满或发生异常时，Push 可能失败，导致返回 false。
+ */
+SendStatus EpollServer::SendMessage(int client_fd, const char* data, size_t len) {
+    if (!data || len == 0) {
+        return SEND_FAILED;
+    }
+    
+    return SendData(client_fd, data, len, SharedBuffer());
+}
+
+/**
+ * @brief 序列化并发送一条TLV消息。
+ *
+ * 按连接协商的帧格式序列化。对端通过握手启用了压缩时，内容不短于压缩阈值的消息
+ * 在调用线程中压缩，压缩前后的内容字节数和耗时计入compress_*指标。可在任意线程调用。
+ */
+SendStatus EpollServer::SendFrame(int client_fd, uint16_t type, const char* value, size_t len) {
+    if ((!value && len > 0) || len >= TLV_COMPRESSED_FLAG) {
+        return SEND_FAILED;
+    }
+    
+    std::shared_ptr<Connection> conn = m_connections.Get(client_fd);
+    if (!conn) {
+        return SEND_FAILED;
+    }
+    
+    size_t threshold = m_compress_threshold.load(std::memory_order_relaxed);
+    if (threshold == 0 || len < threshold || !conn->compress_output.load(std::memory_order_relaxed)) {
+        threshold = 0;
+    }
+    
+    // 每个线程复用一个序列化缓冲区，SendData会复制或直接写出
+    static thread_local std::vector<char> t_frame;
+    TLVProtocol protocol;
+    protocol.SetFormat(conn->frame_format.load(std::memory_order_relaxed));
+    
+    int64_t start = threshold ? NowNs() : 0;
+    uint32_t payload_size = 0;
+    protocol.SerializeFrame(type, value, static_cast<uint32_t>(len), t_frame, threshold, &payload_size);
+    if (threshold) {
+        int64_t elapsed = NowNs() - start;
+        MetricsShard* metrics = m_metrics.Local();
+        metrics->Add(MetricCounter::CompressIn, len);
+        metrics->Add(MetricCounter::CompressOut, payload_size);
+        metrics->Add(MetricCounter::CompressNs, static_cast<uint64_t>(elapsed));
+    }
+    
+    return SendData(client_fd, t_frame.data(), t_frame.size(), SharedBuffer());
+}
+
+/**
+ * @brief 发送一条内容来自文件的TLV消息。
+ *
+ * 头部按连接的帧格式序列化，与文件段一起作为一个整体进入发送队列，和其他接口投递的
+ * 消息按顺序发出。文件内容在事件循环线程中用sendfile从页缓存直接写入套接字，不复制到
+ * 用户态；套接字写满时与其他消息一样等待可写。file_fd复制一份由发送队列持有，发送完成
+ * 或连接关闭时关闭。文件内容不压缩，计入发送队列水位。只接受普通文件，范围超出文件
+ * 大小时返回SEND_FAILED。可在任意线程调用。
+ */
+SendStatus EpollServer::SendFile(int client_fd, int file_fd, off_t offset, size_t len, uint16_t tlv_type) {
+    if (!m_running || file_fd < 0 || offset < 0 || len >= TLV_COMPRESSED_FLAG) {
+        return SEND_FAILED;
+    }
+    
+    if (len == 0) {
+        return SendFrame(client_fd, tlv_type, nullptr, 0);
+    }
+    
+    struct stat st;
+    if (fstat(file_fd, &st) == -1 || !S_ISREG(st.st_mode) || offset > st.st_size ||
+        static_cast<off_t>(len) > st.st_size - offset) {
+        return SEND_FAILED;
+    }
+    
+    std::shared_ptr<Connection> conn = m_connections.Get(client_fd);
+    if (!conn || conn->IsClosed()) {
+        return SEND_FAILED;
+    }
+    
+    Reactor* reactor = m_reactors[conn->reactor_index].get();
+    
+    TLVProtocol protocol;
+    protocol.SetFormat(conn->frame_format.load(std::memory_order_relaxed));
+    char header[TLV_V2_MAX_HEADER_SIZE];
+    size_t header_len = protocol.SerializeHeader(tlv_type, static_cast<uint32_t>(len), header);
+    
+    int queued_fd = fcntl(file_fd, F_DUPFD_CLOEXEC, 0);
+    if (queued_fd == -1) {
+        std::cerr << "Failed to duplicate file fd " << file_fd << ": " << strerror(errno) << std::endl;
+        return SEND_FAILED;
+    }
+    
+    if (m_tracer.IsEnabled()) {
+        uint64_t end = conn->trace_enqueued.fetch_add(header_len + len, std::memory_order_relaxed) + header_len + len;
+        m_tracer.Record(TraceStage::Enqueue, conn->trace_id, 0, end);
+    }
+    
+    if (!conn->send_queue.PushFile(header, header_len, queued_fd, offset, len)) {
+        close(queued_fd);
+        return SEND_FAILED;
+    }
+    
+    MarkQueued(conn.get());
+    m_metrics.Record(MetricHistogram::SendQueueBytes, conn->send_queue.GetQueuedBytes());
+    m_metrics.Add(MetricCounter::MessagesSent);
+    SendStatus status = CheckHighWater(conn.get());
+    
+    if (reactor->thread_id.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+        // 在所属事件循环线程中：本轮事件处理结束时发送，排在回调中已投递的回包之后
+        ScheduleFlush(reactor, conn.get());
+        if (status == SEND_HIGH_WATER) {
+            UpdateWatermark(reactor, conn.get());
+        }
+    } else {
+        ScheduleWrite(reactor, conn);
+    }
+    return status;
+}
+
+/**
+ * @brief 向指定客户端发送共享缓冲区。
+ *
+ * 与SendMessage相同的发送路径，但发送队列只持有缓冲区的引用，不复制数据。
+ * 缓冲区在所有连接发送完成后自动释放，调用方不得再修改其内容。
+ */
+SendStatus EpollServer::SendShared(int client_fd, const SharedBuffer& buffer) {
+    if (!buffer || buffer->empty()) {
+        return SEND_FAILED;
+    }
+    
+    return SendData(client_fd, buffer->data(), buffer->size(), buffer);
+}
+
+/**
+ * @brief 向多个客户端广播同一条消息。
+ *
+ * 数据只复制一次到共享缓冲区，各连接的发送队列引用同一份数据。
+ *
+ * @return 成功投递的连接数。
+ */
+size_t EpollServer::Broadcast(const std::vector<int>& fds, const char* data, size_t len) {
+    if (!data || len == 0 || fds.empty()) {
+        return 0;
+    }
+    
+    return Broadcast(fds, MakeSharedBuffer(data, len));
+}
+
+size_t EpollServer::Broadcast(const std::vector<int>& fds, const SharedBuffer& buffer) {
+    size_t delivered = 0;
+    
+    for (int fd : fds) {
+        if (SendShared(fd, buffer) != SEND_FAILED) {
+            delivered++;
+        }
+    }
+    
+    return delivered;
+}
+
+SendStatus EpollServer::SendData(int client_fd, const char* data, size_t len, const SharedBuffer& shared) {
+    if (!m_running || client_fd < 0) {
+        return SEND_FAILED;
+    }
+    
+    // 按fd找到连接及其所属的reactor
+    std::shared_ptr<Connection> conn = m_connections.Get(client_fd);
+    if (!conn || conn->IsClosed()) {
+        return SEND_FAILED;
+    }
+    
+    Reactor* reactor = m_reactors[conn->reactor_index].get();
+    
+    // 记录这段数据在连接发送字节流中的结束位置，解码时与Written的累计字节数对应
+    if (m_tracer.IsEnabled()) {
+        uint64_t end = conn->trace_enqueued.fetch_add(len, std::memory_order_relaxed) + len;
+        m_tracer.Record(TraceStage::Enqueue, conn->trace_id, 0, end);
+    }
+    
+    // 在所属事件循环线程中且没有排队数据时直接写入
+    if (reactor->thread_id.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+        bool ok;
+        if (reactor->async_io) {
+            // io_uring后端只入队，本轮结束时批量提交
+            ok = EnqueueData(conn.get(), data, len, shared);
+            if (ok) {
+                ScheduleFlush(reactor, conn.get());
             }
+        } else if (!conn->write_armed && !conn->send_queue.HasMessages()) {
+            ok = WriteInline(reactor, conn.get(), data, len, shared);
+        } else {
+            // 队列中已有数据，排在其后，由已注册的EPOLLOUT或待发送列表负责发出
+            ok = EnqueueData(conn.get(), data, len, shared);
         }
         
-        // 休眠一小段时间，避免CPU占用过高
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (!ok) {
+            return SEND_FAILED;
+        }
+        
+        m_metrics.Add(MetricCounter::MessagesSent);
+        SendStatus status = CheckHighWater(conn.get());
+        if (status == SEND_HIGH_WATER) {
+            UpdateWatermark(reactor, conn.get());
+        }
+        return status;
+    }
+    
+    // 将数据添加到发送队列并唤醒reactor
+    if (!EnqueueData(conn.get(), data, len, shared)) {
+        return SEND_FAILED;
+    }
+    
+    m_metrics.Add(MetricCounter::MessagesSent);
+    SendStatus status = CheckHighWater(conn.get());
+    ScheduleWrite(reactor, conn);
+    return status;
+}
+
+bool EpollServer::EnqueueData(Connection* conn, const char* data, size_t len, const SharedBuffer& shared) {
+    bool ok = shared ? conn->send_queue.PushShared(shared) : conn->send_queue.Push(data, len);
+    if (!ok) {
+        return false;
     }
+    
+    MarkQueued(conn);
+    m_metrics.Record(MetricHistogram::SendQueueBytes, conn->send_queue.GetQueuedBytes());
+    return true;
 }
 
 /**
- * @brief 向指定客户端发送消息。
- *
- * 此方法用于将待发送的数据添加到发送队列，稍后由服务器线程实际发送给客户端。
- * 发送操作是异步的，调用此方法并不保证数据立即发送完成。
+ * @brief 发送队列由空变为非空时记录时间。
  *
- * @param client_fd 客户端的文件描述符，必须为有效的非负整数。
- * @param data 指向待发送数据的指针。
- * @param len 待发送数据的长度（字节数）。
- * @return 如果服务器正在运行且参数有效，且数据成功加入发送队列，则返回 true；
- *         否则返回 false。
+ * 只有第一个入队的线程读取时钟，队列非空期间的后续入队只做一次原子读取。
+ * 与写空时的清零存在竞争时可能漏记一次，只影响统计，不影响发送。
+ */
+void EpollServer::MarkQueued(Connection* conn) {
+    if (conn->queued_since_ns.load(std::memory_order_relaxed) != 0) {
+        return;
+    }
+    
+    int64_t expected = 0;
+    conn->queued_since_ns.compare_exchange_strong(expected, NowNs(), std::memory_order_relaxed);
+}
+
+/**
+ * @brief 发送队列写空时记录从队列变为非空到全部写出的时间。
  *
- * @note
- * - 当服务器未运行或 client_fd 无效时，方法直接返回 false。
- * - 数据实际发送由服务器内部机制完成，可能存在延迟。
- * - 发送队列满或发生异常时，Push 可能失败，导致返回 false。
+ * 这是本批数据中最早入队的消息等待的时间，反映发送队列上最差的排队延迟。
+ * 只在连接所属的事件循环线程中调用。
  */
-bool EpollServer::SendMessage(int client_fd, const char* data, size_t len) {
-    if (!m_running || client_fd < 0) {
+void EpollServer::RecordWriteLatency(Connection* conn) {
+    int64_t since = conn->queued_since_ns.exchange(0, std::memory_order_relaxed);
+    if (since != 0) {
+        m_metrics.Record(MetricHistogram::EnqueueToWriteNs, static_cast<uint64_t>(NowNs() - since));
+    }
+}
+
+bool EpollServer::GetConnectionStats(int client_fd, ConnectionStats& stats) const {
+    std::shared_ptr<Connection> conn = m_connections.Get(client_fd);
+    if (!conn || conn->IsClosed()) {
         return false;
     }
     
-    // 将数据添加到发送队列
-    return m_send_queue.Push(client_fd, data, len);
+    stats = conn->GetStats();
+    return true;
 }
 
 void EpollServer::SetOnConnectCallback(std::function<void(int)> callback) {
@@ -492,4 +2047,496 @@ void EpollServer::SetOnDisconnectCallback(std::function<void(int)> callback) {
 
 void EpollServer::SetOnMessageCallback(std::function<void(int, const TLVMessage&)> callback) {
     m_on_message = callback;
+}
+
+/**
+ * @brief 设置零拷贝消息回调。
+ *
+ * 回调收到的TLVView直接指向连接的接收缓冲区，不做堆分配和拷贝，适合只检查或
+ * 转发消息内容的处理器。视图只在回调期间有效，需要保留时调用TLVView::ToMessage()。
+ * 与SetOnMessageCallback可以同时设置，此时先调用本回调。
+ */
+void EpollServer::SetOnMessageViewCallback(std::function<void(int, const TLVView&)> callback) {
+    m_on_message_view = callback;
+}
+
+/**
+ * @brief 注册按类型分发的处理函数。
+ *
+ * 处理函数在消息回调之后调用，与消息回调在同一线程中执行：设置了处理线程数时在
+ * 处理线程中执行（同一连接的消息按顺序处理），否则在IO线程中执行。收到的TLVView
+ * 只在调用期间有效。分发表在运行期间不加锁读取，因此只能在Start之前注册，
+ * 运行中调用返回false。
+ */
+bool EpollServer::RegisterHandler(uint16_t type, MessageHandler handler) {
+    if (m_running) {
+        return false;
+    }
+    
+    m_dispatcher.Register(type, std::move(handler));
+    return true;
+}
+
+bool EpollServer::UnregisterHandler(uint16_t type) {
+    if (m_running) {
+        return false;
+    }
+    
+    m_dispatcher.Unregister(type);
+    return true;
+}
+
+/**
+ * @brief 设置默认处理函数。
+ *
+ * 没有注册处理函数的类型交给它处理，未设置时这些消息只计入
+ * messages_unhandled_total，便于发现客户端发来的未知类型。
+ */
+bool EpollServer::SetDefaultHandler(MessageHandler handler) {
+    if (m_running) {
+        return false;
+    }
+    
+    m_dispatcher.SetDefault(std::move(handler));
+    return true;
+}
+
+/**
+ * @brief 按类型分发一条消息，并按类型统计是否找到了注册的处理函数。
+ */
+void EpollServer::RouteMessage(MetricsShard* metrics, int fd, const TLVView& view) {
+    if (m_dispatcher.Dispatch(fd, view)) {
+        metrics->AddType(MetricTypeCounter::Handled, view.type);
+    } else {
+        metrics->AddType(MetricTypeCounter::Unhandled, view.type);
+    }
+}
+
+/**
+ * @brief 设置批量消息回调。
+ *
+ * 一次读完套接字（epoll后端的一轮读取，io_uring后端的一个recv完成事件）解析出的
+ * 消息合并为一次调用，写数据库或转发下游的处理器可以据此合并操作。视图直接指向
+ * 接收缓冲区，只在回调期间有效；回调在IO线程中执行，在单条消息回调之后调用。
+ * 每批最多SetMessageBatchLimits设置的条数，设置了最长延迟时不足一批的消息会保留到
+ * 后续读取，最迟在第一条消息解析后max_delay_ms毫秒交付（按定时器精度）。
+ * 连接关闭时尚未交付的消息被丢弃。
+ */
+void EpollServer::SetOnMessageBatchCallback(std::function<void(int, const TLVView*, size_t)> callback) {
+    m_on_message_batch = callback;
+}
+
+/**
+ * @brief 设置批量消息回调每批的最大消息数和最长延迟。
+ *
+ * max_messages为0时按1处理。max_delay_ms为0（默认）时每次读完即交付，不跨读取保留消息；
+ * 大于0时消息最多保留这么久以凑成更大的批次，保留期间对应的数据留在接收缓冲区中。
+ */
+void EpollServer::SetMessageBatchLimits(size_t max_messages, int64_t max_delay_ms) {
+    m_batch_max_messages.store(max_messages > 0 ? max_messages : 1, std::memory_order_relaxed);
+    m_batch_max_delay_ms.store(max_delay_ms > 0 ? max_delay_ms : 0, std::memory_order_relaxed);
+}
+
+void EpollServer::SetOnWritableCallback(std::function<void(int)> callback) {
+    m_on_writable = callback;
+}
+
+/**
+ * @brief 设置每个连接发送队列的高/低水位（字节）。
+ *
+ * 发送队列达到high时，SendMessage/SendShared返回SEND_HIGH_WATER（数据仍已入队），
+ * 并暂停读取该连接的请求；队列回落到low及以下时恢复读取并调用可写回调，
+ * 生产者可以据此做流量控制。high为0表示不限制；low大于high时按high处理。
+ */
+void EpollServer::SetWriteWatermarks(size_t high, size_t low) {
+    m_high_water_mark.store(high, std::memory_order_relaxed);
+    m_low_water_mark.store(low < high ? low : high, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 设置消息处理线程数。
+ *
+ * 大于0时，SetOnMessageCallback设置的回调不再在IO线程中执行，而是复制消息后
+ * 交给工作窃取线程池处理，耗时的回调不会阻塞其他连接的读写。同一连接的消息
+ * 按接收顺序依次处理，同一时刻最多只有一个线程在处理它。零拷贝的视图回调
+ * 仍在IO线程中执行。连接关闭后尚未处理的消息会被丢弃（fd可能已被新连接复用）。
+ * 必须在Start()之前调用。
+ */
+void EpollServer::SetHandlerThreads(size_t threads) {
+    if (m_running) {
+        return;
+    }
+    
+    m_handler_threads = threads;
+}
+
+HandlerStats EpollServer::GetHandlerStats() const {
+    HandlerStats stats;
+    stats.threads = m_handler_pool.GetThreadCount();
+    stats.queue_depth = m_handler_pending.load(std::memory_order_relaxed);
+    stats.handled = m_handler_handled.load(std::memory_order_relaxed);
+    stats.stolen = m_handler_pool.GetStolenCount();
+    stats.avg_wait_us = stats.handled ? m_handler_wait_us.load(std::memory_order_relaxed) / stats.handled : 0;
+    stats.avg_handler_us = stats.handled ? m_handler_run_us.load(std::memory_order_relaxed) / stats.handled : 0;
+    stats.max_handler_us = m_handler_max_us.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+ * @brief 把一条消息放入连接的处理队列。
+ *
+ * 连接没有正在处理的任务时才向线程池提交，已有任务时由该任务顺序处理，
+ * 从而保证同一连接的消息不会被多个线程并发或乱序处理。
+ */
+void EpollServer::DispatchMessage(Connection* conn, const TLVView& view, uint64_t seq) {
+    HandlerMessage pending;
+    pending.message = view.ToMessage();
+    pending.enqueue_us = NowUs();
+    pending.seq = seq;
+    
+    bool need_submit = false;
+    {
+        std::lock_guard<std::mutex> lock(conn->handler_mutex);
+        conn->handler_queue.push_back(std::move(pending));
+        if (!conn->handler_scheduled) {
+            conn->handler_scheduled = true;
+            need_submit = true;
+        }
+    }
+    
+    m_handler_pending.fetch_add(1, std::memory_order_relaxed);
+    
+    if (need_submit) {
+        m_handler_pool.Submit(std::bind(&EpollServer::RunHandlers, this, conn->shared_from_this()));
+    }
+}
+
+/**
+ * @brief 处理一个连接排队的消息。
+ *
+ * 每次最多处理HANDLER_BATCH条，剩余的重新提交，避免一个繁忙连接长期占住线程。
+ */
+void EpollServer::RunHandlers(const std::shared_ptr<Connection>& conn) {
+    for (int i = 0; i < HANDLER_BATCH; i++) {
+        HandlerMessage pending;
+        {
+            std::lock_guard<std::mutex> lock(conn->handler_mutex);
+            if (conn->handler_queue.empty()) {
+                conn->handler_scheduled = false;
+                return;
+            }
+            pending = std::move(conn->handler_queue.front());
+            conn->handler_queue.pop_front();
+        }
+        
+        m_handler_pending.fetch_sub(1, std::memory_order_relaxed);
+        
+        // 连接已关闭，fd可能已分配给新连接，丢弃剩余消息
+        if (conn->IsClosed()) {
+            continue;
+        }
+        
+        int64_t start = NowUs();
+        m_tracer.Record(TraceStage::CallbackStart, conn->trace_id, pending.message.type, pending.seq);
+        if (m_on_message) {
+            m_on_message(conn->fd, pending.message);
+        }
+        if (!m_dispatcher.IsEmpty()) {
+            TLVView view(pending.message.type, pending.message.value.data(), pending.message.length);
+            RouteMessage(m_metrics.Local(), conn->fd, view);
+        }
+        m_tracer.Record(TraceStage::CallbackDone, conn->trace_id, pending.message.type, pending.seq);
+        int64_t end = NowUs();
+        
+        uint64_t run_us = static_cast<uint64_t>(end - start);
+        m_handler_handled.fetch_add(1, std::memory_order_relaxed);
+        m_handler_wait_us.fetch_add(static_cast<uint64_t>(start - pending.enqueue_us), std::memory_order_relaxed);
+        m_metrics.Record(MetricHistogram::ParseToCallbackNs, static_cast<uint64_t>(start - pending.enqueue_us) * 1000);
+        m_handler_run_us.fetch_add(run_us, std::memory_order_relaxed);
+        
+        uint64_t max_us = m_handler_max_us.load(std::memory_order_relaxed);
+        while (run_us > max_us &&
+               !m_handler_max_us.compare_exchange_weak(max_us, run_us, std::memory_order_relaxed)) {
+        }
+    }
+    
+    // 还有消息未处理，重新提交，handler_scheduled保持为true
+    m_handler_pool.Submit(std::bind(&EpollServer::RunHandlers, this, conn));
+}
+/**
+ * @brief 设置连接空闲超时。
+ *
+ * 超过timeout_ms毫秒没有收到任何数据的连接会被自动关闭（触发断开连接回调），
+ * 用于清理异常断开、不再发送数据的客户端。需要心跳的协议可以让客户端定期发送心跳消息，
+ * 或由服务端通过RunEvery定期广播。只对之后建立的连接生效，0表示不限制。
+ */
+void EpollServer::SetIdleTimeout(int64_t timeout_ms) {
+    m_idle_timeout_ms.store(timeout_ms > 0 ? timeout_ms : 0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 安排一次空闲检查。
+ *
+ * 每个连接只有一个定时器，收到数据时只更新last_active_ms，不重新设置定时器；
+ * 定时器到期时再根据最近活动时间决定关闭连接还是顺延，收发频繁的连接没有额外开销。
+ */
+void EpollServer::ScheduleIdleCheck(Connection* conn, int64_t delay_ms) {
+    Reactor* reactor = m_reactors[conn->reactor_index].get();
+    
+    // 连接关闭时会在同一线程中取消定时器，回调中可以直接使用裸指针
+    conn->idle_timer = reactor->timers.RunAfter(delay_ms, [this, conn]() {
+        CheckIdle(conn);
+    });
+}
+
+void EpollServer::CheckIdle(Connection* conn) {
+    conn->idle_timer = 0;
+    if (conn->IsClosed()) {
+        return;
+    }
+    
+    int64_t timeout = m_idle_timeout_ms.load(std::memory_order_relaxed);
+    int64_t idle = NowMs() - conn->last_active_ms.load(std::memory_order_relaxed);
+    
+    if (timeout > 0 && idle >= timeout) {
+        m_metrics.Add(MetricCounter::IdleTimeouts);
+        CloseConnection(m_reactors[conn->reactor_index].get(), conn);
+        return;
+    }
+    
+    // 期间收到过数据，顺延到距最近活动满timeout时再检查
+    if (timeout > 0) {
+        ScheduleIdleCheck(conn, timeout - idle);
+    }
+}
+
+EpollServer::Reactor* EpollServer::SelectTimerReactor() {
+    if (!m_running || m_reactors.empty()) {
+        return nullptr;
+    }
+    
+    size_t index = m_next_timer_reactor.fetch_add(1, std::memory_order_relaxed) % m_reactors.size();
+    return m_reactors[index].get();
+}
+
+/**
+ * @brief delay_ms毫秒后执行一次callback。
+ *
+ * 定时器轮流分配给各reactor，回调在该reactor的事件循环线程中执行，
+ * 不能长时间阻塞。可以在任意线程中调用，服务器未启动或定时器数量达到上限时返回0。
+ */
+TimerId EpollServer::RunAfter(int64_t delay_ms, std::function<void()> callback) {
+    Reactor* reactor = SelectTimerReactor();
+    if (!reactor) {
+        return 0;
+    }
+    
+    TimerId id = reactor->timers.RunAfter(delay_ms, std::move(callback));
+    return id ? id | (static_cast<uint64_t>(reactor->index + 1) << TIMER_REACTOR_SHIFT) : 0;
+}
+
+TimerId EpollServer::RunEvery(int64_t interval_ms, std::function<void()> callback) {
+    Reactor* reactor = SelectTimerReactor();
+    if (!reactor) {
+        return 0;
+    }
+    
+    TimerId id = reactor->timers.RunEvery(interval_ms, std::move(callback));
+    return id ? id | (static_cast<uint64_t>(reactor->index + 1) << TIMER_REACTOR_SHIFT) : 0;
+}
+
+bool EpollServer::CancelTimer(TimerId id) {
+    size_t index = static_cast<size_t>(id >> TIMER_REACTOR_SHIFT);
+    if (!m_running || index == 0 || index > m_reactors.size()) {
+        return false;
+    }
+    
+    TimerId local = id & ((static_cast<uint64_t>(1) << TIMER_REACTOR_SHIFT) - 1);
+    return m_reactors[index - 1]->timers.Cancel(local);
+}
+
+/**
+ * @brief 获取服务器指标快照。
+ *
+ * 汇总各线程分片中的计数器和直方图，再补充当前连接数、各reactor的连接数、
+ * 处理线程池的排队消息数和缓冲区池缓存的字节数等瞬时值。
+ * 只在汇总时加锁，不影响IO线程。
+ */
+MetricsSnapshot EpollServer::GetMetrics() const {
+    MetricsSnapshot snapshot = m_metrics.Snapshot();
+    
+    uint64_t opened = snapshot.Get(MetricCounter::ConnectionsOpened);
+    uint64_t closed = snapshot.Get(MetricCounter::ConnectionsClosed);
+    snapshot.gauges.push_back(std::make_pair(std::string("connections_active"), opened > closed ? opened - closed : 0));
+    
+    if (m_running) {
+        for (const auto& reactor : m_reactors) {
+            snapshot.gauges.push_back(std::make_pair(
+                "reactor_connections{reactor=\"" + std::to_string(reactor->index) + "\"}",
+                static_cast<uint64_t>(reactor->conn_count.load(std::memory_order_relaxed))));
+        }
+    }
+    
+    snapshot.gauges.push_back(std::make_pair(std::string("handler_queue_depth"),
+        static_cast<uint64_t>(m_handler_pending.load(std::memory_order_relaxed))));
+    snapshot.gauges.push_back(std::make_pair(std::string("buffer_pool_retained_bytes"),
+        static_cast<uint64_t>(BufferPool::Instance().GetRetainedBytes())));
+    
+    return snapshot;
+}
+
+/**
+ * @brief 启用统计端点。
+ *
+ * 客户端发送一条type类型的TLV消息（内容忽略），服务器回复一条同类型的消息，
+ * 内容为GetMetrics()的Prometheus文本格式。查询消息不交给消息回调，
+ * 因此type应选用业务不使用的类型，默认为保留的METRICS_TLV_TYPE。
+ */
+void EpollServer::EnableStatsEndpoint(uint16_t type) {
+    m_stats_type.store(type, std::memory_order_relaxed);
+}
+
+/**
+ * @brief 启用压缩。
+ *
+ * 压缩消息的头部带压缩标志（格式见TLVFormat），内容为4字节原始长度加LZCodec压缩数据。
+ * 客户端发送一条handshake_type类型、内容为COMPRESSION_CODEC_LZ的消息后，服务器回复
+ * 同类型的消息：1字节编号（不支持时为0）+ 4字节大端的阈值，之后对该连接用SendFrame
+ * 发送的消息，内容不短于threshold字节时压缩（压缩后不变小的按原样发送）。
+ * 收到的压缩消息在所有消息回调之前透明解压，无法解压的连接被关闭；
+ * 未启用时收到压缩消息同样关闭连接。threshold为0时按1处理。需在Start之前调用。
+ */
+void EpollServer::EnableCompression(size_t threshold, uint16_t handshake_type) {
+    m_compress_threshold.store(threshold > 0 ? threshold : 1, std::memory_order_relaxed);
+    m_handshake_type.store(handshake_type, std::memory_order_relaxed);
+}
+
+void EpollServer::ReplyHandshake(Reactor* reactor, Connection* conn, const TLVView& view) {
+    bool accept = view.length >= 1 && static_cast<uint8_t>(view.value[0]) == COMPRESSION_CODEC_LZ;
+    conn->compress_output.store(accept, std::memory_order_relaxed);
+    
+    uint32_t threshold = static_cast<uint32_t>(m_compress_threshold.load(std::memory_order_relaxed));
+    char reply[5];
+    reply[0] = accept ? COMPRESSION_CODEC_LZ : 0;
+    reply[1] = static_cast<char>(threshold >> 24);
+    reply[2] = static_cast<char>(threshold >> 16);
+    reply[3] = static_cast<char>(threshold >> 8);
+    reply[4] = static_cast<char>(threshold);
+    
+    std::vector<char> frame;
+    reactor->Protocol(conn->frame_format.load(std::memory_order_relaxed)).SerializeFrame(view.type, reply, sizeof(reply), frame);
+    SendMessage(conn->fd, frame.data(), frame.size());
+}
+
+/**
+ * @brief 启用帧格式协商。
+ *
+ * 连接开始时总是v1格式。客户端发送一条handshake_type类型、内容为1字节格式编号
+ * （TLVFormat，1或2）的消息，服务器用当前格式回复同类型的消息，内容为接受的格式编号
+ * （不认识的编号按v1回复），之后双方在该连接上都使用这个格式。握手之后紧接着的数据
+ * 即按新格式解析；客户端应在没有在途请求时握手，收到回复后再按新格式解析响应。
+ */
+void EpollServer::EnableFormatNegotiation(uint16_t handshake_type) {
+    m_format_type.store(handshake_type, std::memory_order_relaxed);
+}
+
+TLVFormat EpollServer::GetFrameFormat(int client_fd) const {
+    std::shared_ptr<Connection> conn = m_connections.Get(client_fd);
+    return conn ? conn->frame_format.load(std::memory_order_relaxed) : TLVFormat::V1;
+}
+
+bool EpollServer::ReplyFormat(Reactor* reactor, Connection* conn, const TLVView& view) {
+    TLVFormat current = conn->frame_format.load(std::memory_order_relaxed);
+    TLVFormat format = TLVFormat::V1;
+    if (view.length >= 1 && static_cast<uint8_t>(view.value[0]) == static_cast<uint8_t>(TLVFormat::V2)) {
+        format = TLVFormat::V2;
+    }
+    
+    char reply = static_cast<char>(format);
+    std::vector<char> frame;
+    reactor->Protocol(current).SerializeFrame(view.type, &reply, 1, frame);
+    SendMessage(conn->fd, frame.data(), frame.size());
+    
+    conn->frame_format.store(format, std::memory_order_relaxed);
+    return format != current;
+}
+
+/**
+ * @brief 解压一条压缩消息。
+ *
+ * 解压到reactor复用的缓冲区，view只在处理下一条压缩消息之前有效（回调期间足够）。
+ * 未启用压缩时视为协议错误。
+ */
+bool EpollServer::InflateMessage(Reactor* reactor, TLVView& view) {
+    if (m_compress_threshold.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    
+    int64_t start = NowNs();
+    TLVView plain;
+    if (!reactor->protocol.Decompress(view, reactor->inflate_buffer, plain)) {
+        return false;
+    }
+    
+    MetricsShard* metrics = m_metrics.Local();
+    metrics->Add(MetricCounter::DecompressIn, view.length);
+    metrics->Add(MetricCounter::DecompressOut, plain.length);
+    metrics->Add(MetricCounter::DecompressNs, static_cast<uint64_t>(NowNs() - start));
+    view = plain;
+    return true;
+}
+
+/**
+ * @brief 回复统计端点的查询。
+ *
+ * 汇总各分片并格式化文本要加注册表的锁、遍历所有线程的分片，启用了处理线程池时
+ * 交给线程池完成，IO线程只在数据就绪后发送（回复可能排在该连接之后消息的响应后面）；
+ * 没有线程池时在当前线程中完成。
+ */
+void EpollServer::ReplyStats(Reactor* reactor, Connection* conn, uint16_t type) {
+    int fd = conn->fd;
+    
+    if (m_handler_pool.IsRunning()) {
+        std::shared_ptr<Connection> ref = conn->shared_from_this();
+        m_handler_pool.Submit([this, ref, fd, type]() {
+            if (ref->IsClosed()) {
+                return;
+            }
+            std::string text = GetMetrics().ToText();
+            SendFrame(fd, type, text.data(), text.size());
+        });
+        return;
+    }
+    
+    std::string text = GetMetrics().ToText();
+    TLVMessage msg(type, text.data(), static_cast<uint32_t>(text.size()));
+    
+    std::vector<char> frame;
+    reactor->Protocol(conn->frame_format.load(std::memory_order_relaxed)).SerializeMessage(msg, frame);
+    SendMessage(fd, frame.data(), frame.size());
+}
+
+/**
+ * @brief 启用消息生命周期追踪。
+ *
+ * 每条消息在读到数据、解析完成、回调开始/返回、回包交给发送接口和写入套接字时
+ * 各记录一次时间戳（x86上为rdtsc），写入所在线程自己的环形缓冲区，满了覆盖最旧的记录。
+ * 可以在运行期间随时启用或停止。
+ */
+void EpollServer::EnableTracing(size_t records_per_thread) {
+    m_tracer.Enable(records_per_thread);
+}
+
+void EpollServer::DisableTracing() {
+    m_tracer.Disable();
+}
+
+/**
+ * @brief 导出追踪记录。
+ *
+ * 可以在任意线程调用，不暂停IO线程。文件用tools/trace_decode查看最慢的消息
+ * 在各阶段的耗时。
+ */
+int64_t EpollServer::DumpTrace(const char* path) const {
+    return m_tracer.Dump(path);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 // 系统头文件
 #include <sys/epoll.h>      // epoll相关函数
+#include <sys/eventfd.h>    // eventfd唤醒
 #include <sys/socket.h>     // socket相关函数
 #include <netinet/in.h>     // 网络地址结构体
 #include <arpa/inet.h>      // IP地址转换函数
@@ -12,86 +13,402 @@
 #include <string.h>         // 字符串处理函数
 #include <stdlib.h>         // 标准库函数
 #include <stdio.h>          // 标准输入输出
+#include <limits.h>         // IOV_MAX
+#include <sys/uio.h>        // iovec
+#include <sys/sendfile.h>   // sendfile
+#include <sys/stat.h>       // fstat
+#include <signal.h>         // 屏蔽SIGPIPE
 
 // C++标准库
 #include <vector>           // 动态数组容器
-#include <map>             // 映射容器
 #include <thread>          // 线程支持
 #include <mutex>           // 互斥量
 #include <atomic>          // 原子操作
 #include <functional>      // 函数对象
+#include <memory>          // 智能指针
+#include <string>          // 字符串
 
 // 自定义头文件
 #include "message_queue.h"  // 消息队列
 #include "tlv_protocol.h"   // TLV协议
+#include "recv_buffer.h"    // 接收缓冲区
+#include "connection.h"     // 连接状态
+#include "handler_pool.h"   // 消息处理线程池
+#include "timer_wheel.h"    // 定时器
+#include "poller.h"         // IO多路复用后端
+#include "metrics.h"        // 指标统计
+#include "trace.h"          // 消息生命周期追踪
+#include "message_dispatcher.h"  // 按类型分发消息
 
 #define MAX_EVENTS 1024
-#define BUFFER_SIZE 4096
+#define BUFFER_SIZE 4096            // 每次读取的初始/最小预留字节数
+#define MAX_READ_SIZE (256 * 1024)  // 每次读取的最大预留字节数
+#define READ_SPARE_SIZE (64 * 1024) // readv的栈上备用区大小
+#define READ_SHRINK_AFTER 8         // 连续多少次小读取后缩小预留
+#define ACCEPT_BATCH 64
+#define HANDLER_BATCH 64
+#define MESSAGE_BATCH_SIZE 256      // 批量消息回调每批的默认最大消息数
+#define SCAN_BATCH 64               // 每次批量扫描的最多消息数
+#define SENDFILE_CHUNK (1024 * 1024) // 每次sendfile最多发送的字节数
+
+// 压缩协商
+#define COMPRESSION_TLV_TYPE 0xFFFE     // 压缩握手的保留TLV类型
+#define COMPRESSION_THRESHOLD 1024      // 默认压缩阈值（消息内容字节数）
+#define COMPRESSION_CODEC_LZ 1          // 握手中表示内置LZ压缩的编号
+
+// 帧格式协商
+#define FRAME_FORMAT_TLV_TYPE 0xFFFD    // 帧格式握手的保留TLV类型
+#define TIMER_TICK_MS 10
+
+// 新连接的接收方式
+enum class AcceptMode {
+    ReusePort,   // 每个reactor各自监听（SO_REUSEPORT），由内核分发连接
+    Acceptor     // 独立的acceptor线程批量accept，再分发给各reactor
+};
+
+// 发送结果
+// 数据已入队时返回非0值，兼容原来按bool判断的调用方式
+enum SendStatus {
+    SEND_FAILED = 0,      // 连接不存在或已关闭，数据未发送
+    SEND_OK = 1,          // 已发送或已入队
+    SEND_HIGH_WATER = 2   // 已入队，但发送队列超过高水位，应暂停生产直到OnWritable回调
+};
+
+// acceptor模式下新连接分配给reactor的策略
+enum class BalancePolicy {
+    RoundRobin,       // 轮询
+    LeastConnections  // 当前连接数最少的reactor
+};
 
 class EpollServer {
 public:
-    EpollServer(const char* ip, int port, int max_conn = 1024);
+    // poller为IO多路复用后端，io_uring不可用时回退到epoll
+    EpollServer(const char* ip, int port, int max_conn = 1024, PollerType poller = PollerType::Epoll);
     ~EpollServer();
-
+    
     // 启动服务器
     bool Start();
     // 停止服务器
     void Stop();
     // 异步发送数据
-    bool SendMessage(int client_fd, const char* data, size_t len);
+    SendStatus SendMessage(int client_fd, const char* data, size_t len);
+    // 发送一条TLV消息，对端已通过握手启用压缩时按阈值压缩内容
+    SendStatus SendFrame(int client_fd, uint16_t type, const char* value, size_t len);
+    // 发送一条TLV消息，内容为文件file_fd中[offset, offset + len)的部分，用sendfile从页缓存直接发送。
+    // 与其他发送接口共用发送队列，按投递顺序发出；file_fd由服务器复制一份，调用后即可关闭
+    SendStatus SendFile(int client_fd, int file_fd, off_t offset, size_t len, uint16_t tlv_type);
+    // 异步发送共享缓冲区（不复制数据）
+    SendStatus SendShared(int client_fd, const SharedBuffer& buffer);
+    // 向多个连接广播同一份数据（只复制一次），返回成功投递的连接数
+    size_t Broadcast(const std::vector<int>& fds, const char* data, size_t len);
+    // 向多个连接广播共享缓冲区，返回成功投递的连接数
+    size_t Broadcast(const std::vector<int>& fds, const SharedBuffer& buffer);
+    // 获取连接的统计信息，连接不存在时返回false
+    bool GetConnectionStats(int client_fd, ConnectionStats& stats) const;
     // 设置连接回调
     void SetOnConnectCallback(std::function<void(int)> callback);
     // 设置断开连接回调
     void SetOnDisconnectCallback(std::function<void(int)> callback);
-    // 设置消息回调
+    // 设置消息回调（每条消息复制一份TLVMessage）
     void SetOnMessageCallback(std::function<void(int, const TLVMessage&)> callback);
+    // 设置零拷贝消息回调（TLVView指向接收缓冲区，只在回调期间有效）
+    void SetOnMessageViewCallback(std::function<void(int, const TLVView&)> callback);
+    // 设置批量消息回调（一次读完套接字时解析出的消息合并为一次调用，TLVView只在回调期间有效）
+    void SetOnMessageBatchCallback(std::function<void(int, const TLVView*, size_t)> callback);
+    // 设置批量消息回调每批的最大消息数和最长延迟（毫秒，0表示每次读完即交付）
+    void SetMessageBatchLimits(size_t max_messages, int64_t max_delay_ms);
+    // 注册type类型消息的处理函数（需在Start之前调用）
+    bool RegisterHandler(uint16_t type, MessageHandler handler);
+    // 注册编译期绑定的处理函数，不经过std::function（需在Start之前调用）
+    template <void (*Handler)(int, const TLVView&)>
+    bool RegisterHandler(uint16_t type) {
+        if (m_running) {
+            return false;
+        }
+        m_dispatcher.Register<Handler>(type);
+        return true;
+    }
+    // 注册编译期绑定的成员函数，object需在服务器运行期间保持有效（需在Start之前调用）
+    template <class T, void (T::*Method)(int, const TLVView&)>
+    bool RegisterHandler(uint16_t type, T* object) {
+        if (m_running) {
+            return false;
+        }
+        m_dispatcher.Register<T, Method>(type, object);
+        return true;
+    }
+    // 取消type类型的处理函数（需在Start之前调用）
+    bool UnregisterHandler(uint16_t type);
+    // 设置没有注册处理函数的消息类型的默认处理函数（需在Start之前调用）
+    bool SetDefaultHandler(MessageHandler handler);
+    // 设置可写回调（发送队列从高水位回落到低水位以下时调用）
+    void SetOnWritableCallback(std::function<void(int)> callback);
+    // 设置发送队列高/低水位（字节，high为0表示不限制）
+    void SetWriteWatermarks(size_t high, size_t low);
+    // 设置reactor线程数量（需在Start之前调用，0表示使用CPU核数）
+    void SetReactorCount(int count);
+    // 获取reactor线程数量
+    int GetReactorCount() const;
+    // 设置新连接接收方式（需在Start之前调用）
+    void SetAcceptMode(AcceptMode mode);
+    // 获取实际使用的IO多路复用后端名称
+    const char* GetPollerName() const;
+    // 设置acceptor模式下的连接分配策略（需在Start之前调用）
+    void SetBalancePolicy(BalancePolicy policy);
+    // 获取最近一秒接受的连接数
+    uint64_t GetAcceptedPerSecond() const;
+    // 获取累计接受的连接数
+    uint64_t GetTotalAccepted() const;
+    // 设置消息处理线程数（需在Start之前调用，0表示在IO线程中直接调用消息回调）
+    void SetHandlerThreads(size_t threads);
+    // 获取消息处理线程池的统计信息
+    HandlerStats GetHandlerStats() const;
+    // delay_ms毫秒后在某个reactor线程中执行一次callback（需在Start之后调用）
+    TimerId RunAfter(int64_t delay_ms, std::function<void()> callback);
+    // 每隔interval_ms毫秒在某个reactor线程中执行一次callback（需在Start之后调用）
+    TimerId RunEvery(int64_t interval_ms, std::function<void()> callback);
+    // 取消定时器
+    bool CancelTimer(TimerId id);
+    // 设置连接空闲超时，超过timeout_ms没有收到数据的连接会被关闭（0表示不限制）
+    void SetIdleTimeout(int64_t timeout_ms);
+    // 获取服务器指标快照（各线程的计数汇总，加上连接数等瞬时值）
+    MetricsSnapshot GetMetrics() const;
+    // 启用统计端点：收到type类型的TLV消息时回复文本格式的指标，该消息不交给消息回调
+    void EnableStatsEndpoint(uint16_t type = METRICS_TLV_TYPE);
+    // 启用压缩：收到的压缩消息在回调前解压；对端发送handshake_type握手后，不短于threshold字节的消息压缩发送（需在Start之前调用）
+    void EnableCompression(size_t threshold = COMPRESSION_THRESHOLD, uint16_t handshake_type = COMPRESSION_TLV_TYPE);
+    // 启用帧格式协商：对端发送handshake_type握手后，该连接改用协商的格式（v1或紧凑的v2）
+    void EnableFormatNegotiation(uint16_t handshake_type = FRAME_FORMAT_TLV_TYPE);
+    // 获取连接当前的帧格式（自行序列化消息再SendMessage时使用）
+    TLVFormat GetFrameFormat(int client_fd) const;
+    // 启用消息生命周期追踪，每个线程保留最近records_per_thread条记录
+    void EnableTracing(size_t records_per_thread = TRACE_DEFAULT_RECORDS);
+    // 停止追踪（已有记录保留）
+    void DisableTracing();
+    // 把追踪记录写入二进制文件，返回记录数，失败返回-1
+    int64_t DumpTrace(const char* path) const;
 
 private:
+    // acceptor交给reactor的新连接
+    struct PendingConnection {
+        int fd;
+        struct sockaddr_in addr;
+    };
+    
+    // 单个reactor：独立的IO多路复用实例、监听套接字(SO_REUSEPORT)和连接状态
+    struct Reactor {
+        int index;                   // reactor编号
+        std::unique_ptr<Poller> poller;  // IO多路复用后端
+        bool async_io;               // 后端是否提供异步accept/recv/send（io_uring）
+        int listen_fd;               // 监听套接字（acceptor模式下为-1）
+        int wakeup_fd;               // eventfd，用于跨线程唤醒
+        std::thread thread;          // 事件循环线程
+        std::atomic<std::thread::id> thread_id;  // 事件循环线程ID
+        std::atomic<int> conn_count; // 当前连接数
+        
+        std::vector<PendingConnection> pending_conns;  // 待注册的新连接
+        std::vector<std::shared_ptr<Connection>> pending_writes;  // 其他线程投递了数据、等待发送的连接
+        std::mutex pending_mutex;    // 待处理队列互斥锁
+        
+        // 本轮事件处理中关闭的连接，延迟到本轮结束再释放，
+        // 保证同一轮后续事件中拿到的连接指针仍然有效
+        std::vector<std::shared_ptr<Connection>> closed_conns;
+        
+        // 本轮事件处理中有新数据入队的连接，本轮结束时统一发送（io_uring后端的回包、SendFile）
+        std::vector<std::shared_ptr<Connection>> flush_conns;
+        
+        std::vector<TLVView> batch_views;  // 交付批量消息时复用的视图数组
+        std::vector<char> inflate_buffer;  // 解压消息时复用的缓冲区
+        
+        TLVView scan_views[SCAN_BATCH];    // 批量扫描消息边界时复用的视图数组
+        
+        TLVProtocol protocol;        // TLV协议处理器（v1）
+        TLVProtocol protocol_v2;     // v2格式的TLV协议处理器
+        TimerWheel timers;           // 定时器（由timerfd驱动）
+        
+        Reactor()
+            : index(0), async_io(false), listen_fd(-1), wakeup_fd(-1),
+              thread_id(std::thread::id()), conn_count(0) {
+            protocol_v2.SetFormat(TLVFormat::V2);
+        }
+        
+        // 按连接的帧格式选择协议处理器
+        TLVProtocol& Protocol(TLVFormat format) {
+            return format == TLVFormat::V2 ? protocol_v2 : protocol;
+        }
+    };
+    
     // 初始化服务器
     bool Init();
+    // 初始化单个reactor
+    bool InitReactor(Reactor* reactor);
+    // 创建监听套接字
+    int CreateListenSocket();
     // 设置非阻塞
     bool SetNonBlocking(int fd);
-    // 添加到epoll
-    bool AddToEpoll(int fd, uint32_t events);
-    // 修改epoll事件
-    bool ModifyEpoll(int fd, uint32_t events);
-    // 从epoll移除
-    bool RemoveFromEpoll(int fd);
-    // 接受新连接
-    void AcceptConnection();
-    // 处理读事件
-    void HandleRead(int fd);
+    // 注册fd的就绪通知
+    bool AddToPoller(Reactor* reactor, int fd, uint32_t events);
+    // 修改fd关注的事件
+    bool ModifyPoller(Reactor* reactor, int fd, uint32_t events);
+    // 取消fd的就绪通知
+    bool RemoveFromPoller(Reactor* reactor, int fd);
+    // 初始化acceptor
+    bool InitAcceptor();
+    // 接受新连接（SO_REUSEPORT模式）
+    void AcceptConnection(Reactor* reactor);
+    // 批量接受新连接并分发给reactor（acceptor模式）
+    void AcceptBatch();
+    // 按分配策略选择reactor
+    Reactor* SelectReactor();
+    // 唤醒reactor
+    void WakeupReactor(Reactor* reactor);
+    // 处理reactor的唤醒事件
+    void HandleWakeup(Reactor* reactor);
+    // 在reactor中注册新连接
+    void RegisterConnection(Reactor* reactor, int client_fd, const struct sockaddr_in& client_addr);
+    // 统计每秒接受的连接数
+    void UpdateAcceptRate();
+    // 处理读事件，peer_closed表示对端已关闭写方向（EPOLLRDHUP），需要读到EOF
+    void HandleRead(Reactor* reactor, Connection* conn, bool peer_closed);
+    // 根据本次读到的字节数调整连接的读取预留大小
+    void AdjustReadSize(Connection* conn, size_t n);
+    // 解析data中完整的TLV消息并调用消息回调，返回已解析的字节数
+    size_t ParseMessages(Reactor* reactor, Connection* conn, const char* data, size_t len);
+    // 计算解析后可以从接收缓冲区移除的字节数，有待交付的批量消息时全部保留
+    size_t ReleaseParsed(Connection* conn, size_t parsed);
+    // 一次读取结束：不允许延迟时立即交付批量消息
+    void FinishBatch(Reactor* reactor, Connection* conn);
+    // 交付连接待交付的批量消息（不移除接收缓冲区中的数据）
+    void FlushBatch(Reactor* reactor, Connection* conn);
+    // 延迟交付到期：交付批量消息并移除对应数据
+    void ExpireBatch(Reactor* reactor, Connection* conn);
+    // 处理io_uring后端的接受、接收和发送完成事件
+    void HandleAccepted(Reactor* reactor, const PollEvent& event);
+    void HandleReceived(Reactor* reactor, const PollEvent& event);
+    void HandleSent(Reactor* reactor, const PollEvent& event);
+    // 在io_uring后端上开始接收连接的数据
+    void StartRecv(Reactor* reactor, Connection* conn);
     // 处理写事件
-    void HandleWrite(int fd);
+    void HandleWrite(Reactor* reactor, Connection* conn);
+    // 发送队首文件段的结果
+    enum FileWriteResult {
+        FILE_WRITE_DONE,      // 队首已不是文件段
+        FILE_WRITE_BLOCKED,   // 套接字发送缓冲区已满
+        FILE_WRITE_FAILED     // 发送出错，连接已关闭
+    };
+    // 用sendfile发送队首的文件段
+    FileWriteResult WriteFile(Reactor* reactor, Connection* conn);
+    // io_uring后端：注册/取消可写通知，用于套接字写满后继续sendfile
+    bool WaitFileWritable(Reactor* reactor, Connection* conn, bool enable);
+    // 发送数据，shared非空时data指向shared的内容
+    SendStatus SendData(int client_fd, const char* data, size_t len, const SharedBuffer& shared);
+    // 将数据加入连接的发送队列
+    bool EnqueueData(Connection* conn, const char* data, size_t len, const SharedBuffer& shared);
+    // 发送队列由空变为非空时记录时间，用于统计入队到写出的延迟
+    void MarkQueued(Connection* conn);
+    // 发送队列写空时记录入队到写出的延迟
+    void RecordWriteLatency(Connection* conn);
+    // 回复压缩握手
+    void ReplyHandshake(Reactor* reactor, Connection* conn, const TLVView& view);
+    // 回复帧格式握手，之后该连接改用协商的格式，返回格式是否改变
+    bool ReplyFormat(Reactor* reactor, Connection* conn, const TLVView& view);
+    // 解压压缩消息，view改为指向解压后的内容，数据损坏时返回false
+    bool InflateMessage(Reactor* reactor, TLVView& view);
+    // 回复统计端点的查询
+    void ReplyStats(Reactor* reactor, Connection* conn, uint16_t type);
+    // 在事件循环线程中直接写入空闲连接
+    bool WriteInline(Reactor* reactor, Connection* conn, const char* data, size_t len, const SharedBuffer& shared);
+    // 通知reactor有连接需要发送数据
+    void ScheduleWrite(Reactor* reactor, const std::shared_ptr<Connection>& conn);
+    // 把连接加入本轮结束时批量发送的列表（io_uring后端的回包、事件循环线程中的SendFile）
+    void ScheduleFlush(Reactor* reactor, Connection* conn);
+    // 为本轮有新数据的连接发送或提交发送请求
+    void FlushWrites(Reactor* reactor);
+    // 注册/取消EPOLLOUT
+    void EnableWriting(Reactor* reactor, Connection* conn, bool enable);
+    // 按读写状态更新连接在epoll中的事件
+    void UpdateEvents(Reactor* reactor, Connection* conn);
+    // 检查发送队列是否超过高水位
+    SendStatus CheckHighWater(Connection* conn);
+    // 根据发送队列水位暂停或恢复读取，在事件循环线程中调用
+    void UpdateWatermark(Reactor* reactor, Connection* conn);
     // 关闭连接
-    void CloseConnection(int fd);
+    void CloseConnection(Reactor* reactor, Connection* conn);
+    // 按类型分发消息并统计
+    void RouteMessage(MetricsShard* metrics, int fd, const TLVView& view);
+    // 把消息交给处理线程池
+    void DispatchMessage(Connection* conn, const TLVView& view, uint64_t seq);
+    // 在处理线程中按顺序处理一个连接的消息
+    void RunHandlers(const std::shared_ptr<Connection>& conn);
+    // 为连接设置空闲超时检查
+    void ScheduleIdleCheck(Connection* conn, int64_t delay_ms);
+    // 空闲超时检查，在连接所属的reactor线程中执行
+    void CheckIdle(Connection* conn);
+    // 选择执行定时器的reactor
+    Reactor* SelectTimerReactor();
+    // 释放所有reactor资源
+    void DestroyReactors();
     // Epoll循环
-    void EpollLoop();
-    // 发送线程函数
-    void SendThread();
+    void EpollLoop(Reactor* reactor);
+    // acceptor循环
+    void AcceptorLoop();
 
 private:
     std::string m_ip;                // 服务器IP
     int m_port;                      // 服务器端口
-    int m_listen_fd;                 // 监听套接字
-    int m_epoll_fd;                  // epoll文件描述符
     int m_max_connections;           // 最大连接数
+    int m_reactor_count;             // reactor数量
+    AcceptMode m_accept_mode;        // 新连接接收方式
+    BalancePolicy m_balance_policy;  // 连接分配策略
+    PollerType m_poller_type;        // IO多路复用后端
     std::atomic<bool> m_running;     // 运行标志
     
-    std::thread m_epoll_thread;      // epoll线程
-    std::thread m_send_thread;       // 发送线程
+    std::vector<std::unique_ptr<Reactor>> m_reactors;  // 所有reactor
+    
+    int m_acceptor_listen_fd;        // acceptor监听套接字
+    std::unique_ptr<Poller> m_acceptor_poller;  // acceptor的就绪通知
+    std::thread m_acceptor_thread;   // acceptor线程
+    size_t m_next_reactor;           // 轮询分配的下一个reactor
+    
+    std::atomic<uint64_t> m_total_accepted;   // 累计接受的连接数
+    std::atomic<uint64_t> m_accept_rate;      // 最近一秒接受的连接数
+    int64_t m_rate_window_start;              // 统计窗口起始时间（毫秒）
+    uint64_t m_rate_window_base;              // 统计窗口起始时的累计值
+    
+    ConnectionTable m_connections;   // 按fd索引的连接表
     
-    std::map<int, std::vector<char>> m_recv_buffers;  // 接收缓冲区
-    std::mutex m_recv_mutex;         // 接收缓冲区互斥锁
+    size_t m_handler_threads;        // 消息处理线程数（0表示不使用线程池）
+    HandlerPool m_handler_pool;      // 消息处理线程池
+    std::atomic<size_t> m_handler_pending;    // 等待处理的消息数
+    std::atomic<uint64_t> m_handler_handled;  // 已处理的消息数
+    std::atomic<uint64_t> m_handler_wait_us;  // 累计等待时间
+    std::atomic<uint64_t> m_handler_run_us;   // 累计回调执行时间
+    std::atomic<uint64_t> m_handler_max_us;   // 最长回调执行时间
     
-    MessageQueue m_send_queue;       // 发送队列
+    std::atomic<int64_t> m_idle_timeout_ms;   // 连接空闲超时（0表示不限制）
+    std::atomic<size_t> m_high_water_mark;    // 发送队列高水位（0表示不限制）
+    std::atomic<size_t> m_low_water_mark;     // 发送队列低水位
+    std::atomic<size_t> m_next_timer_reactor; // 轮询分配定时器的reactor
+    std::atomic<size_t> m_batch_max_messages;   // 批量消息回调每批的最大消息数
+    std::atomic<int64_t> m_batch_max_delay_ms;  // 批量消息回调的最长延迟（0表示每次读完即交付）
     
-    TLVProtocol m_protocol;          // TLV协议处理器
+    MetricsRegistry m_metrics;       // 指标（按线程分片）
+    std::atomic<int> m_stats_type;   // 统计端点的TLV类型（-1表示未启用）
+    std::atomic<size_t> m_compress_threshold; // 压缩阈值（0表示未启用压缩）
+    std::atomic<int> m_handshake_type;        // 压缩握手的TLV类型（-1表示未启用）
+    std::atomic<int> m_format_type;           // 帧格式握手的TLV类型（-1表示未启用）
+    Tracer m_tracer;                 // 消息生命周期追踪
+    std::atomic<uint32_t> m_next_trace_id;    // 分配给新连接的追踪ID
+    std::atomic<uint32_t> m_next_tag;         // 分配给新连接的io_uring请求标记（所有reactor共用）
     
     // 回调函数
     std::function<void(int)> m_on_connect;
     std::function<void(int)> m_on_disconnect;
     std::function<void(int, const TLVMessage&)> m_on_message;
+    std::function<void(int, const TLVView&)> m_on_message_view;
+    std::function<void(int, const TLVView*, size_t)> m_on_message_batch;
+    std::function<void(int)> m_on_writable;
+    MessageDispatcher m_dispatcher;  // 按类型注册的处理函数
 };
 
 #endif // EPOLL_SERVER_H
\ No newline at end of file
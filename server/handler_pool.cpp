@@ -0,0 +1,177 @@
+#include "handler_pool.h"
+
+// 当前线程所属的线程池及其工作线程编号
+static thread_local HandlerPool* t_pool = nullptr;
+static thread_local size_t t_worker_index = 0;
+
+HandlerPool::HandlerPool()
+    : m_running(false), m_next_worker(0), m_pending(0), m_stolen(0), m_sleeping(0) {
+}
+
+HandlerPool::~HandlerPool() {
+    Stop();
+}
+
+bool HandlerPool::Start(size_t threads) {
+    if (m_running || threads == 0) {
+        return false;
+    }
+    
+    m_running = true;
+    
+    for (size_t i = 0; i < threads; i++) {
+        m_workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    
+    // 所有队列创建好之后再启动线程，窃取时可以安全遍历m_workers
+    for (size_t i = 0; i < threads; i++) {
+        m_workers[i]->thread = std::thread(&HandlerPool::WorkerLoop, this, i);
+    }
+    
+    return true;
+}
+
+void HandlerPool::Stop() {
+    if (!m_running) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_idle_mutex);
+        m_running = false;
+    }
+    m_idle_cv.notify_all();
+    
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    
+    m_workers.clear();
+}
+
+/**
+ * @brief 提交任务。
+ *
+ * 工作线程内提交的任务放入自己的本地队列（通常是同一连接的后续消息，缓存更热），
+ * 其他线程提交的任务轮询分配到各线程的注入队列。有线程休眠时唤醒一个。
+ */
+void HandlerPool::Submit(Task task) {
+    if (m_workers.empty()) {
+        return;
+    }
+    
+    bool local = t_pool == this;
+    size_t index;
+    if (local) {
+        index = t_worker_index;
+    } else {
+        index = m_next_worker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+    }
+    
+    // 先增加任务数再检查休眠线程；休眠前会在锁内检查任务数，两边不会错过对方
+    m_pending.fetch_add(1);
+    
+    {
+        Worker* worker = m_workers[index].get();
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        if (local) {
+            worker->tasks.push_back(std::move(task));
+        } else {
+            worker->inject.push_back(std::move(task));
+        }
+    }
+    
+    if (m_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_idle_mutex);
+        m_idle_cv.notify_one();
+    }
+}
+
+bool HandlerPool::IsRunning() const {
+    return m_running;
+}
+
+size_t HandlerPool::GetThreadCount() const {
+    return m_workers.size();
+}
+
+uint64_t HandlerPool::GetStolenCount() const {
+    return m_stolen.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief 从自己的队列取任务。
+ *
+ * 本地任务后进先出，缓存最热；但处理线程会为繁忙连接反复提交后续任务，只取本地队列
+ * 会让注入队列里先到的连接一直等待。因此连续取HANDLER_LOCAL_BURST个本地任务后，
+ * 注入队列非空时先取它的头部，外部任务最多等待这么多个本地任务。
+ */
+bool HandlerPool::PopLocal(size_t index, Task& task) {
+    Worker* worker = m_workers[index].get();
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    bool take_inject = !worker->inject.empty() &&
+                       (worker->tasks.empty() || worker->local_streak >= HANDLER_LOCAL_BURST);
+    if (take_inject) {
+        task = std::move(worker->inject.front());
+        worker->inject.pop_front();
+        worker->local_streak = 0;
+        return true;
+    }
+    
+    if (worker->tasks.empty()) {
+        return false;
+    }
+    
+    task = std::move(worker->tasks.back());
+    worker->tasks.pop_back();
+    worker->local_streak++;
+    return true;
+}
+
+bool HandlerPool::Steal(size_t index, Task& task) {
+    size_t count = m_workers.size();
+    for (size_t i = 1; i < count; i++) {
+        Worker* victim = m_workers[(index + i) % count].get();
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        std::deque<Task>& queue = victim->inject.empty() ? victim->tasks : victim->inject;
+        if (!queue.empty()) {
+            task = std::move(queue.front());
+            queue.pop_front();
+            m_stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void HandlerPool::WorkerLoop(size_t index) {
+    t_pool = this;
+    t_worker_index = index;
+    
+    while (true) {
+        Task task;
+        if (PopLocal(index, task) || Steal(index, task)) {
+            m_pending.fetch_sub(1);
+            task();
+            continue;
+        }
+    
+        std::unique_lock<std::mutex> lock(m_idle_mutex);
+    
+        // 停止时把剩余任务执行完再退出
+        if (!m_running && m_pending.load() == 0) {
+            break;
+        }
+    
+        m_sleeping.fetch_add(1);
+        m_idle_cv.wait(lock, [this]() {
+            return m_pending.load() > 0 || !m_running;
+        });
+        m_sleeping.fetch_sub(1);
+    }
+    
+    t_pool = nullptr;
+}
@@ -0,0 +1,93 @@
+#ifndef HANDLER_POOL_H
+#define HANDLER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 连续执行本地任务的上限，之后先执行一个外部提交的任务
+#define HANDLER_LOCAL_BURST 4
+
+// 消息处理线程池的统计快照
+struct HandlerStats {
+    size_t threads;             // 处理线程数
+    size_t queue_depth;         // 等待处理的消息数
+    uint64_t handled;           // 已处理的消息数
+    uint64_t stolen;            // 被其他线程窃取执行的任务数
+    uint64_t avg_wait_us;       // 消息从读出到开始处理的平均等待时间
+    uint64_t avg_handler_us;    // 回调平均执行时间
+    uint64_t max_handler_us;    // 回调最长执行时间
+};
+
+// 工作窃取线程池，用于把消息回调移出IO线程
+//
+// 每个工作线程有两个队列：线程内提交的任务放到本地队列尾部并优先执行（后进先出），
+// 外部线程提交的任务轮询分配到各线程的注入队列，按先进先出执行。连续执行
+// HANDLER_LOCAL_BURST个本地任务后先取一个注入任务，外部任务不会被本地任务无限推迟。
+// 两个队列都为空时从其他线程窃取，先取注入队列头部（最早提交的任务）。
+// 线程池本身不保证任务顺序，同一连接的消息由调用方串行化后再提交。
+class HandlerPool {
+public:
+    typedef std::function<void()> Task;
+    
+    HandlerPool();
+    ~HandlerPool();
+    
+    // 启动threads个工作线程
+    bool Start(size_t threads);
+    
+    // 执行完已提交的任务后停止所有工作线程
+    void Stop();
+    
+    // 提交任务
+    void Submit(Task task);
+    
+    // 是否已启动
+    bool IsRunning() const;
+    
+    // 工作线程数
+    size_t GetThreadCount() const;
+    
+    // 被窃取执行的任务数
+    uint64_t GetStolenCount() const;
+
+private:
+    struct Worker {
+        std::deque<Task> tasks;     // 本线程提交的任务，从尾部取
+        std::deque<Task> inject;    // 外部线程提交的任务，从头部取
+        size_t local_streak;        // 连续执行的本地任务数（只由本线程访问）
+        std::mutex mutex;
+        std::thread thread;
+        
+        Worker() : local_streak(0) {}
+    };
+    
+    // 工作线程主循环
+    void WorkerLoop(size_t index);
+    
+    // 从自己的队列取任务：本地队列尾部优先，注入队列头部按HANDLER_LOCAL_BURST穿插
+    bool PopLocal(size_t index, Task& task);
+    
+    // 从其他线程队列头部窃取任务（注入队列优先）
+    bool Steal(size_t index, Task& task);
+    
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<bool> m_running;
+    std::atomic<size_t> m_next_worker;   // 外部提交的轮询位置
+    std::atomic<size_t> m_pending;       // 所有队列中的任务总数
+    std::atomic<uint64_t> m_stolen;
+    
+    // 空闲线程在这里休眠
+    std::mutex m_idle_mutex;
+    std::condition_variable m_idle_cv;
+    std::atomic<int> m_sleeping;
+};
+
+#endif // HANDLER_POOL_H
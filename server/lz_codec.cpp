@@ -0,0 +1,218 @@
+#include "lz_codec.h"
+#include <string.h>
+
+// 最短匹配长度
+static const size_t MIN_MATCH = 4;
+// 最后5个字节总是字面量，最后一个匹配至少在结尾前12字节开始（与LZ4块格式一致）
+static const size_t LAST_LITERALS = 5;
+static const size_t MATCH_LIMIT = 12;
+// 最大回溯距离
+static const size_t MAX_DISTANCE = 65535;
+// 哈希表大小（2^HASH_BITS项）
+static const int HASH_BITS = 12;
+
+static inline uint32_t Read32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t Hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// 写入长度的扩展字节，空间不足时返回nullptr
+static unsigned char* WriteLength(unsigned char* op, const unsigned char* op_end, size_t length) {
+    while (length >= 255) {
+        if (op >= op_end) {
+            return nullptr;
+        }
+        *op++ = 255;
+        length -= 255;
+    }
+    if (op >= op_end) {
+        return nullptr;
+    }
+    *op++ = static_cast<unsigned char>(length);
+    return op;
+}
+
+// 写入一个序列（match_len为0时只有字面量），空间不足时返回nullptr
+static unsigned char* WriteSequence(unsigned char* op, const unsigned char* op_end,
+                                    const unsigned char* literals, size_t literal_len,
+                                    size_t distance, size_t match_len) {
+    if (op >= op_end) {
+        return nullptr;
+    }
+    
+    unsigned char* token = op++;
+    *token = static_cast<unsigned char>((literal_len < 15 ? literal_len : 15) << 4);
+    if (literal_len >= 15 && !(op = WriteLength(op, op_end, literal_len - 15))) {
+        return nullptr;
+    }
+    
+    if (static_cast<size_t>(op_end - op) < literal_len) {
+        return nullptr;
+    }
+    memcpy(op, literals, literal_len);
+    op += literal_len;
+    
+    if (match_len == 0) {
+        return op;
+    }
+    
+    if (op_end - op < 2) {
+        return nullptr;
+    }
+    *op++ = static_cast<unsigned char>(distance & 0xFF);
+    *op++ = static_cast<unsigned char>(distance >> 8);
+    
+    size_t extra = match_len - MIN_MATCH;
+    *token |= static_cast<unsigned char>(extra < 15 ? extra : 15);
+    if (extra >= 15 && !(op = WriteLength(op, op_end, extra - 15))) {
+        return nullptr;
+    }
+    return op;
+}
+
+/**
+ * @brief 贪心的LZ77压缩。
+ *
+ * 哈希表记录每个4字节序列最近出现的位置，命中且在64KB以内时向前、向后扩展匹配；
+ * 连续找不到匹配时逐渐加大步长，不可压缩的数据很快扫过。
+ */
+size_t LZCodec::Compress(const char* src, size_t src_len, char* dst, size_t dst_capacity) {
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(src);
+    unsigned char* op = reinterpret_cast<unsigned char*>(dst);
+    const unsigned char* op_end = op + dst_capacity;
+    size_t anchor = 0;
+    
+    if (src_len > MATCH_LIMIT) {
+        uint32_t table[1 << HASH_BITS];
+        memset(table, 0, sizeof(table));
+        
+        size_t limit = src_len - MATCH_LIMIT;
+        size_t match_end = src_len - LAST_LITERALS;
+        size_t ip = 1;
+        size_t misses = 0;
+        
+        while (ip < limit) {
+            uint32_t sequence = Read32(base + ip);
+            uint32_t h = Hash(sequence);
+            size_t ref = table[h];
+            table[h] = static_cast<uint32_t>(ip);
+            
+            if (ip - ref > MAX_DISTANCE || Read32(base + ref) != sequence) {
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            
+            // 向前扩展到上一个序列的结尾
+            while (ip > anchor && ref > 0 && base[ip - 1] == base[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            
+            size_t len = MIN_MATCH;
+            while (ip + len < match_end && base[ip + len] == base[ref + len]) {
+                len++;
+            }
+            
+            op = WriteSequence(op, op_end, base + anchor, ip - anchor, ip - ref, len);
+            if (!op) {
+                return 0;
+            }
+            
+            ip += len;
+            anchor = ip;
+            if (ip < limit) {
+                table[Hash(Read32(base + ip - 2))] = static_cast<uint32_t>(ip - 2);
+            }
+        }
+    }
+    
+    op = WriteSequence(op, op_end, base + anchor, src_len - anchor, 0, 0);
+    if (!op) {
+        return 0;
+    }
+    return static_cast<size_t>(op - reinterpret_cast<unsigned char*>(dst));
+}
+
+/**
+ * @brief 解压LZ4块格式的数据。
+ *
+ * 每个长度、字面量和回溯距离都先检查输入输出边界，回溯距离不能超出已解压的部分，
+ * 重叠的匹配逐字节复制。
+ */
+bool LZCodec::Decompress(const char* src, size_t src_len, char* dst, size_t dst_len) {
+    const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+    const unsigned char* ip_end = ip + src_len;
+    unsigned char* out = reinterpret_cast<unsigned char*>(dst);
+    size_t op = 0;
+    
+    while (ip < ip_end) {
+        unsigned char token = *ip++;
+        
+        size_t literal_len = token >> 4;
+        if (literal_len == 15) {
+            unsigned char b;
+            do {
+                if (ip >= ip_end) {
+                    return false;
+                }
+                b = *ip++;
+                literal_len += b;
+            } while (b == 255);
+        }
+        
+        if (static_cast<size_t>(ip_end - ip) < literal_len || dst_len - op < literal_len) {
+            return false;
+        }
+        memcpy(out + op, ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+        
+        // 最后一个序列只有字面量
+        if (ip == ip_end) {
+            break;
+        }
+        
+        if (ip_end - ip < 2) {
+            return false;
+        }
+        size_t distance = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (distance == 0 || distance > op) {
+            return false;
+        }
+        
+        size_t match_len = (token & 15) + MIN_MATCH;
+        if ((token & 15) == 15) {
+            unsigned char b;
+            do {
+                if (ip >= ip_end) {
+                    return false;
+                }
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        
+        if (dst_len - op < match_len) {
+            return false;
+        }
+        
+        const unsigned char* match = out + op - distance;
+        if (distance >= match_len) {
+            memcpy(out + op, match, match_len);
+        } else {
+            for (size_t i = 0; i < match_len; i++) {
+                out[op + i] = match[i];
+            }
+        }
+        op += match_len;
+    }
+    
+    return op == dst_len;
+}
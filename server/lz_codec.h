@@ -0,0 +1,27 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 内置的LZ77压缩（LZ4块格式）
+//
+// 每个序列为：令牌字节（高4位字面量长度、低4位匹配长度-4，取15时后跟若干扩展字节，
+// 每字节累加直到不为255）、字面量、2字节小端的回溯距离，最后一个序列只有字面量。
+// 压缩用4字节哈希表找64KB窗口内的匹配，不做熵编码，速度优先；
+// 解压逐项检查边界，可以安全处理来自网络的数据。
+class LZCodec {
+public:
+    // 压缩src_len字节最坏情况下需要的输出空间
+    static size_t MaxCompressedSize(size_t src_len) {
+        return src_len + src_len / 255 + 16;
+    }
+    
+    // 压缩到dst，返回压缩后的字节数，dst空间不足时返回0
+    static size_t Compress(const char* src, size_t src_len, char* dst, size_t dst_capacity);
+    
+    // 解压到dst，数据损坏或解压结果不是恰好dst_len字节时返回false
+    static bool Decompress(const char* src, size_t src_len, char* dst, size_t dst_len);
+};
+
+#endif // LZ_CODEC_H
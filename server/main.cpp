@@ -6,6 +6,12 @@
 // 全局服务器实例
 EpollServer* g_server = nullptr;
 
+// 收到SIGUSR1后由主线程导出追踪记录
+volatile sig_atomic_t g_dump_trace = 0;
+
+// 是否逐条打印收发的消息（默认关闭，回调在IO线程中执行，逐条写控制台会拖慢事件循环）
+bool g_verbose = false;
+
 // 信号处理函数
 void SignalHandler(int sig) {
     if (g_server) {
@@ -16,34 +22,42 @@ void SignalHandler(int sig) {
     exit(0);
 }
 
+// 追踪导出信号处理函数：立即停止记录，保住信号到达前的记录，导出在主线程中进行
+void DumpTraceHandler(int) {
+    if (g_server) {
+        g_server->DisableTracing();
+    }
+    g_dump_trace = 1;
+}
+
 // 消息处理回调
 void OnMessage(int client_fd, const TLVMessage& msg) {
-    std::cout << "Received message from client " << client_fd 
-              << ", type: " << msg.type 
-              << ", length: " << msg.length << std::endl;
+    if (g_verbose) {
+        std::cout << "Received message from client " << client_fd 
+                  << ", type: " << msg.type 
+                  << ", length: " << msg.length << std::endl;
+    }
     
-    // 简单的回显服务，将收到的消息发送回客户端
+    // 简单的回显服务，将收到的消息发送回客户端（响应类型为请求类型+1，对端启用压缩时按需压缩）
     if (g_server) {
-        // 创建响应消息
-        TLVMessage response;
-        response.type = msg.type + 1;  // 响应类型为请求类型+1
-        response.length = msg.length;
-        response.value = msg.value;
-        
-        // 序列化消息
-        TLVProtocol protocol;
-        std::vector<char> data;
-        if (protocol.SerializeMessage(response, data)) {
-            // 发送响应
-            g_server->SendMessage(client_fd, data.data(), data.size());
+        SendStatus result = g_server->SendFrame(client_fd, msg.type + 1, msg.value.data(), msg.length);
+        if (g_verbose && result != SEND_FAILED) {
             std::cout << "Sent response to client " << client_fd << std::endl;
         }
     }
 }
 
-// 连接回调
+// 连接回调（服务器自身不在IO线程中打印连接信息，需要时由应用在回调中输出）
 void OnConnect(int client_fd) {
-    std::cout << "Client connected: " << client_fd << std::endl;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    socklen_t addr_len = sizeof(addr);
+    char addr_text[INET_ADDRSTRLEN] = "?";
+    if (getpeername(client_fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_len) == 0) {
+        inet_ntop(AF_INET, &addr.sin_addr, addr_text, sizeof(addr_text));
+    }
+    std::cout << "Client connected: " << client_fd << " from " << addr_text
+              << ":" << ntohs(addr.sin_port) << std::endl;
 }
 
 // 断开连接回调
@@ -55,6 +69,10 @@ int main(int argc, char* argv[]) {
     // 默认参数
     std::string ip = "0.0.0.0";
     int port = 8888;
+    int reactors = 1;
+    bool use_acceptor = false;
+    bool use_uring = false;
+    bool use_trace = false;
     
     // 解析命令行参数
     if (argc > 1) {
@@ -65,18 +83,58 @@ int main(int argc, char* argv[]) {
         port = std::stoi(argv[2]);
     }
     
+    if (argc > 3) {
+        reactors = std::stoi(argv[3]);
+    }
+    
+    if (argc > 4) {
+        use_acceptor = (std::string(argv[4]) == "acceptor");
+    }
+    
+    if (argc > 5) {
+        use_uring = (std::string(argv[5]) == "uring");
+    }
+    
+    if (argc > 6) {
+        use_trace = (std::string(argv[6]) == "trace");
+    }
+    
+    if (argc > 7) {
+        g_verbose = (std::string(argv[7]) == "verbose");
+    }
+    
     // 注册信号处理函数
     signal(SIGINT, SignalHandler);
     signal(SIGTERM, SignalHandler);
+    signal(SIGUSR1, DumpTraceHandler);
     
     // 创建服务器实例
-    g_server = new EpollServer(ip.c_str(), port);
+    g_server = new EpollServer(ip.c_str(), port, 1024,
+                               use_uring ? PollerType::IoUring : PollerType::Epoll);
+    g_server->SetReactorCount(reactors);
+    if (use_acceptor) {
+        g_server->SetAcceptMode(AcceptMode::Acceptor);
+    }
     
     // 设置回调函数
     g_server->SetOnConnectCallback(OnConnect);
     g_server->SetOnDisconnectCallback(OnDisconnect);
     g_server->SetOnMessageCallback(OnMessage);
     
+    // 发送类型为METRICS_TLV_TYPE的消息即可查询服务器指标
+    g_server->EnableStatsEndpoint();
+    
+    // 客户端握手后，不短于1KB的响应压缩发送
+    g_server->EnableCompression();
+    
+    // 客户端握手后可改用紧凑的v2帧格式
+    g_server->EnableFormatNegotiation();
+    
+    // 启用追踪后，kill -USR1 <pid> 把最近的记录写入trace.bin
+    if (use_trace) {
+        g_server->EnableTracing();
+    }
+    
     // 启动服务器
     if (!g_server->Start()) {
         std::cerr << "Failed to start server" << std::endl;
@@ -90,6 +148,15 @@ int main(int argc, char* argv[]) {
     // 主线程等待，实际工作由服务器的工作线程完成
     while (true) {
         std::this_thread::sleep_for(std::chrono::seconds(1));
+        
+        if (g_dump_trace) {
+            g_dump_trace = 0;
+            int64_t count = g_server->DumpTrace("trace.bin");
+            std::cout << "Dumped " << count << " trace records to trace.bin" << std::endl;
+            if (use_trace) {
+                g_server->EnableTracing();
+            }
+        }
     }
     
     // 清理资源
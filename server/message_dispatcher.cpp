@@ -0,0 +1,60 @@
+#include "message_dispatcher.h"
+
+MessageDispatcher::MessageDispatcher() : m_registered(0) {
+}
+
+MessageDispatcher::~MessageDispatcher() {
+}
+
+/**
+ * @brief 注册std::function处理函数。
+ *
+ * 处理函数保存在m_handlers中，表项指向它并通过CallHandler转发；
+ * 同一类型重复注册时先清除旧表项再释放旧的处理函数。
+ */
+void MessageDispatcher::Register(uint16_t type, MessageHandler handler) {
+    if (!handler) {
+        Unregister(type);
+        return;
+    }
+    
+    std::unique_ptr<MessageHandler> stored(new MessageHandler(std::move(handler)));
+    SetEntry(type, &CallHandler, stored.get());
+    m_handlers[type] = std::move(stored);
+}
+
+void MessageDispatcher::Unregister(uint16_t type) {
+    if (m_table && m_table[type].function) {
+        m_table[type].function = nullptr;
+        m_table[type].context = nullptr;
+        m_registered--;
+    }
+    m_handlers.erase(type);
+}
+
+void MessageDispatcher::SetDefault(MessageHandler handler) {
+    m_default = std::move(handler);
+}
+
+/**
+ * @brief 写入一个表项。
+ *
+ * 表在第一次注册时分配并清零，未使用类型分发的服务器不占用这1MB内存。
+ * 替换以std::function注册的处理函数时释放旧的存储。
+ */
+void MessageDispatcher::SetEntry(uint16_t type, DispatchFunction function, void* context) {
+    if (!m_table) {
+        m_table.reset(new Entry[DISPATCH_TABLE_SIZE]());
+    }
+    
+    Entry& entry = m_table[type];
+    if (!entry.function) {
+        m_registered++;
+    }
+    entry.function = function;
+    entry.context = context;
+    
+    if (function != &CallHandler) {
+        m_handlers.erase(type);
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef MESSAGE_DISPATCHER_H
+#define MESSAGE_DISPATCHER_H
+
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include "tlv_protocol.h"
+
+// 消息类型的数量（TLV类型为16位）
+#define DISPATCH_TABLE_SIZE 65536
+
+// 按类型分发的消息处理函数（TLVView只在调用期间有效）
+typedef std::function<void(int, const TLVView&)> MessageHandler;
+
+// 按TLV类型分发消息
+//
+// 以类型为下标的65536项平坦表，每项是一个函数指针和上下文，分发只需一次取表和一次
+// 间接调用。std::function处理函数经由一个通用的转发函数调用；模板注册方式在编译期
+// 把处理函数绑定进转发函数，省去std::function的一层间接调用。未注册的类型交给默认
+// 处理函数。表在第一次注册时分配；注册只能在开始分发之前进行，分发时不加锁。
+class MessageDispatcher {
+public:
+    MessageDispatcher();
+    ~MessageDispatcher();
+    
+    // 注册type的处理函数，替换已有的处理函数
+    void Register(uint16_t type, MessageHandler handler);
+    
+    // 注册编译期确定的函数
+    template <void (*Handler)(int, const TLVView&)>
+    void Register(uint16_t type) {
+        SetEntry(type, &CallFunction<Handler>, nullptr);
+    }
+    
+    // 注册编译期确定的成员函数，object需在分发期间保持有效
+    template <class T, void (T::*Method)(int, const TLVView&)>
+    void Register(uint16_t type, T* object) {
+        SetEntry(type, &CallMethod<T, Method>, object);
+    }
+    
+    // 取消type的处理函数
+    void Unregister(uint16_t type);
+    
+    // 设置未注册类型的默认处理函数（空函数表示丢弃）
+    void SetDefault(MessageHandler handler);
+    
+    // 是否注册了任何处理函数或默认处理函数
+    bool IsEmpty() const {
+        return m_registered == 0 && !m_default;
+    }
+    
+    // 分发一条消息，返回是否由注册的处理函数处理（否则交给了默认处理函数或被丢弃）
+    bool Dispatch(int fd, const TLVView& view) const {
+        if (m_table) {
+            const Entry& entry = m_table[view.type];
+            if (entry.function) {
+                entry.function(entry.context, fd, view);
+                return true;
+            }
+        }
+        
+        if (m_default) {
+            m_default(fd, view);
+        }
+        return false;
+    }
+
+private:
+    typedef void (*DispatchFunction)(void* context, int fd, const TLVView& view);
+    
+    struct Entry {
+        DispatchFunction function;
+        void* context;
+    };
+    
+    static void CallHandler(void* context, int fd, const TLVView& view) {
+        (*static_cast<MessageHandler*>(context))(fd, view);
+    }
+    
+    template <void (*Handler)(int, const TLVView&)>
+    static void CallFunction(void*, int fd, const TLVView& view) {
+        Handler(fd, view);
+    }
+    
+    template <class T, void (T::*Method)(int, const TLVView&)>
+    static void CallMethod(void* context, int fd, const TLVView& view) {
+        (static_cast<T*>(context)->*Method)(fd, view);
+    }
+    
+    void SetEntry(uint16_t type, DispatchFunction function, void* context);
+    
+    MessageDispatcher(const MessageDispatcher&);
+    MessageDispatcher& operator=(const MessageDispatcher&);
+    
+    std::unique_ptr<Entry[]> m_table;  // 按类型索引，第一次注册时分配
+    size_t m_registered;               // 已注册的类型数
+    std::map<uint16_t, std::unique_ptr<MessageHandler> > m_handlers;  // std::function处理函数的存储
+    MessageHandler m_default;          // 默认处理函数
+};
+
+#endif // MESSAGE_DISPATCHER_H
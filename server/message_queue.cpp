@@ -1,122 +1,298 @@
 #include "message_queue.h"
+#include <string.h>
+#include <unistd.h>
+#include <new>
 
-MessageQueue::MessageQueue() {
+SharedBuffer MakeSharedBuffer(const char* data, size_t len) {
+    return std::make_shared<const PooledBytes>(data, data + len);
+}
+
+MessageQueue::MessageQueue() : m_head(NewNode(0)), m_head_offset(0), m_tail(m_head), m_queued_bytes(0) {
 }
 
 MessageQueue::~MessageQueue() {
-    ClearAll();
+    // 析构时已没有生产者，直接释放包括哨兵在内的全部节点
+    Node* node = m_head;
+    while (node) {
+        Node* next = node->next.load(std::memory_order_relaxed);
+        DeleteNode(node);
+        node = next;
+    }
+}
+
+MessageQueue::Node* MessageQueue::NewNode(size_t payload_len) {
+    size_t alloc_size = sizeof(Node) + payload_len;
+    void* ptr = BufferPool::Instance().Allocate(alloc_size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    
+    Node* node = new (ptr) Node();
+    node->alloc_size = alloc_size;
+    return node;
+}
+
+void MessageQueue::DeleteNode(Node* node) {
+    size_t alloc_size = node->alloc_size;
+    ReleaseData(node);
+    node->~Node();
+    BufferPool::Instance().Deallocate(node, alloc_size);
+}
+
+void MessageQueue::ReleaseData(Node* node) {
+    node->shared.reset();
+    if (node->file_fd >= 0) {
+        close(node->file_fd);
+        node->file_fd = -1;
+    }
+}
+
+void MessageQueue::Enqueue(Node* node) {
+    EnqueueChain(node, node);
+}
+
+void MessageQueue::EnqueueChain(Node* first, Node* last) {
+    // 先抢占尾部，再把前驱链接到新节点；两步之间消费者暂时看不到这些节点，
+    // 投递方随后会唤醒事件循环，所以不会遗漏
+    Node* prev = m_tail.exchange(last, std::memory_order_acq_rel);
+    prev->next.store(first, std::memory_order_release);
+}
+
+bool MessageQueue::Push(const char* data, size_t len) {
+    if (!data || len == 0) {
+        return false;
+    }
+    
+    Node* node = NewNode(len);
+    memcpy(node->Payload(), data, len);
+    node->begin = node->Payload();
+    node->size = len;
+    
+    // 先计数再投递，消费者不会在计数前把它减掉
+    m_queued_bytes.fetch_add(len, std::memory_order_relaxed);
+    Enqueue(node);
+    return true;
 }
 
-bool MessageQueue::Push(int fd, const char* data, size_t len) {
-    if (fd < 0 || !data || len == 0) {
+bool MessageQueue::PushShared(const SharedBuffer& buffer) {
+    if (!buffer || buffer->empty()) {
         return false;
     }
     
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_queues[fd].push(MessageEntry(data, len));
+    Node* node = NewNode(0);
+    node->shared = buffer;
+    node->begin = buffer->data();
+    node->size = buffer->size();
     
+    m_queued_bytes.fetch_add(node->size, std::memory_order_relaxed);
+    Enqueue(node);
     return true;
 }
 
-bool MessageQueue::PushFront(int fd, const char* data, size_t len) {
-    if (fd < 0 || !data || len == 0) {
+/**
+ * @brief 投递一个文件段，header（TLV头部）紧挨在它前面。
+ *
+ * 两个节点先在本地链接好，再用一次尾部交换挂入队列，其他生产者的消息
+ * 只能排在整段之前或之后，头部和文件内容在字节流中总是连续的。
+ */
+bool MessageQueue::PushFile(const char* header, size_t header_len, int file_fd, off_t offset, size_t len) {
+    if (file_fd < 0 || len == 0 || (!header && header_len > 0)) {
         return false;
     }
     
-    std::lock_guard<std::mutex> lock(m_mutex);
+    Node* file = NewNode(0);
+    file->file_fd = file_fd;
+    file->file_offset = offset;
+    file->size = len;
     
-    // 创建一个新队列，先放入新消息，再放入原队列中的所有消息
-    std::queue<MessageEntry> new_queue;
-    new_queue.push(MessageEntry(data, len));
+    Node* first = file;
+    if (header_len > 0) {
+        first = NewNode(header_len);
+        memcpy(first->Payload(), header, header_len);
+        first->begin = first->Payload();
+        first->size = header_len;
+        first->next.store(file, std::memory_order_relaxed);
+    }
     
-    auto& old_queue = m_queues[fd];
-    while (!old_queue.empty()) {
-        new_queue.push(std::move(old_queue.front()));
-        old_queue.pop();
+    m_queued_bytes.fetch_add(header_len + len, std::memory_order_relaxed);
+    EnqueueChain(first, file);
+    return true;
+}
+
+/**
+ * @brief 把消息插到队列最前面。
+ *
+ * 生产者可能正要链接哨兵节点的next，哨兵不能摘掉。这里在它前面放一个新哨兵和
+ * 新消息，旧哨兵留在链表中成为一个空节点，发送时跳过。
+ */
+bool MessageQueue::PushFront(const char* data, size_t len) {
+    if (!data || len == 0) {
+        return false;
     }
     
-    // 替换原队列
-    m_queues[fd] = std::move(new_queue);
+    Node* node = NewNode(len);
+    memcpy(node->Payload(), data, len);
+    node->begin = node->Payload();
+    node->size = len;
+    
+    Node* stub = NewNode(0);
+    
+    // 队首消息已部分发送时，把已发送的部分从它的数据范围中去掉
+    if (m_head_offset > 0) {
+        Node* first = m_head->next.load(std::memory_order_acquire);
+        if (first->file_fd >= 0) {
+            first->file_offset += m_head_offset;
+        } else {
+            first->begin += m_head_offset;
+        }
+        first->size -= m_head_offset;
+        m_head_offset = 0;
+    }
+    
+    node->next.store(m_head, std::memory_order_relaxed);
+    stub->next.store(node, std::memory_order_relaxed);
+    m_head = stub;
+    m_queued_bytes.fetch_add(len, std::memory_order_relaxed);
     
     return true;
 }
 
-bool MessageQueue::GetMessages(int fd, std::vector<char>& data) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+void MessageQueue::PopFront() {
+    Node* first = m_head->next.load(std::memory_order_acquire);
+    DeleteNode(m_head);
     
-    auto it = m_queues.find(fd);
-    if (it == m_queues.end() || it->second.empty()) {
+    // 新哨兵的数据已发送完，立即释放共享缓冲区的引用并关闭文件
+    m_head = first;
+    first->begin = nullptr;
+    first->size = 0;
+    ReleaseData(first);
+    m_head_offset = 0;
+}
+
+MessageQueue::Node* MessageQueue::FirstNode() {
+    Node* first = m_head->next.load(std::memory_order_acquire);
+    while (first && first->size == 0) {
+        PopFront();
+        first = m_head->next.load(std::memory_order_acquire);
+    }
+    return first;
+}
+
+bool MessageQueue::GetMessages(std::vector<char>& data) {
+    Node* first = FirstNode();
+    if (!first) {
         return false;
     }
     
-    // 计算总数据大小
+    // 计算总数据大小（文件段及其后的消息留在队列中）
     size_t total_size = 0;
-    std::queue<MessageEntry> temp_queue = it->second;
-    while (!temp_queue.empty()) {
-        total_size += temp_queue.front().data.size();
-        temp_queue.pop();
+    for (Node* node = first; node && node->file_fd < 0; node = node->next.load(std::memory_order_acquire)) {
+        total_size += node->size;
+    }
+    if (total_size == 0) {
+        return false;
     }
+    total_size -= m_head_offset;
     
     // 调整输出缓冲区大小
     data.clear();
     data.reserve(total_size);
+    m_queued_bytes.fetch_sub(total_size, std::memory_order_relaxed);
     
-    // 合并所有消息
-    auto& queue = it->second;
-    while (!queue.empty()) {
-        const auto& entry = queue.front();
-        data.insert(data.end(), entry.data.begin(), entry.data.end());
-        queue.pop();
+    // 合并所有消息（只取统计时看到的部分，之后投递的留在队列中）
+    size_t offset = m_head_offset;
+    while (data.size() < total_size) {
+        Node* node = m_head->next.load(std::memory_order_acquire);
+        data.insert(data.end(), node->begin + offset, node->begin + node->size);
+        offset = 0;
+        PopFront();
     }
     
     return true;
 }
-//用于判断某个连接是否有待发送的数据，常用于发送线程或 epoll 写事件处理时决定是否需要发送消息。
-bool MessageQueue::HasMessages(int fd) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
-    auto it = m_queues.find(fd);
-    return (it != m_queues.end() && !it->second.empty());
-}
 
 /**
- * @brief 获取所有具有非空消息队列的文件描述符（fd）。
- *
- * 该函数会加锁保护消息队列的数据结构，遍历所有队列，
- * 并收集那些消息队列不为空的文件描述符（fd）。
+ * @brief 用队列中的消息填充iovec数组，供writev/sendmsg直接发送。
  *
- * @return std::vector<int> 包含所有对应非空消息队列的文件描述符。
+ * 不复制任何数据，iovec直接指向各消息自己的缓冲区；队首消息从已发送的偏移处开始。
+ * 返回的指针在调用Consume之前保持有效（生产者只在尾部追加）。
  *
- * @note 线程安全：函数内部使用互斥锁保护共享资源。
+ * @return 填充的iovec个数，队列为空时返回0。
  */
-std::vector<int> MessageQueue::GetAllFds() {
-    std::lock_guard<std::mutex> lock(m_mutex);
+int MessageQueue::PrepareIov(struct iovec* iov, int max_iov) {
+    int count = 0;
+    size_t offset = m_head_offset;
     
-    std::vector<int> fds;
-    for (const auto& pair : m_queues) {
-        if (!pair.second.empty()) {
-            fds.push_back(pair.first);
+    for (Node* node = FirstNode(); node && count < max_iov;
+         node = node->next.load(std::memory_order_acquire)) {
+        if (node->size == 0) {
+            continue;
+        }
+        
+        // 文件段由调用方用sendfile发送，iovec只到它之前为止
+        if (node->file_fd >= 0) {
+            break;
         }
+        
+        // sendmsg不会修改数据，共享缓冲区的const可以安全去掉
+        iov[count].iov_base = const_cast<char*>(node->begin) + offset;
+        iov[count].iov_len = node->size - offset;
+        count++;
+        offset = 0;
     }
     
-    return fds;
+    return count;
 }
 
-void MessageQueue::Clear(int fd) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+bool MessageQueue::FrontFile(int& file_fd, off_t& offset, size_t& len) {
+    Node* first = FirstNode();
+    if (!first || first->file_fd < 0) {
+        return false;
+    }
     
-    auto it = m_queues.find(fd);
-    if (it != m_queues.end()) {
-        // 清空队列
-        std::queue<MessageEntry> empty;
-        std::swap(it->second, empty);
+    file_fd = first->file_fd;
+    offset = first->file_offset + static_cast<off_t>(m_head_offset);
+    len = first->size - m_head_offset;
+    return true;
+}
+
+/**
+ * @brief 确认已发送bytes字节。
+ *
+ * 完整发送的消息出队，部分发送的队首消息只记录偏移，不做拷贝。
+ */
+void MessageQueue::Consume(size_t bytes) {
+    while (true) {
+        Node* first = m_head->next.load(std::memory_order_acquire);
+        if (!first) {
+            return;
+        }
+        
+        size_t remaining = first->size - m_head_offset;
+        if (bytes < remaining) {
+            m_head_offset += bytes;
+            m_queued_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+            return;
+        }
         
-        // 移除空队列
-        m_queues.erase(it);
+        bytes -= remaining;
+        m_queued_bytes.fetch_sub(remaining, std::memory_order_relaxed);
+        PopFront();
     }
 }
+//用于判断连接是否有待发送的数据，常用于发送线程或 epoll 写事件处理时决定是否需要发送消息。
+bool MessageQueue::HasMessages() {
+    return FirstNode() != nullptr;
+}
+
+size_t MessageQueue::GetQueuedBytes() const {
+    return m_queued_bytes.load(std::memory_order_relaxed);
+}
 
-void MessageQueue::ClearAll() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_queues.clear();
+void MessageQueue::Clear() {
+    Node* first;
+    while ((first = m_head->next.load(std::memory_order_acquire)) != nullptr) {
+        m_queued_bytes.fetch_sub(first->size - m_head_offset, std::memory_order_relaxed);
+        PopFront();
+    }
 }
\ No newline at end of file
@@ -1,54 +1,110 @@
 #ifndef MESSAGE_QUEUE_H
 #define MESSAGE_QUEUE_H
 
-#include <map>
-#include <queue>
+#include <atomic>
+#include <memory>
 #include <vector>
-#include <mutex>
-#include <condition_variable>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "buffer_pool.h"
+
+// 共享的只读发送缓冲区
+// 消息只序列化一次，广播时各连接的发送队列只持有引用，最后一个引用释放时回收
+typedef std::shared_ptr<const PooledBytes> SharedBuffer;
+
+// 创建共享发送缓冲区（复制一次data）
+SharedBuffer MakeSharedBuffer(const char* data, size_t len);
 
 // 消息队列类，用于异步发送
+// 每个连接持有一个无锁的多生产者/单消费者队列：任意线程都可以投递（Push、PushShared），
+// 其余操作只能由连接所属的事件循环线程（唯一的消费者）调用。
+// 除内存中的消息外，队列中还可以有文件段（PushFile），由消费者用sendfile直接从文件发送。
 class MessageQueue {
 public:
     MessageQueue();
     ~MessageQueue();
     
-    // 将消息添加到队列尾部
-    bool Push(int fd, const char* data, size_t len);
+    // 将消息添加到队列尾部（任意线程）
+    bool Push(const char* data, size_t len);
+    
+    // 将共享缓冲区添加到队列尾部，只增加引用计数，不复制数据（任意线程）
+    bool PushShared(const SharedBuffer& buffer);
     
-    // 将消息添加到队列头部（优先发送）
-    bool PushFront(int fd, const char* data, size_t len);
+    // 将header和文件file_fd中[offset, offset + len)的内容作为一个整体添加到队列尾部，
+    // 两者之间不会插入其他线程投递的消息（任意线程）。队列接管file_fd，发送完或清空时关闭
+    bool PushFile(const char* header, size_t header_len, int file_fd, off_t offset, size_t len);
     
-    // 获取指定fd的所有消息
-    bool GetMessages(int fd, std::vector<char>& data);
+    // 将消息添加到队列头部，优先发送（仅消费者线程）
+    bool PushFront(const char* data, size_t len);
     
-    // 检查指定fd是否有消息
-    bool HasMessages(int fd);
+    // 获取所有消息，合并为一块连续数据，遇到文件段时停止（仅消费者线程）
+    bool GetMessages(std::vector<char>& data);
     
-    // 获取所有有消息的fd
-    std::vector<int> GetAllFds();
+    // 用队首的消息填充iovec数组，不复制数据，返回填充的个数，遇到文件段时停止（仅消费者线程）
+    int PrepareIov(struct iovec* iov, int max_iov);
     
-    // 清空指定fd的消息队列
-    void Clear(int fd);
+    // 队首是文件段时取得其文件、当前偏移和剩余字节数，发送后同样用Consume确认（仅消费者线程）
+    bool FrontFile(int& file_fd, off_t& offset, size_t& len);
     
-    // 清空所有消息队列
-    void ClearAll();
+    // 确认已发送bytes字节：弹出发送完的消息，记录队首消息的发送偏移（仅消费者线程）
+    void Consume(size_t bytes);
     
+    // 检查是否有消息或文件段（仅消费者线程）
+    bool HasMessages();
+    
+    // 队列中尚未发送的字节数（任意线程）
+    size_t GetQueuedBytes() const;
+    
+    // 清空消息队列（仅消费者线程）
+    void Clear();
+
 private:
-    // 消息队列结构
-    struct MessageEntry {
-        std::vector<char> data;
+    // 队列节点
+    // 节点头部之后紧跟消息数据，一次分配同时容纳两者；
+    // 引用共享缓冲区时不带数据，begin指向共享缓冲区的内容；
+    // 文件段不带数据，begin为空，待发送的是file_fd中从file_offset开始的size字节
+    struct Node {
+        std::atomic<Node*> next;
+        const char* begin;    // 待发送数据的起始位置
+        size_t size;          // 待发送数据的长度
+        size_t alloc_size;    // 节点分配的总字节数
+        SharedBuffer shared;
+        int file_fd;          // 文件段的文件（-1表示不是文件段）
+        off_t file_offset;    // 文件段在文件中的起始偏移
         
-        MessageEntry(const char* d, size_t len) {
-            data.assign(d, d + len);
+        Node() : next(nullptr), begin(nullptr), size(0), alloc_size(0), file_fd(-1), file_offset(0) {}
+        
+        char* Payload() {
+            return reinterpret_cast<char*>(this + 1);
         }
     };
     
-    // 每个fd对应一个消息队列
-    std::map<int, std::queue<MessageEntry>> m_queues;
+    // 节点从缓冲区池分配，payload_len为节点内联数据的长度
+    static Node* NewNode(size_t payload_len);
+    static void DeleteNode(Node* node);
+    
+    // 把节点挂到队列尾部（生产者）
+    void Enqueue(Node* node);
+    
+    // 把已链接好的first...last一次挂到队列尾部（生产者）
+    void EnqueueChain(Node* first, Node* last);
+    
+    // 释放节点引用的共享缓冲区和文件
+    static void ReleaseData(Node* node);
+    
+    // 弹出队首消息（消费者），原哨兵节点被释放，队首节点成为新的哨兵
+    void PopFront();
+    
+    // 弹出队首的空节点（PushFront留下的旧哨兵），返回第一个有数据的节点
+    Node* FirstNode();
     
-    // 互斥锁，保证线程安全
-    std::mutex m_mutex;
+    // Vyukov式侵入链表：m_head是哨兵节点，其后才是待发送的消息。
+    // 生产者只交换m_tail再链接前驱的next，一次原子交换完成投递；
+    // 消费者沿next前进，不与生产者竞争同一把锁。
+    Node* m_head;                // 哨兵节点（仅消费者访问）
+    size_t m_head_offset;        // 队首消息已发送的字节数（仅消费者访问）
+    std::atomic<Node*> m_tail;   // 最后投递的节点
+    std::atomic<size_t> m_queued_bytes;  // 尚未发送的字节数
 };
 
 #endif // MESSAGE_QUEUE_H
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "metrics.h"
+#include <stdio.h>
+
+// 指标名称，顺序与枚举一致
+static const char* const COUNTER_NAMES[COUNTER_COUNT] = {
+    "accepts_total",
+    "connections_opened_total",
+    "connections_closed_total",
+    "idle_timeouts_total",
+    "bytes_received_total",
+    "bytes_sent_total",
+    "messages_received_total",
+    "messages_sent_total",
+    "read_calls_total",
+    "write_calls_total",
+    "poll_waits_total",
+    "compress_input_bytes_total",
+    "compress_output_bytes_total",
+    "compress_ns_total",
+    "decompress_input_bytes_total",
+    "decompress_output_bytes_total",
+    "decompress_ns_total",
+    "file_bytes_sent_total"
+};
+
+static const char* const HISTOGRAM_NAMES[HISTOGRAM_COUNT] = {
+    "poll_batch_size",
+    "send_queue_bytes",
+    "parse_to_callback_ns",
+    "enqueue_to_write_ns",
+    "message_batch_size"
+};
+
+static const char* const TYPE_COUNTER_NAMES[TYPE_COUNTER_COUNT] = {
+    "messages_by_type_total",
+    "messages_handled_total",
+    "messages_unhandled_total"
+};
+
+// 输出的分位数
+static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+// 注册表ID从1开始，线程局部缓存初始为0，不会误匹配
+static std::atomic<uint64_t> g_next_registry_id(1);
+
+thread_local MetricsRegistry::LocalCache MetricsRegistry::t_cache = {0, nullptr};
+
+uint64_t HistogramSnapshot::Percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    
+    uint64_t target = static_cast<uint64_t>(p * count + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+    
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            uint64_t value = MetricsShard::BucketValue(i);
+            return value < max ? value : max;
+        }
+    }
+    
+    return max;
+}
+
+double HistogramSnapshot::Mean() const {
+    return count ? static_cast<double>(sum) / count : 0.0;
+}
+
+MetricsSnapshot::MetricsSnapshot() {
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        counters[i] = 0;
+    }
+}
+
+/**
+ * @brief 格式化为Prometheus文本格式。
+ *
+ * 计数器和瞬时值各占一行；按类型的消息数带type标签；直方图输出count、sum、max
+ * 以及p50/p90/p99/p999（quantile标签），可以直接被抓取或用grep查看。
+ */
+std::string MetricsSnapshot::ToText() const {
+    std::string text;
+    char line[128];
+    
+    for (size_t i = 0; i < gauges.size(); i++) {
+        snprintf(line, sizeof(line), "%s %llu\n", gauges[i].first.c_str(),
+                 (unsigned long long)gauges[i].second);
+        text += line;
+    }
+    
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        snprintf(line, sizeof(line), "%s %llu\n", COUNTER_NAMES[i], (unsigned long long)counters[i]);
+        text += line;
+    }
+    
+    for (size_t c = 0; c < TYPE_COUNTER_COUNT; c++) {
+        for (size_t i = 0; i < by_type[c].size(); i++) {
+            snprintf(line, sizeof(line), "%s{type=\"%u\"} %llu\n", TYPE_COUNTER_NAMES[c],
+                     by_type[c][i].first, (unsigned long long)by_type[c][i].second);
+            text += line;
+        }
+    }
+    
+    for (size_t i = 0; i < HISTOGRAM_COUNT; i++) {
+        const HistogramSnapshot& h = histograms[i];
+        for (size_t q = 0; q < sizeof(QUANTILES) / sizeof(QUANTILES[0]); q++) {
+            snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %llu\n", HISTOGRAM_NAMES[i],
+                     QUANTILES[q], (unsigned long long)h.Percentile(QUANTILES[q]));
+            text += line;
+        }
+        snprintf(line, sizeof(line), "%s_max %llu\n%s_sum %llu\n%s_count %llu\n",
+                 HISTOGRAM_NAMES[i], (unsigned long long)h.max,
+                 HISTOGRAM_NAMES[i], (unsigned long long)h.sum,
+                 HISTOGRAM_NAMES[i], (unsigned long long)h.count);
+        text += line;
+    }
+    
+    return text;
+}
+
+MetricsShard::MetricsShard() {
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        counters[i].store(0, std::memory_order_relaxed);
+    }
+    
+    for (size_t i = 0; i < HISTOGRAM_COUNT; i++) {
+        HistogramData& data = histograms[i];
+        for (size_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+            data.buckets[b].store(0, std::memory_order_relaxed);
+        }
+        data.count.store(0, std::memory_order_relaxed);
+        data.sum.store(0, std::memory_order_relaxed);
+        data.max.store(0, std::memory_order_relaxed);
+    }
+    
+    for (size_t c = 0; c < TYPE_COUNTER_COUNT; c++) {
+        for (size_t i = 0; i < TYPE_BLOCKS; i++) {
+            type_blocks[c][i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+}
+
+MetricsShard::~MetricsShard() {
+    for (size_t c = 0; c < TYPE_COUNTER_COUNT; c++) {
+        for (size_t i = 0; i < TYPE_BLOCKS; i++) {
+            delete[] type_blocks[c][i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t MetricsShard::BucketValue(size_t index) {
+    if (index < HISTOGRAM_SUB_COUNT) {
+        return index;
+    }
+    
+    uint64_t k = index - HISTOGRAM_SUB_COUNT;
+    int shift = static_cast<int>(k / (HISTOGRAM_SUB_COUNT / 2)) + 1;
+    uint64_t top = k % (HISTOGRAM_SUB_COUNT / 2) + HISTOGRAM_SUB_COUNT / 2;
+    return (top << shift) + ((static_cast<uint64_t>(1) << shift) >> 1);
+}
+
+/**
+ * @brief 分配一块按类型计数的计数器。
+ *
+ * 只由所属线程调用；用release发布，读取方看到指针时计数器已清零。
+ */
+std::atomic<uint64_t>* MetricsShard::AllocateTypeBlock(std::atomic<std::atomic<uint64_t>*>& slot) {
+    std::atomic<uint64_t>* counts = new std::atomic<uint64_t>[TYPE_BLOCK_SIZE];
+    for (size_t i = 0; i < TYPE_BLOCK_SIZE; i++) {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+    
+    slot.store(counts, std::memory_order_release);
+    return counts;
+}
+
+MetricsRegistry::MetricsRegistry()
+    : m_id(g_next_registry_id.fetch_add(1, std::memory_order_relaxed)) {
+}
+
+MetricsRegistry::~MetricsRegistry() {
+}
+
+/**
+ * @brief 查找或创建当前线程的分片，并写入线程局部缓存。
+ *
+ * 每个线程只在第一次写入时（或交替写入多个注册表时）走到这里。
+ * 线程ID被复用时沿用旧线程的分片：旧线程已经退出，分片仍然只有一个写入方。
+ */
+MetricsShard* MetricsRegistry::LocalSlow() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    std::unique_ptr<MetricsShard>& shard = m_shards[std::this_thread::get_id()];
+    if (!shard) {
+        shard.reset(new MetricsShard());
+    }
+    
+    t_cache.registry_id = m_id;
+    t_cache.shard = shard.get();
+    return shard.get();
+}
+
+MetricsSnapshot MetricsRegistry::Snapshot() const {
+    MetricsSnapshot snapshot;
+    
+    // 按块汇总类型计数，只为至少一个分片用到的块分配空间
+    std::vector<std::vector<uint64_t> > type_counts[TYPE_COUNTER_COUNT];
+    for (size_t c = 0; c < TYPE_COUNTER_COUNT; c++) {
+        type_counts[c].resize(MetricsShard::TYPE_BLOCKS);
+    }
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+        const MetricsShard& shard = *it->second;
+        
+        for (size_t i = 0; i < COUNTER_COUNT; i++) {
+            snapshot.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+        }
+        
+        for (size_t i = 0; i < HISTOGRAM_COUNT; i++) {
+            const MetricsShard::HistogramData& data = shard.histograms[i];
+            HistogramSnapshot& h = snapshot.histograms[i];
+            for (size_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                h.buckets[b] += data.buckets[b].load(std::memory_order_relaxed);
+            }
+            h.count += data.count.load(std::memory_order_relaxed);
+            h.sum += data.sum.load(std::memory_order_relaxed);
+            uint64_t max = data.max.load(std::memory_order_relaxed);
+            if (max > h.max) {
+                h.max = max;
+            }
+        }
+        
+        for (size_t c = 0; c < TYPE_COUNTER_COUNT; c++) {
+            for (size_t block = 0; block < MetricsShard::TYPE_BLOCKS; block++) {
+                const std::atomic<uint64_t>* counts = shard.type_blocks[c][block].load(std::memory_order_acquire);
+                if (!counts) {
+                    continue;
+                }
+                std::vector<uint64_t>& sums = type_counts[c][block];
+                if (sums.empty()) {
+                    sums.assign(MetricsShard::TYPE_BLOCK_SIZE, 0);
+                }
+                for (size_t i = 0; i < MetricsShard::TYPE_BLOCK_SIZE; i++) {
+                    sums[i] += counts[i].load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+    
+    for (size_t c = 0; c < TYPE_COUNTER_COUNT; c++) {
+        for (size_t block = 0; block < MetricsShard::TYPE_BLOCKS; block++) {
+            const std::vector<uint64_t>& sums = type_counts[c][block];
+            for (size_t i = 0; i < sums.size(); i++) {
+                if (sums[i] > 0) {
+                    size_t type = block * MetricsShard::TYPE_BLOCK_SIZE + i;
+                    snapshot.by_type[c].push_back(std::make_pair(static_cast<uint16_t>(type), sums[i]));
+                }
+            }
+        }
+    }
+    
+    return snapshot;
+}
@@ -0,0 +1,228 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 查询服务器指标的保留TLV类型
+#define METRICS_TLV_TYPE 0xFFFF
+
+// 计数器
+enum class MetricCounter {
+    Accepts,             // accept成功的次数
+    ConnectionsOpened,   // 注册成功的连接数
+    ConnectionsClosed,   // 关闭的连接数
+    IdleTimeouts,        // 因空闲超时关闭的连接数
+    BytesReceived,       // 接收字节数
+    BytesSent,           // 发送字节数
+    MessagesReceived,    // 解析出的TLV消息数
+    MessagesSent,        // 投递成功的发送请求数
+    ReadCalls,           // 读取的系统调用次数（io_uring后端为recv完成事件数）
+    WriteCalls,          // 发送的系统调用次数（io_uring后端为sendmsg请求数）
+    PollWaits,           // 返回了事件的Wait次数
+    CompressIn,          // 尝试压缩的消息内容字节数
+    CompressOut,         // 上述消息实际发送的内容字节数（压缩后不变小的按原样计）
+    CompressNs,          // 压缩耗时（纳秒）
+    DecompressIn,        // 收到的压缩内容字节数
+    DecompressOut,       // 解压后的字节数
+    DecompressNs,        // 解压耗时（纳秒）
+    FileBytesSent,       // 用sendfile发送的文件内容字节数（同时计入BytesSent）
+    Count
+};
+
+// 直方图
+enum class MetricHistogram {
+    PollBatchSize,       // 每次Wait返回的事件数
+    SendQueueBytes,      // 入队后发送队列中的字节数
+    ParseToCallbackNs,   // 消息解析完成到进入消息回调的时间（纳秒）
+    EnqueueToWriteNs,    // 发送队列从空变为非空到数据全部写出的时间（纳秒）
+    MessageBatchSize,    // 批量消息回调每次交付的消息数
+    Count
+};
+
+// 按消息类型的计数器
+enum class MetricTypeCounter {
+    Received,            // 解析出的消息数
+    Handled,             // 由按类型注册的处理函数处理的消息数
+    Unhandled,           // 没有注册处理函数（交给默认处理函数或丢弃）的消息数
+    Count
+};
+
+static const size_t COUNTER_COUNT = static_cast<size_t>(MetricCounter::Count);
+static const size_t HISTOGRAM_COUNT = static_cast<size_t>(MetricHistogram::Count);
+static const size_t TYPE_COUNTER_COUNT = static_cast<size_t>(MetricTypeCounter::Count);
+
+// 对数分桶：按最高有效位分段，每段再线性分为HISTOGRAM_SUB_COUNT/2个子桶，相对误差不超过1/8
+static const int HISTOGRAM_SUB_BITS = 4;
+static const uint64_t HISTOGRAM_SUB_COUNT = 1u << HISTOGRAM_SUB_BITS;
+static const size_t HISTOGRAM_BUCKETS = HISTOGRAM_SUB_COUNT + (64 - HISTOGRAM_SUB_BITS) * (HISTOGRAM_SUB_COUNT / 2);
+
+// 直方图快照
+struct HistogramSnapshot {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    std::vector<uint64_t> buckets;
+    
+    HistogramSnapshot() : count(0), sum(0), max(0), buckets(HISTOGRAM_BUCKETS, 0) {}
+    
+    // 分位数（0~1），返回所在桶的中点
+    uint64_t Percentile(double p) const;
+    
+    // 平均值
+    double Mean() const;
+};
+
+// 各线程汇总后的指标快照
+struct MetricsSnapshot {
+    uint64_t counters[COUNTER_COUNT];
+    HistogramSnapshot histograms[HISTOGRAM_COUNT];
+    std::vector<std::pair<uint16_t, uint64_t> > by_type[TYPE_COUNTER_COUNT];  // 按类型排序，只含非0项
+    std::vector<std::pair<std::string, uint64_t> > gauges;                     // 由服务器补充的瞬时值
+    
+    MetricsSnapshot();
+    
+    uint64_t Get(MetricCounter counter) const {
+        return counters[static_cast<size_t>(counter)];
+    }
+    
+    const HistogramSnapshot& Get(MetricHistogram histogram) const {
+        return histograms[static_cast<size_t>(histogram)];
+    }
+    
+    const std::vector<std::pair<uint16_t, uint64_t> >& Get(MetricTypeCounter counter) const {
+        return by_type[static_cast<size_t>(counter)];
+    }
+    
+    // 格式化为Prometheus文本格式，每行一个指标
+    std::string ToText() const;
+};
+
+// 单个线程的指标
+//
+// 只有所属线程写入，写入是普通的load+store，不使用带锁前缀的原子指令；
+// 读取方用relaxed读取，可能看到稍旧的值但不会读到撕裂的值。
+struct MetricsShard {
+    // 按消息类型计数，每块256个类型，首次出现时分配
+    static const size_t TYPE_BLOCK_SIZE = 256;
+    static const size_t TYPE_BLOCKS = 65536 / TYPE_BLOCK_SIZE;
+    
+    struct HistogramData {
+        std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+    
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+    HistogramData histograms[HISTOGRAM_COUNT];
+    std::atomic<std::atomic<uint64_t>*> type_blocks[TYPE_COUNTER_COUNT][TYPE_BLOCKS];
+    
+    MetricsShard();
+    ~MetricsShard();
+    
+    void Add(MetricCounter counter, uint64_t n) {
+        Bump(counters[static_cast<size_t>(counter)], n);
+    }
+    
+    void AddType(MetricTypeCounter counter, uint16_t type) {
+        std::atomic<std::atomic<uint64_t>*>& slot = type_blocks[static_cast<size_t>(counter)][type / TYPE_BLOCK_SIZE];
+        std::atomic<uint64_t>* block = slot.load(std::memory_order_relaxed);
+        if (!block) {
+            block = AllocateTypeBlock(slot);
+        }
+        Bump(block[type % TYPE_BLOCK_SIZE], 1);
+    }
+    
+    void Record(MetricHistogram histogram, uint64_t value) {
+        HistogramData& data = histograms[static_cast<size_t>(histogram)];
+        Bump(data.buckets[BucketIndex(value)], 1);
+        Bump(data.count, 1);
+        Bump(data.sum, value);
+        if (value > data.max.load(std::memory_order_relaxed)) {
+            data.max.store(value, std::memory_order_relaxed);
+        }
+    }
+    
+    // 值所在的桶
+    static size_t BucketIndex(uint64_t value) {
+        if (value < HISTOGRAM_SUB_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        
+        int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS + 1;
+        uint64_t top = value >> shift;  // [SUB_COUNT/2, SUB_COUNT)
+        return static_cast<size_t>(HISTOGRAM_SUB_COUNT + (shift - 1) * (HISTOGRAM_SUB_COUNT / 2) +
+                                   (top - HISTOGRAM_SUB_COUNT / 2));
+    }
+    
+    // 桶的中点
+    static uint64_t BucketValue(size_t index);
+
+private:
+    static void Bump(std::atomic<uint64_t>& value, uint64_t n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    
+    std::atomic<uint64_t>* AllocateTypeBlock(std::atomic<std::atomic<uint64_t>*>& slot);
+    
+    MetricsShard(const MetricsShard&);
+    MetricsShard& operator=(const MetricsShard&);
+};
+
+// 指标注册表
+//
+// 每个写入指标的线程（reactor、acceptor、处理线程或调用SendMessage的外部线程）
+// 第一次写入时分配自己的分片，之后通过线程局部缓存直接定位，IO路径上不加锁、
+// 不争用缓存行。读取时遍历所有分片求和。线程退出后分片保留，累计值不会回退。
+class MetricsRegistry {
+public:
+    MetricsRegistry();
+    ~MetricsRegistry();
+    
+    // 当前线程的分片
+    MetricsShard* Local() {
+        if (t_cache.registry_id == m_id) {
+            return t_cache.shard;
+        }
+        return LocalSlow();
+    }
+    
+    void Add(MetricCounter counter, uint64_t n = 1) {
+        Local()->Add(counter, n);
+    }
+    
+    void Record(MetricHistogram histogram, uint64_t value) {
+        Local()->Record(histogram, value);
+    }
+    
+    // 汇总所有分片
+    MetricsSnapshot Snapshot() const;
+
+private:
+    struct LocalCache {
+        uint64_t registry_id;
+        MetricsShard* shard;
+    };
+    
+    MetricsShard* LocalSlow();
+    
+    MetricsRegistry(const MetricsRegistry&);
+    MetricsRegistry& operator=(const MetricsRegistry&);
+    
+    static thread_local LocalCache t_cache;
+    
+    uint64_t m_id;  // 全局唯一，线程局部缓存据此判断是否属于本注册表
+    mutable std::mutex m_mutex;
+    std::map<std::thread::id, std::unique_ptr<MetricsShard> > m_shards;
+};
+
+#endif // METRICS_H
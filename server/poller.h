@@ -0,0 +1,83 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <sys/uio.h>
+#include <stdint.h>
+#include <memory>
+
+// IO多路复用后端
+enum class PollerType {
+    Epoll,     // epoll就绪通知，由服务器自己read/sendmsg（默认）
+    IoUring    // io_uring：多次触发的accept/recv、提供缓冲区环、批量提交发送
+};
+
+// 事件类型
+enum class PollEventType {
+    Ready,      // fd就绪（events为EPOLLIN/EPOLLOUT/EPOLLERR/EPOLLHUP）
+    Accepted,   // StartAccept接受了新连接（result为新连接fd或-errno）
+    Received,   // StartRecv收到数据（result为字节数，0表示对端关闭，负数为-errno）
+    Sent        // Send完成（result为发送的字节数或-errno）
+};
+
+// Wait返回的事件
+struct PollEvent {
+    PollEventType type;
+    int fd;             // 事件所属的fd（Accepted为监听套接字）
+    uint32_t events;    // Ready事件的就绪掩码
+    uint32_t tag;       // StartRecv/Send时传入的标记，用于识别fd被复用后的过期事件
+    int result;         // Accepted/Received/Sent的结果
+    const char* data;   // Received的数据，在下一次Wait之前有效
+    bool more;          // 多次触发的请求是否仍然有效，false时需要重新发起
+};
+
+// IO多路复用接口
+//
+// 所有后端都支持就绪通知（Add/Modify/Remove/Wait），事件循环对监听套接字、eventfd、
+// timerfd的处理与后端无关。SupportsAsyncIo()为true的后端还提供异步accept/recv/send，
+// 服务器在这种后端上由完成事件直接拿到数据，不再为每次读写发起系统调用。
+// 除Wait外的调用只是登记请求，实际提交可以延迟到下一次Wait，以便批量提交。
+class Poller {
+public:
+    virtual ~Poller() {}
+    
+    // 初始化，失败返回false
+    virtual bool Init() = 0;
+    
+    // 后端名称
+    virtual const char* Name() const = 0;
+    
+    // 注册fd的就绪通知
+    virtual bool Add(int fd, uint32_t events) = 0;
+    
+    // 修改fd关注的事件
+    virtual bool Modify(int fd, uint32_t events) = 0;
+    
+    // 取消fd的就绪通知
+    virtual bool Remove(int fd) = 0;
+    
+    // 等待事件，返回事件数，超时返回0，出错返回-1
+    virtual int Wait(PollEvent* events, int max_events, int timeout_ms) = 0;
+    
+    // 是否支持下面的异步IO接口
+    virtual bool SupportsAsyncIo() const { return false; }
+    
+    // 在监听套接字上持续接受新连接
+    virtual bool StartAccept(int) { return false; }
+    
+    // 在连接上持续接收数据
+    virtual bool StartRecv(int, uint32_t) { return false; }
+    
+    // 停止接收（已在途的数据仍会通过Received事件交付）
+    virtual bool CancelRecv(int, uint32_t) { return false; }
+    
+    // 发送iovec中的数据，完成前数据必须保持有效，owner在完成后释放
+    virtual bool Send(int, uint32_t, const struct iovec*, int, const std::shared_ptr<void>&) { return false; }
+    
+    // 取消fd上所有未完成的请求（关闭连接前调用）
+    virtual bool CancelAll(int) { return false; }
+};
+
+// 创建指定类型的后端，不支持时返回nullptr
+std::unique_ptr<Poller> CreatePoller(PollerType type);
+
+#endif // POLLER_H
@@ -0,0 +1,141 @@
+#include "recv_buffer.h"
+#include <unistd.h>
+#include <sys/uio.h>
+#include <cstring>
+
+RecvBuffer::RecvBuffer(size_t initial_size)
+    : m_buffer(initial_size), m_read_index(0), m_write_index(0) {
+}
+
+RecvBuffer::~RecvBuffer() {
+}
+
+size_t RecvBuffer::ReadableBytes() const {
+    return m_write_index - m_read_index;
+}
+
+size_t RecvBuffer::WritableBytes() const {
+    return m_buffer.size() - m_write_index;
+}
+
+const char* RecvBuffer::Peek() const {
+    return m_buffer.data() + m_read_index;
+}
+
+void RecvBuffer::Retrieve(size_t len) {
+    if (len >= ReadableBytes()) {
+        RetrieveAll();
+        return;
+    }
+    
+    m_read_index += len;
+}
+
+void RecvBuffer::RetrieveAll() {
+    // 数据全部消费后游标归零，下次读取从头开始，无需搬移
+    m_read_index = 0;
+    m_write_index = 0;
+}
+
+char* RecvBuffer::BeginWrite() {
+    return m_buffer.data() + m_write_index;
+}
+
+void RecvBuffer::HasWritten(size_t len) {
+    m_write_index += len;
+}
+
+void RecvBuffer::EnsureWritable(size_t len) {
+    if (WritableBytes() < len) {
+        MakeSpace(len);
+    }
+}
+
+ssize_t RecvBuffer::ReadFromFd(int fd, size_t max_len) {
+    EnsureWritable(max_len);
+    
+    ssize_t n = read(fd, BeginWrite(), WritableBytes());
+    if (n > 0) {
+        HasWritten(static_cast<size_t>(n));
+    }
+    
+    return n;
+}
+
+/**
+ * @brief 一次readv读入可写区和调用方提供的备用区。
+ *
+ * 可写区只按连接平时的读取量预留，突发的大块数据先落到备用区（通常在栈上），
+ * 再追加到缓冲区中，一次系统调用就能读完内核中的数据，平时又不必为每个连接
+ * 保留大块内存。
+ */
+ssize_t RecvBuffer::ReadvFromFd(int fd, char* spare, size_t spare_len) {
+    size_t writable = WritableBytes();
+    
+    struct iovec iov[2];
+    iov[0].iov_base = BeginWrite();
+    iov[0].iov_len = writable;
+    iov[1].iov_base = spare;
+    iov[1].iov_len = spare_len;
+    
+    ssize_t n = readv(fd, iov, spare_len > 0 ? 2 : 1);
+    if (n <= 0) {
+        return n;
+    }
+    
+    if (static_cast<size_t>(n) <= writable) {
+        HasWritten(static_cast<size_t>(n));
+    } else {
+        HasWritten(writable);
+        Append(spare, static_cast<size_t>(n) - writable);
+    }
+    
+    return n;
+}
+
+void RecvBuffer::Append(const char* data, size_t len) {
+    EnsureWritable(len);
+    memcpy(BeginWrite(), data, len);
+    HasWritten(len);
+}
+
+size_t RecvBuffer::Capacity() const {
+    return m_buffer.size();
+}
+
+void RecvBuffer::Shrink(size_t max_size) {
+    if (ReadableBytes() > 0 || m_buffer.size() <= max_size) {
+        return;
+    }
+    
+    // 旧存储归还给缓冲区池
+    PooledBytes(max_size).swap(m_buffer);
+    m_read_index = 0;
+    m_write_index = 0;
+}
+
+/**
+ * @brief 为写入len字节腾出空间。
+ *
+ * 先把未读数据搬到头部回收已消费的空间；仍不够时按当前大小翻倍扩容
+ * （至少满足本次需求）。
+ */
+void RecvBuffer::MakeSpace(size_t len) {
+    if (m_read_index > 0) {
+        size_t readable = ReadableBytes();
+        memmove(m_buffer.data(), m_buffer.data() + m_read_index, readable);
+        m_read_index = 0;
+        m_write_index = readable;
+    }
+    
+    if (WritableBytes() >= len) {
+        return;
+    }
+    
+    size_t new_size = m_buffer.size() * 2;
+    if (new_size < m_write_index + len) {
+        new_size = m_write_index + len;
+    }
+    
+    m_buffer.resize(new_size);
+}
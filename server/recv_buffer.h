@@ -0,0 +1,72 @@
+#ifndef RECV_BUFFER_H
+#define RECV_BUFFER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <vector>
+#include "buffer_pool.h"
+
+// 连接接收缓冲区
+//
+// 连续存储 + 读写游标：套接字数据直接读入可写区，解析完成的数据只前移读游标。
+// 读游标追上写游标时两者归零；可写空间不足时先把未读数据搬到头部，
+// 仍不够再扩容，因此每个字节最多被搬移常数次，不会因逐条消费而退化成平方复杂度。
+//
+//   +-------------------+------------------+------------------+
+//   |   已消费(可回收)   |   可读(待解析)    |      可写         |
+//   +-------------------+------------------+------------------+
+//   0             m_read_index      m_write_index         size()
+class RecvBuffer {
+public:
+    explicit RecvBuffer(size_t initial_size = 4096);
+    ~RecvBuffer();
+    
+    // 可读字节数
+    size_t ReadableBytes() const;
+    
+    // 可写字节数
+    size_t WritableBytes() const;
+    
+    // 可读数据起始位置
+    const char* Peek() const;
+    
+    // 消费len字节（只移动读游标）
+    void Retrieve(size_t len);
+    
+    // 消费全部可读数据
+    void RetrieveAll();
+    
+    // 可写区起始位置
+    char* BeginWrite();
+    
+    // 确认写入了len字节
+    void HasWritten(size_t len);
+    
+    // 保证至少有len字节可写空间
+    void EnsureWritable(size_t len);
+    
+    // 从fd直接读入可写区，返回read的结果，出错时errno由调用方查看
+    ssize_t ReadFromFd(int fd, size_t max_len);
+    
+    // 用readv读入现有可写区和spare，超出可写区的部分再追加进来，返回readv的结果
+    ssize_t ReadvFromFd(int fd, char* spare, size_t spare_len);
+    
+    // 追加len字节数据（数据已由内核写入其他缓冲区时使用）
+    void Append(const char* data, size_t len);
+    
+    // 当前容量
+    size_t Capacity() const;
+    
+    // 没有可读数据且容量超过max_size时，把底层存储缩小到max_size
+    void Shrink(size_t max_size);
+    
+private:
+    // 回收已消费空间或扩容
+    void MakeSpace(size_t len);
+    
+    PooledBytes m_buffer;        // 底层存储（从缓冲区池分配）
+    size_t m_read_index;         // 读游标
+    size_t m_write_index;        // 写游标
+};
+
+#endif // RECV_BUFFER_H
@@ -0,0 +1,340 @@
+#include "timer_wheel.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+
+// 定时器ID的布局：低24位为节点下标+1，其上32位为节点代数，最高8位留给调用方
+static const int INDEX_BITS = 24;
+static const uint64_t INDEX_MASK = (static_cast<uint64_t>(1) << INDEX_BITS) - 1;
+static const int GENERATION_SHIFT = INDEX_BITS;
+static const size_t MAX_NODES = INDEX_MASK;
+
+// 获取单调时钟的毫秒数
+static int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TimerWheel::TimerWheel()
+    : m_timer_fd(-1), m_tick_ms(1), m_start_ms(0), m_current_tick(0), m_armed_tick(0),
+      m_timer_count(0) {
+    for (uint32_t i = 0; i < LEVEL_COUNT * SLOT_COUNT; i++) {
+        m_slots[i] = NIL;
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    if (m_timer_fd != -1) {
+        close(m_timer_fd);
+    }
+}
+
+bool TimerWheel::Init(int tick_ms) {
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_timer_fd == -1) {
+        std::cerr << "Failed to create timerfd: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    m_tick_ms = tick_ms > 0 ? tick_ms : 1;
+    m_start_ms = NowMs();
+    m_current_tick = 0;
+    m_armed_tick = 0;
+    return true;
+}
+
+int TimerWheel::GetFd() const {
+    return m_timer_fd;
+}
+
+TimerId TimerWheel::RunAfter(int64_t delay_ms, Callback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return AddTimer(delay_ms, 0, std::move(callback));
+}
+
+TimerId TimerWheel::RunEvery(int64_t interval_ms, Callback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return AddTimer(interval_ms, interval_ms > 0 ? interval_ms : 1, std::move(callback));
+}
+
+TimerId TimerWheel::AddTimer(int64_t delay_ms, int64_t interval_ms, Callback callback) {
+    uint32_t index;
+    if (!m_free_nodes.empty()) {
+        index = m_free_nodes.back();
+        m_free_nodes.pop_back();
+    } else if (m_nodes.size() < MAX_NODES) {
+        index = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.push_back(Node());
+    } else {
+        return 0;
+    }
+    
+    // 到期时间按当前时间计算并向上取整到tick，至少在下一个tick
+    int64_t now = NowMs();
+    int64_t expire_ms = now + (delay_ms > 0 ? delay_ms : 0) - m_start_ms;
+    uint64_t expire_tick = static_cast<uint64_t>((expire_ms + m_tick_ms - 1) / m_tick_ms);
+    if (expire_tick <= m_current_tick) {
+        expire_tick = m_current_tick + 1;
+    }
+    
+    Node& node = m_nodes[index];
+    node.expire_tick = expire_tick;
+    node.interval_ticks = interval_ms > 0 ? static_cast<uint64_t>((interval_ms + m_tick_ms - 1) / m_tick_ms) : 0;
+    node.active = true;
+    node.running = false;
+    node.callback = std::move(callback);
+    Insert(index);
+    m_timer_count++;
+    
+    // 新定时器比timerfd当前的到期时间更早时重新设置
+    if (m_armed_tick == 0 || expire_tick < m_armed_tick) {
+        Rearm(now);
+    }
+    
+    return MakeId(index);
+}
+
+TimerId TimerWheel::MakeId(uint32_t index) const {
+    return (static_cast<uint64_t>(m_nodes[index].generation) << GENERATION_SHIFT) | (index + 1);
+}
+
+uint32_t TimerWheel::Lookup(TimerId id) const {
+    uint64_t low = id & INDEX_MASK;
+    if (low == 0 || low > m_nodes.size() || (id >> TIMER_ID_BITS) != 0) {
+        return NIL;
+    }
+    
+    uint32_t index = static_cast<uint32_t>(low - 1);
+    uint32_t generation = static_cast<uint32_t>(id >> GENERATION_SHIFT);
+    const Node& node = m_nodes[index];
+    if (!node.active || node.generation != generation) {
+        return NIL;
+    }
+    
+    return index;
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    uint32_t index = Lookup(id);
+    if (index == NIL) {
+        return false;
+    }
+    
+    Node& node = m_nodes[index];
+    node.active = false;
+    
+    // 回调正在执行时由执行方释放节点
+    if (node.running) {
+        return true;
+    }
+    
+    Unlink(index);
+    FreeNode(index);
+    return true;
+}
+
+size_t TimerWheel::GetTimerCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_timer_count;
+}
+
+/**
+ * @brief 按到期tick与当前tick的差值选择层和槽。
+ *
+ * 差值小于256放在第0层，以到期tick的低8位为槽号；否则放到能容纳该差值的最低层，
+ * 以到期tick对应的8位为槽号，等第0层转到对应位置时再级联下来。
+ */
+void TimerWheel::Insert(uint32_t index) {
+    Node& node = m_nodes[index];
+    uint64_t diff = node.expire_tick > m_current_tick ? node.expire_tick - m_current_tick : 0;
+    
+    int level = 0;
+    while (level < LEVEL_COUNT - 1 && diff >= (static_cast<uint64_t>(1) << (LEVEL_BITS * (level + 1)))) {
+        level++;
+    }
+    
+    // 超出最大范围的定时器放在最高层的最远处，级联时再重新计算
+    uint64_t tick = node.expire_tick;
+    if (diff >= (static_cast<uint64_t>(1) << (LEVEL_BITS * LEVEL_COUNT))) {
+        tick = m_current_tick + (static_cast<uint64_t>(1) << (LEVEL_BITS * LEVEL_COUNT)) - 1;
+    } else if (diff == 0) {
+        tick = m_current_tick;
+    }
+    
+    uint32_t slot = static_cast<uint32_t>(level) * SLOT_COUNT +
+                    static_cast<uint32_t>((tick >> (LEVEL_BITS * level)) & SLOT_MASK);
+    
+    node.slot = slot;
+    node.prev = NIL;
+    node.next = m_slots[slot];
+    if (node.next != NIL) {
+        m_nodes[node.next].prev = index;
+    }
+    m_slots[slot] = index;
+}
+
+void TimerWheel::Unlink(uint32_t index) {
+    Node& node = m_nodes[index];
+    if (node.slot == NIL) {
+        return;
+    }
+    
+    if (node.prev != NIL) {
+        m_nodes[node.prev].next = node.next;
+    } else {
+        m_slots[node.slot] = node.next;
+    }
+    
+    if (node.next != NIL) {
+        m_nodes[node.next].prev = node.prev;
+    }
+    
+    node.prev = NIL;
+    node.next = NIL;
+    node.slot = NIL;
+}
+
+void TimerWheel::FreeNode(uint32_t index) {
+    Node& node = m_nodes[index];
+    node.active = false;
+    node.running = false;
+    node.callback = Callback();
+    node.generation++;
+    m_free_nodes.push_back(index);
+    m_timer_count--;
+}
+
+void TimerWheel::Cascade(int level, uint32_t slot) {
+    uint32_t head = m_slots[level * SLOT_COUNT + slot];
+    m_slots[level * SLOT_COUNT + slot] = NIL;
+    
+    while (head != NIL) {
+        uint32_t next = m_nodes[head].next;
+        m_nodes[head].slot = NIL;
+        Insert(head);
+        head = next;
+    }
+}
+
+void TimerWheel::Advance(int64_t now_ms) {
+    uint64_t target = static_cast<uint64_t>((now_ms - m_start_ms) / m_tick_ms);
+    
+    while (m_current_tick < target) {
+        m_current_tick++;
+    
+        // 第0层转完一圈，依次把上层对应槽中的定时器分配下来
+        for (int level = 1; level < LEVEL_COUNT; level++) {
+            uint32_t shift = LEVEL_BITS * level;
+            if ((m_current_tick & ((static_cast<uint64_t>(1) << shift) - 1)) != 0) {
+                break;
+            }
+            Cascade(level, static_cast<uint32_t>((m_current_tick >> shift) & SLOT_MASK));
+        }
+    
+        // 取出第0层当前槽中到期的定时器
+        uint32_t slot = static_cast<uint32_t>(m_current_tick & SLOT_MASK);
+        uint32_t head = m_slots[slot];
+        m_slots[slot] = NIL;
+    
+        while (head != NIL) {
+            Node& node = m_nodes[head];
+            uint32_t next = node.next;
+            node.prev = NIL;
+            node.next = NIL;
+            node.slot = NIL;
+            m_expired.push_back(MakeId(head));
+            head = next;
+        }
+    }
+}
+
+/**
+ * @brief 设置timerfd在最近一个非空槽或下一个级联点到期。
+ */
+void TimerWheel::Rearm(int64_t now_ms) {
+    uint64_t next_tick = 0;
+    
+    if (m_timer_count > 0) {
+        for (uint64_t tick = m_current_tick + 1; ; tick++) {
+            if (m_slots[tick & SLOT_MASK] != NIL || (tick & SLOT_MASK) == 0) {
+                next_tick = tick;
+                break;
+            }
+        }
+    }
+    
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    
+    if (next_tick != 0) {
+        int64_t delay_ms = m_start_ms + static_cast<int64_t>(next_tick) * m_tick_ms - now_ms;
+        if (delay_ms < 1) {
+            delay_ms = 1;
+        }
+        spec.it_value.tv_sec = delay_ms / 1000;
+        spec.it_value.tv_nsec = (delay_ms % 1000) * 1000000;
+    }
+    
+    // it_value全为0时停止timerfd
+    if (timerfd_settime(m_timer_fd, 0, &spec, nullptr) == -1) {
+        std::cerr << "Failed to arm timerfd: " << strerror(errno) << std::endl;
+    }
+    
+    m_armed_tick = next_tick;
+}
+
+/**
+ * @brief 处理timerfd到期：推进时间轮，依次执行到期的回调。
+ *
+ * 回调在锁外执行。周期定时器执行完后按周期重新放回时间轮，
+ * 执行期间被取消的定时器不再放回。
+ */
+void TimerWheel::HandleExpired() {
+    uint64_t expirations = 0;
+    while (read(m_timer_fd, &expirations, sizeof(expirations)) == -1 && errno == EINTR) {
+    }
+    
+    std::vector<TimerId> expired;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Advance(NowMs());
+        expired.swap(m_expired);
+    }
+    
+    for (TimerId id : expired) {
+        Callback callback;
+        uint32_t index;
+        {
+            // 前面的回调可能已取消这个定时器，节点甚至已被新定时器复用
+            std::lock_guard<std::mutex> lock(m_mutex);
+            index = Lookup(id);
+            if (index == NIL) {
+                continue;
+            }
+            Node& node = m_nodes[index];
+            node.running = true;
+            callback = std::move(node.callback);
+        }
+    
+        callback();
+    
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Node& node = m_nodes[index];
+        if (node.active && node.interval_ticks > 0) {
+            node.running = false;
+            node.callback = std::move(callback);
+            node.expire_tick = m_current_tick + node.interval_ticks;
+            Insert(index);
+        } else {
+            FreeNode(index);
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Rearm(NowMs());
+}
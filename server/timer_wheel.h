@@ -0,0 +1,122 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// 定时器ID，0表示无效。低TIMER_ID_BITS位由TimerWheel使用，其上的位留给调用方
+typedef uint64_t TimerId;
+
+#define TIMER_ID_BITS 56
+
+// 分层时间轮定时器
+//
+// 4层、每层256个槽，第0层每槽一个tick，上一层每槽覆盖下一层一整圈，最多可表示
+// 2^32个tick。添加和取消都是O(1)：定时器节点放在连续数组中，用下标组成双向链表，
+// 定时器ID由节点下标（24位，每个时间轮最多2^24-1个定时器）和完整的32位代数组成，
+// 取消时直接定位节点，节点复用2^32次之前旧ID不会与新定时器混淆。第0层转完一圈时
+// 把上一层对应槽中的定时器重新分配到下层（级联）。
+//
+// 时间轮由timerfd驱动：timerfd只在最近一个非空槽或级联点到期时触发，没有定时器时
+// 完全不唤醒事件循环，大量长周期定时器（如每个连接一个的空闲超时）几乎不占CPU。
+//
+// 添加和取消可以在任意线程调用；回调只在调用HandleExpired的线程（事件循环线程）中执行，
+// 执行回调时不持有内部锁，回调中可以添加或取消定时器。
+class TimerWheel {
+public:
+    typedef std::function<void()> Callback;
+    
+    TimerWheel();
+    ~TimerWheel();
+    
+    // 创建timerfd，tick_ms为时间轮精度（毫秒）
+    bool Init(int tick_ms);
+    
+    // timerfd，需注册到epoll（EPOLLIN）
+    int GetFd() const;
+    
+    // delay_ms毫秒后执行一次callback，定时器数量达到上限时返回0
+    TimerId RunAfter(int64_t delay_ms, Callback callback);
+    
+    // 每隔interval_ms毫秒执行一次callback，第一次在interval_ms后
+    TimerId RunEvery(int64_t interval_ms, Callback callback);
+    
+    // 取消定时器，定时器不存在或已执行完返回false
+    bool Cancel(TimerId id);
+    
+    // timerfd可读时调用：推进时间轮并执行到期的回调
+    void HandleExpired();
+    
+    // 当前定时器数量
+    size_t GetTimerCount() const;
+
+private:
+    static const int LEVEL_COUNT = 4;
+    static const int LEVEL_BITS = 8;
+    static const uint32_t SLOT_COUNT = 1u << LEVEL_BITS;
+    static const uint32_t SLOT_MASK = SLOT_COUNT - 1;
+    static const uint32_t NIL = 0xFFFFFFFFu;
+    
+    // 定时器节点，prev/next为节点数组下标
+    struct Node {
+        uint64_t expire_tick;     // 到期的tick
+        uint64_t interval_ticks;  // 周期（0表示只执行一次）
+        uint32_t prev;
+        uint32_t next;
+        uint32_t slot;            // 所在槽的编号（层号*SLOT_COUNT+槽号），NIL表示不在轮上
+        uint32_t generation;      // 节点复用次数，用于识别过期的定时器ID
+        bool active;              // 是否有效（未取消、未执行完）
+        bool running;             // 回调是否正在执行
+        Callback callback;
+    
+        Node()
+            : expire_tick(0), interval_ticks(0), prev(NIL), next(NIL), slot(NIL),
+              generation(0), active(false), running(false) {}
+    };
+    
+    // 添加定时器（调用方持有锁）
+    TimerId AddTimer(int64_t delay_ms, int64_t interval_ms, Callback callback);
+    
+    // 根据到期时间把节点放入对应的槽（调用方持有锁）
+    void Insert(uint32_t index);
+    
+    // 把节点从所在的槽中摘下（调用方持有锁）
+    void Unlink(uint32_t index);
+    
+    // 释放节点（调用方持有锁）
+    void FreeNode(uint32_t index);
+    
+    // 把一个槽中的定时器重新分配到下层（调用方持有锁）
+    void Cascade(int level, uint32_t slot);
+    
+    // 推进到now_ms对应的tick，收集到期的定时器（调用方持有锁）
+    void Advance(int64_t now_ms);
+    
+    // 按最近的到期时间设置timerfd（调用方持有锁）
+    void Rearm(int64_t now_ms);
+    
+    // 节点当前的定时器ID（调用方持有锁）
+    TimerId MakeId(uint32_t index) const;
+    
+    // 根据ID查找节点，无效时返回NIL（调用方持有锁）
+    uint32_t Lookup(TimerId id) const;
+    
+    int m_timer_fd;
+    int64_t m_tick_ms;
+    int64_t m_start_ms;           // 第0个tick对应的时间
+    uint64_t m_current_tick;      // 已处理到的tick
+    uint64_t m_armed_tick;        // timerfd设置的到期tick（0表示未设置）
+    
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_free_nodes;
+    uint32_t m_slots[LEVEL_COUNT * SLOT_COUNT];  // 各槽链表头
+    size_t m_timer_count;
+    
+    std::vector<TimerId> m_expired;   // 本次到期、等待执行的定时器
+    mutable std::mutex m_mutex;
+};
+
+#endif // TIMER_WHEEL_H
@@ -1,7 +1,114 @@
 #include "tlv_protocol.h"
+#include "lz_codec.h"
 #include <cstring>
 
-TLVProtocol::TLVProtocol() {
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// v2头部中类型和长度varint的最大字节数
+static const int V2_TYPE_BYTES = 3;
+static const int V2_LENGTH_BYTES = 5;
+
+// 扫描v2头部时一次计算最高位图的字节数
+static const size_t SCAN_BLOCK_SIZE = 64;
+
+/**
+ * @brief 解码p开始的varint，最多max_bytes字节。
+ *
+ * 返回占用的字节数；end之前数据不足时返回0；max_bytes字节内仍未结束时返回-1（格式错误）。
+ */
+static inline int ReadVarint(const unsigned char* p, const unsigned char* end, int max_bytes, uint64_t& value) {
+    value = 0;
+    for (int i = 0; i < max_bytes; i++) {
+        if (p + i >= end) {
+            return 0;
+        }
+        value |= static_cast<uint64_t>(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+// 按小端顺序读取8个字节，第一个字节在最低位
+static inline uint64_t Load64LE(const unsigned char* p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+// 把word低位bytes（1~5）个字节的varint拼成整数，各字节去掉最高位后移到一起，不逐字节循环
+static inline uint64_t CompactVarint(uint64_t word, int bytes) {
+    word &= ~0ull >> (64 - 8 * bytes);
+    return (word & 0x7F) | ((word >> 1) & 0x3F80) | ((word >> 2) & 0x1FC000) |
+           ((word >> 3) & 0xFE00000) | ((word >> 4) & 0x7F0000000ull);
+}
+
+// 8个字节的最高位收集到低8位（第i位对应第i个字节）
+static inline uint64_t HighBits8(uint64_t word) {
+    return ((word & 0x8080808080808080ull) * 0x0002040810204081ull) >> 56;
+}
+
+static inline size_t WriteVarint(char* output, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        output[n++] = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    output[n++] = static_cast<char>(value);
+    return n;
+}
+
+// 64字节中每个字节的最高位组成的位图，第i位对应p[i]
+typedef uint64_t (*HighBitMaskFunction)(const unsigned char* p);
+
+#if defined(__x86_64__)
+// x86-64总是支持SSE2：pmovmskb一次取出16个字节的最高位
+static uint64_t HighBitMaskSse2(const unsigned char* p) {
+    uint64_t m0 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+    uint64_t m1 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16))));
+    uint64_t m2 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32))));
+    uint64_t m3 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48))));
+    return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+// AVX2一次32个字节，只为这个函数开启AVX2，运行时确认CPU支持后才会调用
+__attribute__((target("avx2")))
+static uint64_t HighBitMaskAvx2(const unsigned char* p) {
+    uint64_t lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))));
+    uint64_t hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32))));
+    return lo | (hi << 32);
+}
+#else
+static uint64_t HighBitMaskScalar(const unsigned char* p) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < SCAN_BLOCK_SIZE; i++) {
+        mask |= static_cast<uint64_t>(p[i] >> 7) << i;
+    }
+    return mask;
+}
+#endif
+
+static HighBitMaskFunction SelectHighBitMask() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &HighBitMaskAvx2;
+    }
+    return &HighBitMaskSse2;
+#else
+    return &HighBitMaskScalar;
+#endif
+}
+
+static const HighBitMaskFunction g_high_bit_mask = SelectHighBitMask();
+
+TLVProtocol::TLVProtocol() : m_format(TLVFormat::V1), m_compression(false) {
     // 默认使用网络字节序（大端）
     m_converter.SetByteOrder(ByteOrder::BigEndian);
 }
@@ -10,6 +117,37 @@ TLVProtocol::~TLVProtocol() {
 }
 
 bool TLVProtocol::ParseMessage(const char* data, size_t len, TLVMessage& msg, size_t& consumed) {
+    TLVView view;
+    if (!ParseView(data, len, view, consumed)) {
+        return false;
+    }
+    
+    msg.type = view.type;
+    
+    if (view.compressed) {
+        std::vector<char> inflated;
+        TLVView plain;
+        if (!Decompress(view, inflated, plain)) {
+            return false;
+        }
+        msg.length = plain.length;
+        msg.value.assign(plain.value, plain.value + plain.length);
+        return true;
+    }
+    
+    msg.length = view.length;
+    
+    // 解析值
+    msg.value.assign(view.value, view.value + view.length);
+    
+    return true;
+}
+
+bool TLVProtocol::ParseView(const char* data, size_t len, TLVView& view, size_t& consumed) {
+    if (m_format == TLVFormat::V2) {
+        return ParseViewV2(data, len, view, consumed);
+    }
+    
     // 检查数据长度是否足够解析头部
     if (len < TLV_HEADER_SIZE) {
         consumed = 0;
@@ -19,51 +157,363 @@ bool TLVProtocol::ParseMessage(const char* data, size_t len, TLVMessage& msg, si
     // 解析类型（2字节）
     uint16_t type;
     memcpy(&type, data, sizeof(type));
-    msg.type = m_converter.Convert16(type);
     
     // 解析长度（4字节）
     uint32_t length;
     memcpy(&length, data + sizeof(type), sizeof(length));
-    msg.length = m_converter.Convert32(length);
+    length = m_converter.Convert32(length);
+    bool compressed = (length & TLV_COMPRESSED_FLAG) != 0;
+    length &= ~TLV_COMPRESSED_FLAG;
+    
+    // 未启用压缩时最高位属于保留位，不能当作长度的一部分
+    if (compressed && !m_compression) {
+        consumed = 1;
+        return false;
+    }
     
     // 检查数据长度是否足够解析完整消息
-    if (len < TLV_HEADER_SIZE + msg.length) {
+    if (len - TLV_HEADER_SIZE < length) {
         consumed = 0;
         return false;
     }
     
-    // 解析值
-    msg.value.assign(data + TLV_HEADER_SIZE, data + TLV_HEADER_SIZE + msg.length);
+    view.type = m_converter.Convert16(type);
+    view.length = length;
+    view.value = data + TLV_HEADER_SIZE;
+    view.compressed = compressed;
     
     // 设置已消费的字节数
-    consumed = TLV_HEADER_SIZE + msg.length;
+    consumed = TLV_HEADER_SIZE + length;
     
     return true;
 }
 
-bool TLVProtocol::SerializeMessage(const TLVMessage& msg, std::vector<char>& output) {
-    // 计算总长度
-    size_t total_size = TLV_HEADER_SIZE + msg.length;
+/**
+ * @brief 解析v2格式的消息视图。
+ *
+ * 类型超过3字节或超过16位、长度字段超过5字节或超过32位时为格式错误，
+ * consumed置为1（不为0）以区别于数据不足。
+ */
+bool TLVProtocol::ParseViewV2(const char* data, size_t len, TLVView& view, size_t& consumed) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = p + len;
+    consumed = 0;
     
-    // 调整输出缓冲区大小   
-    output.resize(total_size);
+    uint64_t type;
+    int type_bytes = ReadVarint(p, end, V2_TYPE_BYTES, type);
+    if (type_bytes <= 0 || type > 0xFFFF) {
+        consumed = (type_bytes < 0 || type > 0xFFFF) ? 1 : 0;
+        return false;
+    }
     
-    // 序列化类型（2字节）
-    uint16_t type = m_converter.Convert16(msg.type);
-    memcpy(output.data(), &type, sizeof(type));
+    uint64_t field;
+    int length_bytes = ReadVarint(p + type_bytes, end, V2_LENGTH_BYTES, field);
+    if (length_bytes <= 0 || field > 0xFFFFFFFFull) {
+        consumed = (length_bytes < 0 || field > 0xFFFFFFFFull) ? 1 : 0;
+        return false;
+    }
     
-    // 序列化长度（4字节）
-    uint32_t length = m_converter.Convert32(msg.length);
-    memcpy(output.data() + sizeof(type), &length, sizeof(length));
+    size_t header = static_cast<size_t>(type_bytes + length_bytes);
+    uint32_t length = static_cast<uint32_t>(field >> 1);
+    if (len - header < length) {
+        return false;
+    }
     
-    // 序列化值
-    if (msg.length > 0) {
-        memcpy(output.data() + TLV_HEADER_SIZE, msg.value.data(), msg.length);
+    view.type = static_cast<uint16_t>(type);
+    view.length = length;
+    view.value = data + header;
+    view.compressed = (field & 1) != 0;
+    consumed = header + length;
+    return true;
+}
+
+/**
+ * @brief 批量找出完整消息的边界。
+ *
+ * 相比逐条调用ParseView，省去每条消息的函数调用和格式判断。v1头部定长，
+ * 每条消息的位置取决于上一条的长度，只能顺序读取长度字段；v2见ScanFramesV2。
+ */
+size_t TLVProtocol::ScanFrames(const char* data, size_t len, TLVView* views, size_t max_views,
+                               size_t& consumed, bool& malformed) {
+    malformed = false;
+    if (m_format == TLVFormat::V2) {
+        return ScanFramesV2(data, len, views, max_views, consumed, malformed);
     }
     
+    size_t offset = 0;
+    size_t count = 0;
+    while (count < max_views && len - offset >= TLV_HEADER_SIZE) {
+        uint16_t type;
+        uint32_t length;
+        memcpy(&type, data + offset, sizeof(type));
+        memcpy(&length, data + offset + sizeof(type), sizeof(length));
+        length = m_converter.Convert32(length);
+        bool compressed = (length & TLV_COMPRESSED_FLAG) != 0;
+        length &= ~TLV_COMPRESSED_FLAG;
+        
+        if (compressed && !m_compression) {
+            malformed = true;
+            break;
+        }
+        
+        if (len - offset - TLV_HEADER_SIZE < length) {
+            break;
+        }
+        
+        TLVView& view = views[count++];
+        view.type = m_converter.Convert16(type);
+        view.length = length;
+        view.value = data + offset + TLV_HEADER_SIZE;
+        view.compressed = compressed;
+        offset += TLV_HEADER_SIZE + length;
+    }
+    
+    consumed = offset;
+    return count;
+}
+
+/**
+ * @brief 批量找出v2消息的边界。
+ *
+ * 常见的2~3字节头部走可预测的快速路径。其他头部的两个varint都在开头8个字节内：先得到
+ * 这些字节最高位（续位）的位图，类型和长度的字节数各用一次计数尾零得到，再从一次8字节
+ * 读取中拼出两个值，不逐字节判断和循环，头部长短交错时也没有分支预测失败。
+ * 小消息时一个64字节块里有多个头部，用SIMD（SSE2，CPU支持时用AVX2）一次算出整块的位图
+ * 在块内复用；上一条消息不小于块的四分之一时下一个头部多半落在新块里，改为直接从这8个
+ * 字节收集续位。剩余不足8字节时逐字节解析。
+ */
+size_t TLVProtocol::ScanFramesV2(const char* data, size_t len, TLVView* views, size_t max_views,
+                                 size_t& consumed, bool& malformed) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    size_t offset = 0;
+    size_t count = 0;
+    size_t block_start = 0;
+    size_t block_end = 0;    // 位图覆盖[block_start, block_end)，初始为空
+    uint64_t block_mask = 0;
+    size_t last_frame = 0;   // 上一条消息的字节数
+    
+    while (count < max_views && offset < len) {
+        if (len - offset < TLV_V2_MAX_HEADER_SIZE) {
+            TLVView view;
+            size_t frame_size = 0;
+            if (!ParseViewV2(data + offset, len - offset, view, frame_size)) {
+                malformed = frame_size != 0;
+                break;
+            }
+            views[count++] = view;
+            offset += frame_size;
+            continue;
+        }
+        
+        // 类型小于128（1字节）且长度小于8192（长度字段1~2字节）是最常见的头部，直接取出；
+        // 同类消息的头部长度相同，这里的分支几乎总能预测正确
+        if (!(p[offset] & 0x80)) {
+            size_t header = 2;
+            uint32_t field = p[offset + 1];
+            if (field & 0x80) {
+                header = 3;
+                field = (field & 0x7F) | (static_cast<uint32_t>(p[offset + 2]) << 7);
+            }
+            if (!(p[offset + header - 1] & 0x80)) {
+                uint32_t length = field >> 1;
+                if (len - offset - header < length) {
+                    break;
+                }
+                TLVView& view = views[count++];
+                view.type = p[offset];
+                view.length = length;
+                view.value = data + offset + header;
+                view.compressed = (field & 1) != 0;
+                last_frame = header + length;
+                offset += last_frame;
+                continue;
+            }
+        }
+        
+        uint64_t word = Load64LE(p + offset);
+        uint64_t continues;
+        if (offset + TLV_V2_MAX_HEADER_SIZE <= block_end) {
+            continues = block_mask >> (offset - block_start);
+        } else if (last_frame < SCAN_BLOCK_SIZE / 4 && len - offset >= SCAN_BLOCK_SIZE) {
+            block_start = offset;
+            block_end = offset + SCAN_BLOCK_SIZE;
+            block_mask = g_high_bit_mask(p + offset);
+            continues = block_mask;
+        } else {
+            continues = HighBits8(word);
+        }
+        
+        // 0位是varint的结束字节
+        uint64_t ends = ~continues;
+        if (!(ends & ((1u << V2_TYPE_BYTES) - 1))) {
+            malformed = true;
+            break;
+        }
+        int type_bytes = __builtin_ctzll(ends) + 1;
+        
+        uint64_t length_ends = ends >> type_bytes;
+        if (!(length_ends & ((1u << V2_LENGTH_BYTES) - 1))) {
+            malformed = true;
+            break;
+        }
+        int length_bytes = __builtin_ctzll(length_ends) + 1;
+        
+        uint64_t type = CompactVarint(word, type_bytes);
+        uint64_t field = CompactVarint(word >> (8 * type_bytes), length_bytes);
+        if (type > 0xFFFF || field > 0xFFFFFFFFull) {
+            malformed = true;
+            break;
+        }
+        
+        size_t header = static_cast<size_t>(type_bytes + length_bytes);
+        uint32_t length = static_cast<uint32_t>(field >> 1);
+        if (len - offset - header < length) {
+            break;
+        }
+        
+        TLVView& view = views[count++];
+        view.type = static_cast<uint16_t>(type);
+        view.length = length;
+        view.value = data + offset + header;
+        view.compressed = (field & 1) != 0;
+        last_frame = header + length;
+        offset += last_frame;
+    }
+    
+    consumed = offset;
+    return count;
+}
+
+/**
+ * @brief 解压压缩消息的内容。
+ *
+ * 内容开头是4字节的原始长度（与头部相同的字节序），超过max_size或解压结果
+ * 与之不符时返回false，调用方应按协议错误处理。
+ */
+bool TLVProtocol::Decompress(const TLVView& view, std::vector<char>& output, TLVView& plain, size_t max_size) {
+    if (!view.compressed || view.length < TLV_COMPRESSED_PREFIX) {
+        return false;
+    }
+    
+    uint32_t original;
+    memcpy(&original, view.value, sizeof(original));
+    original = m_converter.Convert32(original);
+    if (original > max_size) {
+        return false;
+    }
+    
+    output.resize(original);
+    if (!LZCodec::Decompress(view.value + TLV_COMPRESSED_PREFIX, view.length - TLV_COMPRESSED_PREFIX,
+                             output.data(), original)) {
+        return false;
+    }
+    
+    plain.type = view.type;
+    plain.length = original;
+    plain.value = output.data();
+    plain.compressed = false;
     return true;
 }
 
+/**
+ * @brief 写入头部。
+ *
+ * v1的压缩标志在长度字段最高位，v2的压缩标志在长度varint的最低位。
+ */
+size_t TLVProtocol::WriteHeader(char* output, uint16_t type, uint32_t length, bool compressed) const {
+    if (m_format == TLVFormat::V2) {
+        size_t n = WriteVarint(output, type);
+        return n + WriteVarint(output + n, (static_cast<uint64_t>(length) << 1) | (compressed ? 1 : 0));
+    }
+    
+    uint16_t wire_type = m_converter.Convert16(type);
+    uint32_t wire_length = m_converter.Convert32(compressed ? (length | TLV_COMPRESSED_FLAG) : length);
+    memcpy(output, &wire_type, sizeof(wire_type));
+    memcpy(output + sizeof(wire_type), &wire_length, sizeof(wire_length));
+    return TLV_HEADER_SIZE;
+}
+
+size_t TLVProtocol::SerializeHeader(uint16_t type, uint32_t length, char* output) const {
+    if (length & TLV_COMPRESSED_FLAG) {
+        return 0;
+    }
+    
+    return WriteHeader(output, type, length, false);
+}
+
+/**
+ * @brief 序列化一条消息，按阈值尝试压缩。
+ *
+ * 压缩时输出为：头部（带压缩标志）+ 4字节原始长度 + 压缩数据。
+ * 压缩后的内容不比原始内容短时放弃压缩，输出普通消息。
+ * 输出先按最大头部预留空间，v2头部较短时再把数据前移或截掉多余的尾部。
+ */
+bool TLVProtocol::SerializeFrame(uint16_t type, const char* value, uint32_t length, std::vector<char>& output,
+                                 size_t compress_threshold, uint32_t* payload_size) {
+    if (length & TLV_COMPRESSED_FLAG) {
+        return false;
+    }
+    
+    size_t max_header = m_format == TLVFormat::V2 ? TLV_V2_MAX_HEADER_SIZE : TLV_HEADER_SIZE;
+    
+    if (compress_threshold > 0 && length >= compress_threshold) {
+        output.resize(max_header + TLV_COMPRESSED_PREFIX + LZCodec::MaxCompressedSize(length));
+        char* payload = output.data() + max_header + TLV_COMPRESSED_PREFIX;
+        size_t compressed = LZCodec::Compress(value, length, payload, LZCodec::MaxCompressedSize(length));
+        
+        if (compressed > 0 && TLV_COMPRESSED_PREFIX + compressed < length) {
+            uint32_t wire_length = static_cast<uint32_t>(TLV_COMPRESSED_PREFIX + compressed);
+            char header[TLV_V2_MAX_HEADER_SIZE];
+            size_t header_size = WriteHeader(header, type, wire_length, true);
+            
+            // 头部紧挨在原始长度之前，整帧再移到缓冲区开头
+            char* frame = output.data() + max_header - header_size;
+            uint32_t original = m_converter.Convert32(length);
+            memcpy(frame, header, header_size);
+            memcpy(frame + header_size, &original, sizeof(original));
+            if (frame != output.data()) {
+                memmove(output.data(), frame, header_size + wire_length);
+            }
+            output.resize(header_size + wire_length);
+            if (payload_size) {
+                *payload_size = wire_length;
+            }
+            return true;
+        }
+    }
+    
+    output.resize(max_header + length);
+    size_t header_size = WriteHeader(output.data(), type, length, false);
+    if (length > 0) {
+        memcpy(output.data() + header_size, value, length);
+    }
+    output.resize(header_size + length);
+    if (payload_size) {
+        *payload_size = length;
+    }
+    
+    return true;
+}
+
+bool TLVProtocol::SerializeMessage(const TLVMessage& msg, std::vector<char>& output) {
+    return SerializeFrame(msg.type, msg.value.data(), msg.length, output);
+}
+
 void TLVProtocol::SetByteOrder(ByteOrder order) {
     m_converter.SetByteOrder(order);
+}
+
+/**
+ * @brief 设置是否接受压缩帧。
+ *
+ * v1的压缩标志占用长度字段的最高位，未协商压缩的对端不会设置它，此时被置位的头部
+ * 视为格式错误而不是当作压缩消息，v1的内容长度上限始终为2^31-1字节。
+ * v2的压缩标志是格式本身的一部分，不受此设置影响。
+ */
+void TLVProtocol::SetCompression(bool enabled) {
+    m_compression = enabled;
+}
+
+void TLVProtocol::SetFormat(TLVFormat format) {
+    m_format = format;
 }
\ No newline at end of file
@@ -5,12 +5,36 @@
 #include <vector>
 #include <string>
 #include "byte_converter.h"
+#include "buffer_pool.h"
+
+// v1长度字段的最高位表示消息内容经过压缩，其余31位为线上的内容长度。
+// 未启用压缩（TLVProtocol::SetCompression）时最高位被置位的头部为格式错误
+#define TLV_COMPRESSED_FLAG 0x80000000u
+
+// 压缩内容以4字节的原始长度开头，之后是LZCodec的压缩数据
+#define TLV_COMPRESSED_PREFIX 4
+
+// 解压后允许的最大消息长度
+#define TLV_MAX_INFLATED_SIZE (64 * 1024 * 1024)
+
+// v2头部的最大字节数（类型varint 3字节 + 长度varint 5字节）
+#define TLV_V2_MAX_HEADER_SIZE 8
+
+// 帧格式
+//
+// v1为固定6字节头部：2字节类型 + 4字节长度（最高位为压缩标志）。
+// v2为变长头部：类型的varint + (长度 << 1 | 压缩标志)的varint，varint每字节低7位为数据、
+// 最高位表示后面还有字节（小端顺序），10字节的小消息头部只占2字节。
+enum class TLVFormat {
+    V1 = 1,
+    V2 = 2
+};
 
 // TLV消息结构
 struct TLVMessage {
     uint16_t type;           // 消息类型
     uint32_t length;         // 消息长度
-    std::vector<char> value; // 消息内容
+    PooledBytes value;       // 消息内容（从缓冲区池分配）
     
     TLVMessage() : type(0), length(0) {}
     
@@ -20,26 +44,83 @@ struct TLVMessage {
     }
 };
 
+// TLV消息视图（零拷贝）
+// 不拥有数据，value直接指向接收缓冲区中的消息内容，只在回调期间有效；
+// 需要保留消息时调用ToMessage()复制一份。
+struct TLVView {
+    uint16_t type;           // 消息类型
+    uint32_t length;         // 消息长度（即value指向的字节数）
+    const char* value;       // 消息内容
+    bool compressed;         // 内容是否为压缩数据（需先调用TLVProtocol::Decompress）
+    
+    TLVView() : type(0), length(0), value(nullptr), compressed(false) {}
+    
+    TLVView(uint16_t t, const char* v, uint32_t l)
+        : type(t), length(l), value(v), compressed(false) {}
+    
+    // 复制为拥有数据的TLVMessage
+    TLVMessage ToMessage() const {
+        return TLVMessage(type, value, length);
+    }
+};
+
 // TLV协议处理类
 class TLVProtocol {
 public:
     TLVProtocol();
     ~TLVProtocol();
     
-    // 解析TLV消息
+    // 解析TLV消息（压缩的内容自动解压，解压失败时返回false且consumed不为0）
     bool ParseMessage(const char* data, size_t len, TLVMessage& msg, size_t& consumed);
     
+    // 解析TLV消息视图（不复制消息内容，压缩的内容原样返回并设置compressed）。
+    // 数据不足时返回false且consumed为0，头部格式错误时返回false且consumed不为0
+    bool ParseView(const char* data, size_t len, TLVView& view, size_t& consumed);
+    
+    // 一次找出data开头连续的完整消息，最多max_views条，返回条数，consumed为它们占用的字节数。
+    // 遇到不完整的消息时停止；遇到格式错误的消息时停止并把malformed置为true
+    size_t ScanFrames(const char* data, size_t len, TLVView* views, size_t max_views,
+                      size_t& consumed, bool& malformed);
+    
+    // 解压compressed视图的内容到output，plain指向output中的原始内容
+    bool Decompress(const TLVView& view, std::vector<char>& output, TLVView& plain, size_t max_size = TLV_MAX_INFLATED_SIZE);
+    
     // 序列化TLV消息
     bool SerializeMessage(const TLVMessage& msg, std::vector<char>& output);
     
+    // 序列化一条消息，compress_threshold大于0且内容不短于它时尝试压缩，压缩后不变小则原样发送。
+    // payload_size非空时写入线上内容的字节数（压缩时含原始长度前缀）
+    bool SerializeFrame(uint16_t type, const char* value, uint32_t length, std::vector<char>& output,
+                        size_t compress_threshold = 0, uint32_t* payload_size = nullptr);
+    
+    // 只序列化头部，内容由调用方另行发送。output至少需要TLV_V2_MAX_HEADER_SIZE字节，返回头部字节数
+    size_t SerializeHeader(uint16_t type, uint32_t length, char* output) const;
+    
     // 设置字节序（默认为网络字节序，即大端）
     void SetByteOrder(ByteOrder order);
     
-private:
-    ByteConverter m_converter; // 字节序转换器
+    // 设置帧格式（默认为v1），解析和序列化都按此格式
+    void SetFormat(TLVFormat format);
+    TLVFormat GetFormat() const { return m_format; }
     
-    // TLV头部大小（类型2字节 + 长度4字节）
+    // 设置是否接受压缩帧（默认不接受），不接受时v1长度字段最高位被置位的消息按格式错误处理
+    void SetCompression(bool enabled);
+    bool GetCompression() const { return m_compression; }
+    
+    // v1头部大小（类型2字节 + 长度4字节）
     static const size_t TLV_HEADER_SIZE = 6;
+
+private:
+    bool ParseViewV2(const char* data, size_t len, TLVView& view, size_t& consumed);
+    size_t ScanFramesV2(const char* data, size_t len, TLVView* views, size_t max_views,
+                        size_t& consumed, bool& malformed);
+    
+    // 写入头部，返回头部字节数（v1为TLV_HEADER_SIZE，v2不超过TLV_V2_MAX_HEADER_SIZE）
+    size_t WriteHeader(char* output, uint16_t type, uint32_t length, bool compressed) const;
+    
+    ByteConverter m_converter; // 字节序转换器
+    TLVFormat m_format;        // 帧格式
+    bool m_compression;        // 是否接受压缩帧（v1）
 };
 
 #endif // TLV_PROTOCOL_H
\ No newline at end of file
@@ -0,0 +1,235 @@
+// 追踪文件解码工具
+//
+// 读取EpollServer::DumpTrace导出的二进制文件，把各阶段的记录按连接和消息序号还原成
+// 每条消息的生命周期，输出总耗时的分布和最慢的N条消息在各阶段的耗时（微秒）：
+//
+// - parse:   读到数据到解析出该消息（含同一批数据中前面消息的回调时间）
+// - queue:   解析完成到回调开始（使用处理线程池时为排队时间）
+// - handler: 回调执行时间
+// - send:    回调中第一次交给发送接口到回包全部写入套接字
+//
+// 回调期间在同一连接上交给发送接口的数据视为该消息的回包。
+//
+// 用法：./trace_decode [-n 条数] trace.bin
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "../trace.h"
+
+// 单条消息的生命周期（时间为相对最早记录的纳秒数，-1表示没有记录）
+struct MessageTrace {
+    uint32_t conn;
+    uint64_t seq;
+    uint16_t type;
+    double read;
+    double parsed;
+    double callback_start;
+    double callback_done;
+    double first_enqueue;
+    double written;
+    uint64_t enqueue_end;   // 回包在连接发送字节流中的结束位置
+    
+    double End() const {
+        return written > callback_done ? written : callback_done;
+    }
+    
+    double Total() const {
+        return End() - read;
+    }
+};
+
+// 连接的解码状态
+struct ConnTrace {
+    double last_read;
+    int64_t active;                  // 正在执行回调的消息，-1表示没有
+    std::deque<size_t> pending;      // 等待写出回包的消息，按enqueue_end递增
+    
+    ConnTrace() : last_read(-1), active(-1) {}
+};
+
+static double Micros(double ns) {
+    return ns < 0 ? 0 : ns / 1000.0;
+}
+
+static uint64_t MessageKey(uint32_t conn, uint64_t seq) {
+    return (static_cast<uint64_t>(conn) << 40) ^ seq;
+}
+
+static bool LoadTrace(const char* path, TraceFileHeader& header, std::vector<TraceRecord>& records) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == TRACE_FILE_VERSION && header.record_size == sizeof(TraceRecord);
+    if (!ok) {
+        fprintf(stderr, "%s: not a trace file\n", path);
+        fclose(file);
+        return false;
+    }
+    
+    records.resize(header.record_count);
+    if (!records.empty() && fread(records.data(), sizeof(TraceRecord), records.size(), file) != records.size()) {
+        fprintf(stderr, "%s: truncated\n", path);
+        fclose(file);
+        return false;
+    }
+    
+    fclose(file);
+    return true;
+}
+
+// 按时间顺序重放记录，还原每条消息的各阶段时间
+static std::vector<MessageTrace> Rebuild(const TraceFileHeader& header, const std::vector<TraceRecord>& records) {
+    std::vector<MessageTrace> messages;
+    std::unordered_map<uint64_t, size_t> index;
+    std::unordered_map<uint32_t, ConnTrace> conns;
+    
+    for (size_t i = 0; i < records.size(); i++) {
+        const TraceRecord& record = records[i];
+        double ts = static_cast<double>(record.timestamp - header.base_ticks) * header.ns_per_tick;
+        ConnTrace& conn = conns[record.conn];
+        
+        switch (static_cast<TraceStage>(record.stage)) {
+        case TraceStage::Read:
+            conn.last_read = ts;
+            break;
+        
+        case TraceStage::Parsed: {
+            MessageTrace msg;
+            msg.conn = record.conn;
+            msg.seq = record.value;
+            msg.type = record.type;
+            msg.read = conn.last_read >= 0 ? conn.last_read : ts;
+            msg.parsed = ts;
+            msg.callback_start = -1;
+            msg.callback_done = -1;
+            msg.first_enqueue = -1;
+            msg.written = -1;
+            msg.enqueue_end = 0;
+            index[MessageKey(record.conn, record.value)] = messages.size();
+            messages.push_back(msg);
+            break;
+        }
+        
+        case TraceStage::CallbackStart:
+        case TraceStage::CallbackDone: {
+            auto it = index.find(MessageKey(record.conn, record.value));
+            if (it == index.end()) {
+                // 解析记录已被环形缓冲区覆盖
+                conn.active = -1;
+                break;
+            }
+            if (record.stage == static_cast<uint8_t>(TraceStage::CallbackStart)) {
+                messages[it->second].callback_start = ts;
+                conn.active = static_cast<int64_t>(it->second);
+            } else {
+                messages[it->second].callback_done = ts;
+                conn.active = -1;
+            }
+            break;
+        }
+        
+        case TraceStage::Enqueue:
+            if (conn.active >= 0) {
+                MessageTrace& msg = messages[conn.active];
+                if (msg.first_enqueue < 0) {
+                    msg.first_enqueue = ts;
+                    conn.pending.push_back(static_cast<size_t>(conn.active));
+                }
+                msg.enqueue_end = record.value;
+            }
+            break;
+        
+        case TraceStage::Written:
+            while (!conn.pending.empty() && messages[conn.pending.front()].enqueue_end <= record.value) {
+                messages[conn.pending.front()].written = ts;
+                conn.pending.pop_front();
+            }
+            break;
+        }
+    }
+    
+    // 只保留回调已经返回的消息
+    std::vector<MessageTrace> complete;
+    for (size_t i = 0; i < messages.size(); i++) {
+        if (messages[i].callback_start >= 0 && messages[i].callback_done >= 0) {
+            complete.push_back(messages[i]);
+        }
+    }
+    return complete;
+}
+
+static void Usage(const char* prog) {
+    fprintf(stderr, "usage: %s [-n count] trace.bin\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    size_t top = 20;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n': top = static_cast<size_t>(atol(optarg)); break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (optind >= argc) {
+        Usage(argv[0]);
+        return 1;
+    }
+    
+    TraceFileHeader header;
+    std::vector<TraceRecord> records;
+    if (!LoadTrace(argv[optind], header, records)) {
+        return 1;
+    }
+    
+    std::vector<MessageTrace> messages = Rebuild(header, records);
+    printf("records: %zu  messages: %zu  span: %.3f ms\n", records.size(), messages.size(),
+           records.empty() ? 0.0 :
+           (records.back().timestamp - header.base_ticks) * header.ns_per_tick / 1e6);
+    if (messages.empty()) {
+        return 0;
+    }
+    
+    std::sort(messages.begin(), messages.end(), [](const MessageTrace& a, const MessageTrace& b) {
+        return a.Total() > b.Total();
+    });
+    
+    size_t n = messages.size();
+    printf("total (us): p50 %.1f  p90 %.1f  p99 %.1f  p999 %.1f  max %.1f\n",
+           Micros(messages[n / 2].Total()), Micros(messages[n / 10].Total()),
+           Micros(messages[n / 100].Total()), Micros(messages[n / 1000].Total()),
+           Micros(messages[0].Total()));
+    
+    printf("\nslowest %zu messages (us):\n", std::min(top, n));
+    printf("%8s %10s %6s %10s %10s %10s %10s %10s\n",
+           "conn", "seq", "type", "total", "parse", "queue", "handler", "send");
+    for (size_t i = 0; i < top && i < n; i++) {
+        const MessageTrace& msg = messages[i];
+        printf("%8u %10llu %6u %10.1f %10.1f %10.1f %10.1f",
+               msg.conn, (unsigned long long)msg.seq, msg.type, Micros(msg.Total()),
+               Micros(msg.parsed - msg.read), Micros(msg.callback_start - msg.parsed),
+               Micros(msg.callback_done - msg.callback_start));
+        if (msg.written >= 0 && msg.first_enqueue >= 0) {
+            printf(" %10.1f\n", Micros(msg.written - msg.first_enqueue));
+        } else {
+            printf(" %10s\n", "-");  // 没有回包或回包尚未写出
+        }
+    }
+    
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+// 校准rdtsc频率的采样时长（纳秒）
+static const int64_t CALIBRATE_NS = 20 * 1000 * 1000;
+
+// 追踪器ID从1开始，线程局部缓存初始为0，不会误匹配
+static std::atomic<uint64_t> g_next_tracer_id(1);
+
+thread_local Tracer::LocalCache Tracer::t_cache = {0, nullptr};
+
+static int64_t MonotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief 测量TraceClock每个单位对应的纳秒数。
+ *
+ * rdtsc在现代x86上以恒定频率递增，与单调时钟对照一小段时间即可换算；
+ * 非x86平台TraceClock本身就是纳秒。
+ */
+static double CalibrateClock() {
+#if defined(__x86_64__) || defined(__i386__)
+    int64_t start_ns = MonotonicNs();
+    uint64_t start_ticks = TraceClock();
+    int64_t now_ns = start_ns;
+    while (now_ns - start_ns < CALIBRATE_NS) {
+        now_ns = MonotonicNs();
+    }
+    uint64_t end_ticks = TraceClock();
+    
+    if (end_ticks <= start_ticks) {
+        return 1.0;
+    }
+    return static_cast<double>(now_ns - start_ns) / static_cast<double>(end_ticks - start_ticks);
+#else
+    return 1.0;
+#endif
+}
+
+TraceRing::TraceRing(size_t capacity, uint8_t thread)
+    : m_records(capacity), m_mask(capacity - 1), m_thread(thread), m_head(0) {
+}
+
+void TraceRing::CopyTo(std::vector<TraceRecord>& out) const {
+    uint64_t capacity = m_mask + 1;
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    uint64_t begin = head > capacity ? head - capacity : 0;
+    
+    size_t base = out.size();
+    for (uint64_t i = begin; i < head; i++) {
+        out.push_back(m_records[i & m_mask]);
+    }
+    
+    // 复制期间写入方可能已经覆盖了最旧的一段（正在写的那条也算），丢弃这些记录。
+    // 上面是普通读，acquire读不能阻止它们被重排到之后，需要栅栏
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = m_head.load(std::memory_order_relaxed);
+    uint64_t valid_begin = after + 1 > capacity ? after + 1 - capacity : 0;
+    if (valid_begin > begin) {
+        size_t drop = static_cast<size_t>(std::min(valid_begin - begin, head - begin));
+        out.erase(out.begin() + base, out.begin() + base + drop);
+    }
+}
+
+Tracer::Tracer()
+    : m_id(g_next_tracer_id.fetch_add(1, std::memory_order_relaxed)),
+      m_enabled(false), m_capacity(TRACE_DEFAULT_RECORDS), m_ns_per_tick(0) {
+}
+
+Tracer::~Tracer() {
+}
+
+/**
+ * @brief 启用追踪。
+ *
+ * 第一次启用时校准时钟（约20ms）。容量只影响之后分配的追踪环，
+ * 已经记录过的线程沿用原来的容量。
+ */
+void Tracer::Enable(size_t records_per_thread) {
+    size_t capacity = 1;
+    while (capacity < records_per_thread) {
+        capacity <<= 1;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_ns_per_tick == 0) {
+            m_ns_per_tick = CalibrateClock();
+        }
+    }
+    
+    m_capacity.store(capacity, std::memory_order_relaxed);
+    m_enabled.store(true, std::memory_order_release);
+}
+
+void Tracer::Disable() {
+    m_enabled.store(false, std::memory_order_release);
+}
+
+TraceRing* Tracer::LocalSlow() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    std::unique_ptr<TraceRing>& ring = m_rings[std::this_thread::get_id()];
+    if (!ring) {
+        ring.reset(new TraceRing(m_capacity.load(std::memory_order_relaxed),
+                                 static_cast<uint8_t>(m_rings.size() - 1)));
+    }
+    
+    t_cache.tracer_id = m_id;
+    t_cache.ring = ring.get();
+    return ring.get();
+}
+
+/**
+ * @brief 导出所有线程的追踪记录。
+ *
+ * 不暂停写入方：各追踪环各自复制，可能缺少导出期间新写入的记录。
+ * 记录按时间戳排序后连同时钟换算系数写入文件。
+ */
+int64_t Tracer::Dump(const char* path) const {
+    std::vector<TraceRecord> records;
+    double ns_per_tick;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_rings.begin(); it != m_rings.end(); ++it) {
+            it->second->CopyTo(records);
+        }
+        ns_per_tick = m_ns_per_tick;
+    }
+    
+    std::sort(records.begin(), records.end(), [](const TraceRecord& a, const TraceRecord& b) {
+        return a.timestamp < b.timestamp;
+    });
+    
+    TraceFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FILE_VERSION;
+    header.record_size = sizeof(TraceRecord);
+    header.record_count = records.size();
+    header.base_ticks = records.empty() ? 0 : records.front().timestamp;
+    header.ns_per_tick = ns_per_tick;
+    
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return -1;
+    }
+    
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (ok && !records.empty()) {
+        ok = fwrite(records.data(), sizeof(TraceRecord), records.size(), file) == records.size();
+    }
+    
+    if (fclose(file) != 0 || !ok) {
+        return -1;
+    }
+    
+    return static_cast<int64_t>(records.size());
+}
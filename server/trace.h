@@ -0,0 +1,155 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+// 每个线程默认的追踪记录容量
+#define TRACE_DEFAULT_RECORDS 65536
+
+// 追踪文件头部的魔数和版本
+#define TRACE_FILE_MAGIC "TLVTRACE"
+#define TRACE_FILE_VERSION 1
+
+// 消息生命周期中的阶段
+enum class TraceStage : uint8_t {
+    Read = 1,           // 从套接字读到数据，value为读到的字节数
+    Parsed = 2,         // 解析出一条完整消息，value为连接内的消息序号
+    CallbackStart = 3,  // 开始执行消息回调（使用处理线程池时为处理线程取出消息），value为消息序号
+    CallbackDone = 4,   // 消息回调返回，value为消息序号
+    Enqueue = 5,        // 数据交给发送接口，value为连接发送字节流中本段数据的结束偏移
+    Written = 6         // 数据写入套接字（io_uring后端为发送完成），value为连接累计发送的字节数
+};
+
+// 追踪记录，24字节，按原样写入追踪文件
+struct TraceRecord {
+    uint64_t timestamp;  // TraceClock()的读数
+    uint64_t value;      // 含义见TraceStage
+    uint32_t conn;       // 连接的追踪ID（同一进程内唯一，不随fd复用）
+    uint16_t type;       // TLV消息类型（Parsed/Callback*阶段有效）
+    uint8_t stage;       // TraceStage
+    uint8_t thread;      // 记录所在线程的编号
+};
+
+// 追踪文件头部
+//
+// 之后紧跟record_count条TraceRecord。时间戳换算为纳秒：
+// (timestamp - base_ticks) * ns_per_tick
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t record_count;
+    uint64_t base_ticks;   // 最早一条记录的时间戳
+    double ns_per_tick;
+};
+
+// 追踪时钟：x86上为rdtsc，其他平台为单调时钟的纳秒数
+inline uint64_t TraceClock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// 单线程写入的追踪环
+//
+// 只有所属线程写入：先写记录再用release发布写游标，写满后覆盖最旧的记录，不加锁。
+// 导出线程读取游标后复制记录，复制完再读一次游标，丢弃期间可能被覆盖的部分
+// （类似seqlock，两边各用一个栅栏保证游标与记录内容的先后顺序）。
+class TraceRing {
+public:
+    TraceRing(size_t capacity, uint8_t thread);
+    
+    void Push(TraceStage stage, uint32_t conn, uint16_t type, uint64_t value) {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        // 上一次发布的游标先于本条记录的写入可见，导出方不会漏算正在被覆盖的记录
+        std::atomic_thread_fence(std::memory_order_release);
+        TraceRecord& record = m_records[head & m_mask];
+        record.timestamp = TraceClock();
+        record.value = value;
+        record.conn = conn;
+        record.type = type;
+        record.stage = static_cast<uint8_t>(stage);
+        record.thread = m_thread;
+        m_head.store(head + 1, std::memory_order_release);
+    }
+    
+    // 把当前保留的记录追加到out（可在其他线程调用）
+    void CopyTo(std::vector<TraceRecord>& out) const;
+
+private:
+    std::vector<TraceRecord> m_records;
+    uint64_t m_mask;
+    uint8_t m_thread;
+    std::atomic<uint64_t> m_head;  // 已写入的记录总数
+};
+
+// 消息生命周期追踪
+//
+// 启用后，各线程第一次记录时分配自己的追踪环（与MetricsRegistry相同的线程局部缓存），
+// 之后每条记录只是几次普通写入；未启用时每个追踪点只有一次relaxed读取。
+// Dump把所有线程的记录合并写入二进制文件，用tools/trace_decode分析。
+class Tracer {
+public:
+    Tracer();
+    ~Tracer();
+    
+    // 启用追踪，records_per_thread向上取整为2的幂，只影响之后分配的追踪环
+    void Enable(size_t records_per_thread);
+    
+    // 停止记录，已有的记录保留到下一次Dump
+    void Disable();
+    
+    bool IsEnabled() const {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+    
+    void Record(TraceStage stage, uint32_t conn, uint16_t type, uint64_t value) {
+        if (!IsEnabled()) {
+            return;
+        }
+        
+        TraceRing* ring = t_cache.tracer_id == m_id ? t_cache.ring : LocalSlow();
+        ring->Push(stage, conn, type, value);
+    }
+    
+    // 把所有线程的记录按时间排序后写入path，返回写入的记录数，失败返回-1
+    int64_t Dump(const char* path) const;
+
+private:
+    struct LocalCache {
+        uint64_t tracer_id;
+        TraceRing* ring;
+    };
+    
+    TraceRing* LocalSlow();
+    
+    Tracer(const Tracer&);
+    Tracer& operator=(const Tracer&);
+    
+    static thread_local LocalCache t_cache;
+    
+    uint64_t m_id;
+    std::atomic<bool> m_enabled;
+    std::atomic<size_t> m_capacity;
+    double m_ns_per_tick;
+    mutable std::mutex m_mutex;
+    std::map<std::thread::id, std::unique_ptr<TraceRing> > m_rings;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,629 @@
+#include "uring_poller.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <iostream>
+
+// user_data编码：高8位为请求类型，中间24位为标记，低32位为fd（发送请求为槽位下标）
+enum UringOp {
+    URING_OP_POLL = 1,
+    URING_OP_ACCEPT = 2,
+    URING_OP_RECV = 3,
+    URING_OP_SEND = 4,
+    URING_OP_CANCEL = 5    // 取消类请求，完成事件直接忽略
+};
+
+static inline uint64_t MakeUserData(UringOp op, uint32_t tag, uint32_t fd) {
+    return (static_cast<uint64_t>(op) << 56) |
+           (static_cast<uint64_t>(tag & 0xFFFFFFu) << 32) |
+           fd;
+}
+
+static inline int UserDataOp(uint64_t data) {
+    return static_cast<int>(data >> 56);
+}
+
+static inline uint32_t UserDataTag(uint64_t data) {
+    return static_cast<uint32_t>(data >> 32) & 0xFFFFFFu;
+}
+
+static inline uint32_t UserDataFd(uint64_t data) {
+    return static_cast<uint32_t>(data);
+}
+
+static int SysSetup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int SysEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                    const void* arg, size_t argsz) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz));
+}
+
+static int SysRegister(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+UringPoller::UringPoller()
+    : m_ring_fd(-1),
+      m_sq_ptr(MAP_FAILED), m_sq_size(0), m_sq_head(nullptr), m_sq_tail(nullptr),
+      m_sq_mask(nullptr), m_sq_array(nullptr), m_sq_entries(0),
+      m_sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED)), m_sqes_size(0),
+      m_sq_local_tail(0), m_to_submit(0),
+      m_cq_ptr(MAP_FAILED), m_cq_size(0), m_cq_head(nullptr), m_cq_tail(nullptr),
+      m_cq_mask(nullptr), m_cqes(nullptr),
+      m_buf_ring(static_cast<struct io_uring_buf*>(MAP_FAILED)), m_buf_ring_size(0),
+      m_buffers(static_cast<char*>(MAP_FAILED)), m_buf_tail(0),
+      m_poll_generation(0), m_poll_level(true) {
+}
+
+UringPoller::~UringPoller() {
+    Destroy();
+}
+
+void UringPoller::Destroy() {
+    // 先取消所有未完成的请求并关闭io_uring，之后再释放缓冲区
+    if (m_ring_fd != -1) {
+        if (m_sqes != MAP_FAILED) {
+            struct io_uring_sqe* sqe = GetSqe();
+            if (sqe) {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+                sqe->user_data = MakeUserData(URING_OP_CANCEL, 0, 0);
+                Enter(0, 0);
+            }
+        }
+        close(m_ring_fd);
+        m_ring_fd = -1;
+    }
+    
+    if (m_buffers != MAP_FAILED) {
+        munmap(m_buffers, static_cast<size_t>(URING_BUF_COUNT) * URING_BUF_SIZE);
+        m_buffers = static_cast<char*>(MAP_FAILED);
+    }
+    
+    if (m_buf_ring != MAP_FAILED) {
+        munmap(m_buf_ring, m_buf_ring_size);
+        m_buf_ring = static_cast<struct io_uring_buf*>(MAP_FAILED);
+    }
+    
+    if (m_sqes != MAP_FAILED) {
+        munmap(m_sqes, m_sqes_size);
+        m_sqes = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+    }
+    
+    if (m_cq_ptr != MAP_FAILED && m_cq_ptr != m_sq_ptr) {
+        munmap(m_cq_ptr, m_cq_size);
+    }
+    m_cq_ptr = MAP_FAILED;
+    
+    if (m_sq_ptr != MAP_FAILED) {
+        munmap(m_sq_ptr, m_sq_size);
+        m_sq_ptr = MAP_FAILED;
+    }
+    
+    m_send_slots.clear();
+    m_free_send_slots.clear();
+}
+
+bool UringPoller::Init() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = URING_ENTRIES * 4;
+    
+    m_ring_fd = SysSetup(URING_ENTRIES, &params);
+    if (m_ring_fd == -1 && errno == EINVAL) {
+        // 较老的内核不支持部分标志
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = URING_ENTRIES * 4;
+        m_ring_fd = SysSetup(URING_ENTRIES, &params);
+    }
+    
+    if (m_ring_fd == -1) {
+        std::cerr << "Failed to create io_uring: " << strerror(errno) << std::endl;
+        return false;
+    }
+    
+    if (!(params.features & IORING_FEAT_NODROP)) {
+        std::cerr << "io_uring: kernel too old (no IORING_FEAT_NODROP)" << std::endl;
+        Destroy();
+        return false;
+    }
+    
+    m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        m_sq_size = m_cq_size = (m_sq_size > m_cq_size) ? m_sq_size : m_cq_size;
+    }
+    
+    m_sq_ptr = mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    m_ring_fd, IORING_OFF_SQ_RING);
+    if (m_sq_ptr == MAP_FAILED) {
+        std::cerr << "Failed to map io_uring SQ: " << strerror(errno) << std::endl;
+        Destroy();
+        return false;
+    }
+    
+    if (single_mmap) {
+        m_cq_ptr = m_sq_ptr;
+    } else {
+        m_cq_ptr = mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        m_ring_fd, IORING_OFF_CQ_RING);
+        if (m_cq_ptr == MAP_FAILED) {
+            std::cerr << "Failed to map io_uring CQ: " << strerror(errno) << std::endl;
+            Destroy();
+            return false;
+        }
+    }
+    
+    m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    m_sqes = static_cast<struct io_uring_sqe*>(mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+                                                    MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES));
+    if (m_sqes == MAP_FAILED) {
+        std::cerr << "Failed to map io_uring SQEs: " << strerror(errno) << std::endl;
+        Destroy();
+        return false;
+    }
+    
+    char* sq = static_cast<char*>(m_sq_ptr);
+    m_sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    m_sq_entries = params.sq_entries;
+    m_sq_local_tail = *m_sq_tail;
+    
+    char* cq = static_cast<char*>(m_cq_ptr);
+    m_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    
+    return true;
+}
+
+const char* UringPoller::Name() const {
+    return "io_uring";
+}
+
+bool UringPoller::SupportsAsyncIo() const {
+    return true;
+}
+
+struct io_uring_sqe* UringPoller::GetSqe() {
+    unsigned head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    if (m_sq_local_tail - head >= m_sq_entries) {
+        // 提交队列已满，先把积压的请求提交给内核
+        Enter(0, 0);
+        head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+        if (m_sq_local_tail - head >= m_sq_entries) {
+            std::cerr << "io_uring: submission queue full" << std::endl;
+            return nullptr;
+        }
+    }
+    
+    unsigned index = m_sq_local_tail & *m_sq_mask;
+    struct io_uring_sqe* sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sq_array[index] = index;
+    m_sq_local_tail++;
+    m_to_submit++;
+    
+    return sqe;
+}
+
+int UringPoller::Enter(unsigned wait_nr, int timeout_ms) {
+    // 发布新写入的SQE
+    __atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+    
+    unsigned flags = 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    const void* argp = nullptr;
+    size_t argsz = 0;
+    
+    if (wait_nr > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+        
+        if (timeout_ms >= 0) {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000LL;
+            
+            memset(&arg, 0, sizeof(arg));
+            arg.sigmask_sz = _NSIG / 8;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+            
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+    }
+    
+    if (m_to_submit == 0 && wait_nr == 0) {
+        return 0;
+    }
+    
+    int ret = SysEnter(m_ring_fd, m_to_submit, wait_nr, flags, argp, argsz);
+    if (ret >= 0) {
+        m_to_submit -= (static_cast<unsigned>(ret) < m_to_submit) ? static_cast<unsigned>(ret) : m_to_submit;
+        return ret;
+    }
+    
+    if (errno == ETIME || errno == EINTR) {
+        // 等待超时或被信号打断时请求已经提交
+        m_to_submit = 0;
+        return 0;
+    }
+    
+    if (errno == EBUSY || errno == EAGAIN) {
+        // 完成队列积压，稍后重试提交
+        return 0;
+    }
+    
+    std::cerr << "io_uring_enter failed: " << strerror(errno) << std::endl;
+    return -1;
+}
+
+bool UringPoller::ArmPoll(int fd, uint32_t events, uint32_t generation) {
+    struct io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        return false;
+    }
+    
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events & ~(EPOLLET | EPOLLONESHOT);
+    // io_uring的poll默认是边缘触发，没有EPOLLET时使用水平触发，与epoll的语义一致；
+    // 内核不支持水平触发时退回边缘触发，事件循环对eventfd/timerfd每次都会读空，不受影响
+    sqe->len = IORING_POLL_ADD_MULTI;
+    if (!(events & EPOLLET) && m_poll_level) {
+        sqe->len |= IORING_POLL_ADD_LEVEL;
+    }
+    sqe->user_data = MakeUserData(URING_OP_POLL, generation, static_cast<uint32_t>(fd));
+    
+    return true;
+}
+
+bool UringPoller::Add(int fd, uint32_t events) {
+    uint32_t generation = ++m_poll_generation & 0xFFFFFFu;
+    m_polls[fd] = std::make_pair(events, generation);
+    
+    return ArmPoll(fd, events, generation);
+}
+
+bool UringPoller::Modify(int fd, uint32_t events) {
+    std::map<int, std::pair<uint32_t, uint32_t> >::iterator it = m_polls.find(fd);
+    if (it == m_polls.end()) {
+        return Add(fd, events);
+    }
+    
+    if (!Remove(fd)) {
+        return false;
+    }
+    
+    return Add(fd, events);
+}
+
+bool UringPoller::Remove(int fd) {
+    std::map<int, std::pair<uint32_t, uint32_t> >::iterator it = m_polls.find(fd);
+    if (it == m_polls.end()) {
+        return false;
+    }
+    
+    uint32_t generation = it->second.second;
+    m_polls.erase(it);
+    
+    struct io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        return false;
+    }
+    
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = MakeUserData(URING_OP_POLL, generation, static_cast<uint32_t>(fd));
+    sqe->user_data = MakeUserData(URING_OP_CANCEL, 0, static_cast<uint32_t>(fd));
+    
+    return true;
+}
+
+bool UringPoller::StartAccept(int listen_fd) {
+    struct io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        return false;
+    }
+    
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = MakeUserData(URING_OP_ACCEPT, 0, static_cast<uint32_t>(listen_fd));
+    
+    return true;
+}
+
+bool UringPoller::StartRecv(int fd, uint32_t tag) {
+    // 提供缓冲区环在第一次接收时才创建，只做就绪通知的实例（如接收线程）不占用这部分内存
+    if (m_buf_ring == MAP_FAILED) {
+        m_buf_ring_size = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+        void* ring = mmap(nullptr, m_buf_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED) {
+            std::cerr << "Failed to allocate io_uring buffer ring: " << strerror(errno) << std::endl;
+            return false;
+        }
+        
+        void* buffers = mmap(nullptr, static_cast<size_t>(URING_BUF_COUNT) * URING_BUF_SIZE,
+                             PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffers == MAP_FAILED) {
+            std::cerr << "Failed to allocate io_uring buffers: " << strerror(errno) << std::endl;
+            munmap(ring, m_buf_ring_size);
+            return false;
+        }
+        
+        struct io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+        reg.ring_entries = URING_BUF_COUNT;
+        reg.bgid = 0;
+        
+        if (SysRegister(m_ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+            std::cerr << "Failed to register io_uring buffer ring: " << strerror(errno) << std::endl;
+            munmap(buffers, static_cast<size_t>(URING_BUF_COUNT) * URING_BUF_SIZE);
+            munmap(ring, m_buf_ring_size);
+            return false;
+        }
+        
+        m_buf_ring = static_cast<struct io_uring_buf*>(ring);
+        m_buffers = static_cast<char*>(buffers);
+        m_buf_tail = 0;
+        
+        m_returned_bufs.reserve(URING_BUF_COUNT);
+        for (uint16_t i = 0; i < URING_BUF_COUNT; i++) {
+            m_returned_bufs.push_back(i);
+        }
+        RecycleBuffers();
+    }
+    
+    struct io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        return false;
+    }
+    
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = MakeUserData(URING_OP_RECV, tag, static_cast<uint32_t>(fd));
+    
+    return true;
+}
+
+bool UringPoller::CancelRecv(int fd, uint32_t tag) {
+    struct io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        return false;
+    }
+    
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = MakeUserData(URING_OP_RECV, tag, static_cast<uint32_t>(fd));
+    sqe->user_data = MakeUserData(URING_OP_CANCEL, 0, static_cast<uint32_t>(fd));
+    
+    return true;
+}
+
+bool UringPoller::CancelAll(int fd) {
+    struct io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        return false;
+    }
+    
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = MakeUserData(URING_OP_CANCEL, 0, static_cast<uint32_t>(fd));
+    
+    // 按fd取消必须在fd关闭之前提交，否则fd号被复用后会取消新连接的请求
+    return Enter(0, 0) >= 0;
+}
+
+bool UringPoller::Send(int fd, uint32_t tag, const struct iovec* iov, int count,
+                       const std::shared_ptr<void>& owner) {
+    if (count <= 0) {
+        return false;
+    }
+    if (count > URING_SEND_IOV) {
+        count = URING_SEND_IOV;
+    }
+    
+    uint32_t slot_index;
+    if (!m_free_send_slots.empty()) {
+        slot_index = m_free_send_slots.back();
+        m_free_send_slots.pop_back();
+    } else {
+        slot_index = static_cast<uint32_t>(m_send_slots.size());
+        m_send_slots.push_back(std::unique_ptr<SendSlot>(new SendSlot()));
+    }
+    
+    SendSlot* slot = m_send_slots[slot_index].get();
+    slot->fd = fd;
+    slot->tag = tag;
+    slot->owner = owner;
+    memcpy(slot->iov, iov, count * sizeof(struct iovec));
+    memset(&slot->msg, 0, sizeof(slot->msg));
+    slot->msg.msg_iov = slot->iov;
+    slot->msg.msg_iovlen = count;
+    
+    struct io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        slot->owner.reset();
+        m_free_send_slots.push_back(slot_index);
+        return false;
+    }
+    
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&slot->msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = MakeUserData(URING_OP_SEND, 0, slot_index);
+    
+    return true;
+}
+
+void UringPoller::RecycleBuffers() {
+    if (m_returned_bufs.empty()) {
+        return;
+    }
+    
+    const uint16_t mask = URING_BUF_COUNT - 1;
+    for (size_t i = 0; i < m_returned_bufs.size(); i++) {
+        uint16_t bid = m_returned_bufs[i];
+        struct io_uring_buf* buf = &m_buf_ring[(m_buf_tail + i) & mask];
+        buf->addr = reinterpret_cast<uint64_t>(m_buffers + static_cast<size_t>(bid) * URING_BUF_SIZE);
+        buf->len = URING_BUF_SIZE;
+        buf->bid = bid;
+    }
+    
+    m_buf_tail = static_cast<uint16_t>(m_buf_tail + m_returned_bufs.size());
+    m_returned_bufs.clear();
+    
+    // 环的tail与第一个元素的resv字段重叠
+    struct io_uring_buf_ring* ring = reinterpret_cast<struct io_uring_buf_ring*>(m_buf_ring);
+    __atomic_store_n(&ring->tail, m_buf_tail, __ATOMIC_RELEASE);
+}
+
+int UringPoller::Wait(PollEvent* events, int max_events, int timeout_ms) {
+    // 上一轮交出的数据已经处理完，缓冲区可以还给内核
+    RecycleBuffers();
+    
+    unsigned head = *m_cq_head;
+    unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+    
+    // 提交本轮积压的请求，没有现成的完成事件时一并等待
+    int ret = Enter(head == tail && timeout_ms != 0 ? 1 : 0, timeout_ms);
+    if (ret < 0) {
+        return -1;
+    }
+    
+    tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+    
+    int count = 0;
+    while (head != tail && count < max_events) {
+        const struct io_uring_cqe* cqe = &m_cqes[head & *m_cq_mask];
+        uint64_t user_data = cqe->user_data;
+        int res = cqe->res;
+        uint32_t flags = cqe->flags;
+        head++;
+        
+        bool more = (flags & IORING_CQE_F_MORE) != 0;
+        int fd = static_cast<int>(UserDataFd(user_data));
+        uint32_t tag = UserDataTag(user_data);
+        PollEvent& event = events[count];
+        
+        switch (UserDataOp(user_data)) {
+        case URING_OP_POLL: {
+            std::map<int, std::pair<uint32_t, uint32_t> >::iterator it = m_polls.find(fd);
+            if (it == m_polls.end() || it->second.second != tag) {
+                break;  // 已经Remove/Modify的过期事件
+            }
+            
+            // 较新的内核不再接受IORING_POLL_ADD_LEVEL：之后的poll都不带该标志，
+            // 带着它发起的请求在下面重新发起，不作为错误交给事件循环
+            bool level_rejected = res == -EINVAL && !(it->second.first & EPOLLET);
+            if (level_rejected) {
+                m_poll_level = false;
+            }
+            
+            if (!more) {
+                // 多次触发的poll被内核终止，透明地重新发起
+                uint32_t generation = ++m_poll_generation & 0xFFFFFFu;
+                it->second.second = generation;
+                ArmPoll(fd, it->second.first, generation);
+            }
+            
+            if (res == -ECANCELED || level_rejected) {
+                break;
+            }
+            
+            event.type = PollEventType::Ready;
+            event.fd = fd;
+            event.events = res < 0 ? static_cast<uint32_t>(EPOLLERR) : static_cast<uint32_t>(res);
+            event.tag = 0;
+            event.result = 0;
+            event.data = nullptr;
+            event.more = true;
+            count++;
+            break;
+        }
+        
+        case URING_OP_ACCEPT:
+            event.type = PollEventType::Accepted;
+            event.fd = fd;
+            event.events = 0;
+            event.tag = 0;
+            event.result = res;
+            event.data = nullptr;
+            event.more = more;
+            count++;
+            break;
+        
+        case URING_OP_RECV:
+            event.type = PollEventType::Received;
+            event.fd = fd;
+            event.events = 0;
+            event.tag = tag;
+            event.result = res;
+            event.data = nullptr;
+            event.more = more;
+            
+            if (flags & IORING_CQE_F_BUFFER) {
+                uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+                event.data = m_buffers + static_cast<size_t>(bid) * URING_BUF_SIZE;
+                m_returned_bufs.push_back(bid);
+            }
+            count++;
+            break;
+        
+        case URING_OP_SEND: {
+            uint32_t slot_index = UserDataFd(user_data);
+            SendSlot* slot = m_send_slots[slot_index].get();
+            
+            event.type = PollEventType::Sent;
+            event.fd = slot->fd;
+            event.events = 0;
+            event.tag = slot->tag;
+            event.result = res;
+            event.data = nullptr;
+            event.more = false;
+            count++;
+            
+            slot->owner.reset();
+            m_free_send_slots.push_back(slot_index);
+            break;
+        }
+        
+        default:
+            break;
+        }
+        
+        if (head == tail) {
+            tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+        }
+    }
+    
+    __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+    
+    return count;
+}
@@ -0,0 +1,110 @@
+#ifndef URING_POLLER_H
+#define URING_POLLER_H
+
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+#include <map>
+#include <vector>
+#include "poller.h"
+
+// 提交队列大小
+#define URING_ENTRIES 4096
+// 提供给内核的接收缓冲区数量和大小
+#define URING_BUF_COUNT 1024
+#define URING_BUF_SIZE 16384
+// 单次发送最多的iovec数
+#define URING_SEND_IOV 64
+
+// 基于io_uring的后端，直接使用系统调用，不依赖liburing
+//
+// - 就绪通知：多次触发的IORING_OP_POLL_ADD
+// - 新连接：多次触发的accept，一个SQE持续产生新连接
+// - 接收：多次触发的recv，从注册的提供缓冲区环中选取缓冲区，数据在完成事件中交付，
+//   缓冲区在下一次Wait时归还
+// - 发送：sendmsg请求先写入提交队列，在下一次Wait时与其他请求一起批量提交
+//
+// 只能在一个线程中使用。
+class UringPoller : public Poller {
+public:
+    UringPoller();
+    ~UringPoller();
+    
+    bool Init();
+    const char* Name() const;
+    bool Add(int fd, uint32_t events);
+    bool Modify(int fd, uint32_t events);
+    bool Remove(int fd);
+    int Wait(PollEvent* events, int max_events, int timeout_ms);
+    
+    bool SupportsAsyncIo() const;
+    bool StartAccept(int listen_fd);
+    bool StartRecv(int fd, uint32_t tag);
+    bool CancelRecv(int fd, uint32_t tag);
+    bool Send(int fd, uint32_t tag, const struct iovec* iov, int count, const std::shared_ptr<void>& owner);
+    bool CancelAll(int fd);
+
+private:
+    // 在途的sendmsg请求
+    struct SendSlot {
+        int fd;
+        uint32_t tag;
+        struct msghdr msg;
+        struct iovec iov[URING_SEND_IOV];
+        std::shared_ptr<void> owner;  // 保证数据在发送完成前有效
+    };
+    
+    // 取得一个空闲SQE，提交队列满时先提交
+    struct io_uring_sqe* GetSqe();
+    
+    // 提交已写入的SQE，wait_nr>0时同时等待完成事件
+    int Enter(unsigned wait_nr, int timeout_ms);
+    
+    // 发起就绪通知请求
+    bool ArmPoll(int fd, uint32_t events, uint32_t generation);
+    
+    // 把上一轮交出的接收缓冲区归还给内核
+    void RecycleBuffers();
+    
+    // 释放映射的内存
+    void Destroy();
+    
+    int m_ring_fd;
+    
+    // 提交队列
+    void* m_sq_ptr;
+    size_t m_sq_size;
+    unsigned* m_sq_head;
+    unsigned* m_sq_tail;
+    unsigned* m_sq_mask;
+    unsigned* m_sq_array;
+    unsigned m_sq_entries;
+    struct io_uring_sqe* m_sqes;
+    size_t m_sqes_size;
+    unsigned m_sq_local_tail;    // 已写入但尚未发布的尾部
+    unsigned m_to_submit;        // 待提交的SQE数
+    
+    // 完成队列
+    void* m_cq_ptr;
+    size_t m_cq_size;
+    unsigned* m_cq_head;
+    unsigned* m_cq_tail;
+    unsigned* m_cq_mask;
+    struct io_uring_cqe* m_cqes;
+    
+    // 提供缓冲区环
+    struct io_uring_buf* m_buf_ring;
+    size_t m_buf_ring_size;
+    char* m_buffers;
+    uint16_t m_buf_tail;
+    std::vector<uint16_t> m_returned_bufs;  // 上一轮交出、等待归还的缓冲区
+    
+    // 就绪通知：fd -> (关注的事件, 代数)
+    std::map<int, std::pair<uint32_t, uint32_t> > m_polls;
+    uint32_t m_poll_generation;
+    bool m_poll_level;           // 内核是否接受IORING_POLL_ADD_LEVEL
+    
+    std::vector<std::unique_ptr<SendSlot> > m_send_slots;
+    std::vector<uint32_t> m_free_send_slots;
+};
+
+#endif // URING_POLLER_H